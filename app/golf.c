@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <getopt.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,10 +9,27 @@
 #include <GL/glew.h> // Important to include glew before other GL stuff
 #include <GLFW/glfw3.h>
 
+#ifdef GOLF_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+    // Missing from older versions of eglext.h.
+#endif
+#endif
+
+#include "assets.h"
 #include "clock.h"
 #include "errors.h"
 #include "terrain.h"
 #include "terrain_view.h"
+#include "text.h"
+
+#define GOLF_DEFAULT_WIDTH  1024
+#define GOLF_DEFAULT_HEIGHT 768
+    // Size of the window (or, when headless, the framebuffer) unless
+    // overridden with --size.
 
 static const int POLL_KEYS[] = {
     'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
@@ -39,6 +57,15 @@ static void GolfError(Error error, void *error_data, void *arg)
 
 typedef struct {
     bool windowed;
+    const char *assets;
+    const char *headless;
+        // Script to run in headless mode, or NULL to open a window.
+    bool checksums;
+    uint32_t width;
+    uint32_t height;
+    int32_t fps;
+        // Frame rate limit, or -1 to use the default.
+    bool vsync;
 } GolfArgs;
 
 static void Golf_ParseArgs(int argc, char * const *argv, GolfArgs *args)
@@ -53,12 +80,49 @@ static void Golf_ParseArgs(int argc, char * const *argv, GolfArgs *args)
         "\n"
         "  -w, --windowed\n"
         "       Launch in windowed (not fullscreen) mode\n"
+        "  -s, --size WIDTHxHEIGHT\n"
+        "       Size of the window in pixels (default 1024x768)\n"
+        "  -f, --fps RATE\n"
+        "       Render at most RATE frames per second (default 60), or as\n"
+        "       fast as possible if RATE is 0\n"
+        "  --vsync\n"
+        "       Synchronize frames with the display's refresh rate, instead\n"
+        "       of limiting the frame rate\n"
+        "  -a, --assets DIR\n"
+        "       Load shaders and textures from DIR, instead of the copies\n"
+        "       built into the binary. Useful for editing them without\n"
+        "       rebuilding.\n"
+        "  --headless SCRIPT\n"
+        "       Render offscreen, without opening a window, following the\n"
+        "       commands in SCRIPT, and print the CPU and GPU time taken by\n"
+        "       each frame. Each line of SCRIPT is a console command, except\n"
+        "       for lines of the form\n"
+        "           frame [COUNT [COMMAND]]\n"
+        "       which render COUNT frames (default 1), running COMMAND before\n"
+        "       each one. For example, `frame 100 camera move 0 5` pans the\n"
+        "       camera east over 100 frames.\n"
+        "  --checksums\n"
+        "       In headless mode, also print a checksum of the image rendered\n"
+        "       in each frame\n"
         "  -h, --help\n"
         "       Show this help and exit\n";
 
+    enum {
+        OPT_HEADLESS = 256,
+        OPT_CHECKSUMS,
+        OPT_VSYNC,
+            // Long options with no short equivalent.
+    };
+
     static const struct option long_options[] = {
-        { "windowed", no_argument, 0, 'w' },
-        { "help",     no_argument, 0, 'h' },
+        { "windowed",  no_argument, 0, 'w' },
+        { "size",      required_argument, 0, 's' },
+        { "fps",       required_argument, 0, 'f' },
+        { "vsync",     no_argument, 0, OPT_VSYNC },
+        { "assets",    required_argument, 0, 'a' },
+        { "headless",  required_argument, 0, OPT_HEADLESS },
+        { "checksums", no_argument, 0, OPT_CHECKSUMS },
+        { "help",      no_argument, 0, 'h' },
         { 0, 0, 0, 0 }
     };
 
@@ -66,15 +130,58 @@ static void Golf_ParseArgs(int argc, char * const *argv, GolfArgs *args)
     // sensible default should be explicitly initialized below.
     memset(args, 0, sizeof(*args));
 
+    args->width = GOLF_DEFAULT_WIDTH;
+    args->height = GOLF_DEFAULT_HEIGHT;
+    args->fps = -1;
+
     int option_index = 0;
-    char c;
+    int c;
+        // `getopt_long` returns an int, and our long-only options don't fit
+        // in a char.
     while (
-        (c = getopt_long(argc, argv, "wh", long_options, &option_index))!= -1) {
+        (c = getopt_long(argc, argv, "ws:f:a:h", long_options, &option_index))
+            != -1) {
 
         switch (c) {
             case 'w':
                 args->windowed = true;
                 break;
+            case 's': {
+                unsigned width, height;
+                if (sscanf(optarg, "%ux%u", &width, &height) != 2 ||
+                    width == 0 || height == 0)
+                {
+                    fprintf(stderr, "Invalid size '%s'\n", optarg);
+                    exit(1);
+                }
+                args->width = width;
+                args->height = height;
+                break;
+            }
+            case 'f': {
+                char *end;
+                long fps = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || fps < 0 ||
+                    fps > INT32_MAX)
+                {
+                    fprintf(stderr, "Invalid frame rate '%s'\n", optarg);
+                    exit(1);
+                }
+                args->fps = fps;
+                break;
+            }
+            case OPT_VSYNC:
+                args->vsync = true;
+                break;
+            case 'a':
+                args->assets = optarg;
+                break;
+            case OPT_HEADLESS:
+                args->headless = optarg;
+                break;
+            case OPT_CHECKSUMS:
+                args->checksums = true;
+                break;
             case 'h':
                 fputs(short_usage, stdout);
                 fputc('\n', stdout);
@@ -90,14 +197,433 @@ static void Golf_ParseArgs(int argc, char * const *argv, GolfArgs *args)
     }
 }
 
+// Set up the GL state which every view expects.
+static void Golf_InitGLState(void)
+{
+    // Enable depth testing.
+    glEnable(GL_DEPTH_TEST);
+
+    // Enable color blending based on alpha channel.
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        // When blending a new color (the destination color) with a color
+        // already in the color buffer (the source color) take the source color
+        // with intensity given by the source alpha channel, and take the
+        // destination color with the remaining intensity (1 - source alpha).
+
+    // Make points drawn with GL_POINTS a bit easier to see.
+    glHint(GL_POINT_SMOOTH_HINT, GL_NICEST);
+    glEnable(GL_POINT_SMOOTH);
+    glPointSize(3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Headless mode
+//
+// Rendering offscreen lets us benchmark and regression-test the renderer on
+// machines with no display, such as CI runners. We create a GL context with
+// EGL on Mesa's surfaceless platform, which works with the llvmpipe software
+// rasterizer and needs neither a display server nor a GPU, and render into a
+// framebuffer object in place of a window.
+//
+
+#ifdef GOLF_HAVE_EGL
+
+#define GOLF_HEADLESS_TIME_STEP 16
+    // Simulated milliseconds per headless frame (about 60 frames per second).
+    // Using a fixed time step makes the rendered frames independent of how
+    // fast the machine running the benchmark is.
+#define GOLF_HEADLESS_QUERY_LATENCY 4
+    // Number of frames we let GPU timer queries run behind before waiting on
+    // their results, so that measuring the GPU doesn't stall the CPU.
+
+typedef struct {
+    uint64_t cpu_us;
+    uint64_t gpu_us;
+    uint64_t checksum;
+} GolfFrameStats;
+
+typedef struct {
+    ViewManager *manager;
+    uint32_t width;
+    uint32_t height;
+
+    GolfFrameStats *frames;
+    uint32_t num_frames;
+    uint32_t capacity;
+
+    GLuint queries[GOLF_HEADLESS_QUERY_LATENCY];
+        // Timer query for frame `i` is `queries[i % GOLF_HEADLESS_QUERY_LATENCY]`.
+    uint8_t *pixels;
+        // Buffer for reading back the rendered image, or NULL if we are not
+        // computing checksums.
+} GolfBenchmark;
+
+// FNV-1a hash of the pixels in the framebuffer.
+static uint64_t Golf_Checksum(GolfBenchmark *bench)
+{
+    size_t size = bench->width*bench->height*4;
+    glReadPixels(0, 0, bench->width, bench->height,
+                 GL_RGBA, GL_UNSIGNED_BYTE, bench->pixels);
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bench->pixels[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Wait for the GPU time of `frame` and record it.
+static void Golf_CollectGPUTime(GolfBenchmark *bench, uint32_t frame)
+{
+    GLuint64 ns;
+    glGetQueryObjectui64v(
+        bench->queries[frame % GOLF_HEADLESS_QUERY_LATENCY],
+        GL_QUERY_RESULT, &ns);
+    bench->frames[frame].gpu_us = ns/1000;
+}
+
+static void Golf_RenderFrame(GolfBenchmark *bench)
+{
+    uint32_t frame = bench->num_frames++;
+    if (frame >= bench->capacity) {
+        bench->capacity = bench->capacity ? 2*bench->capacity : 256;
+        bench->frames = Realloc(
+            bench->frames, bench->capacity*sizeof(GolfFrameStats));
+    }
+
+    if (frame >= GOLF_HEADLESS_QUERY_LATENCY) {
+        // We're about to reuse the query of an old frame, so it's time to
+        // find out how long that frame took.
+        Golf_CollectGPUTime(bench, frame - GOLF_HEADLESS_QUERY_LATENCY);
+    }
+
+    uint64_t start = Clock_GetTimeUS();
+    glBeginQuery(GL_TIME_ELAPSED,
+                 bench->queries[frame % GOLF_HEADLESS_QUERY_LATENCY]);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    ViewManager_Render(bench->manager);
+    glEndQuery(GL_TIME_ELAPSED);
+    bench->frames[frame].cpu_us = Clock_GetTimeUS() - start;
+
+    bench->frames[frame].checksum =
+        bench->pixels != NULL ? Golf_Checksum(bench) : 0;
+}
+
+// Run the commands in a headless script, rendering frames as directed.
+static bool Golf_RunScript(GolfBenchmark *bench, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    Console *console = bench->manager->focused->console;
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        // Strip leading and trailing whitespace.
+        char *command = line + strspn(line, " \t");
+        size_t length = strlen(command);
+        while (length > 0 && strchr(" \t\r\n", command[length - 1])) {
+            command[--length] = '\0';
+        }
+
+        if (*command == '\0' || *command == '#') {
+            // Skip empty lines and comments.
+            continue;
+        }
+
+        if (strncmp(command, "frame", 5) != 0 ||
+            (command[5] != '\0' && command[5] != ' ' && command[5] != '\t'))
+        {
+            Console_RunCommand(console, command);
+            continue;
+        }
+
+        // A `frame [COUNT [COMMAND]]` line.
+        char *end;
+        unsigned long count = strtoul(command + 5, &end, 10);
+        if (end == command + 5) {
+            count = 1;
+        }
+        end += strspn(end, " \t");
+
+        for (unsigned long i = 0; i < count; ++i) {
+            if (*end != '\0') {
+                Console_RunCommand(console, end);
+            }
+            Golf_RenderFrame(bench);
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+static int Golf_CompareU64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Print a summary of the times (in microseconds) taken by a set of frames.
+static void Golf_SummarizeTimes(
+    const char *name, uint64_t *times, uint32_t num_frames)
+{
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < num_frames; ++i) {
+        total += times[i];
+    }
+    qsort(times, num_frames, sizeof(times[0]), Golf_CompareU64);
+
+    fprintf(stderr, "%s ms: mean %.3f, median %.3f, p95 %.3f, max %.3f\n",
+        name,
+        total/1000.0/num_frames,
+        times[num_frames/2]/1000.0,
+        times[num_frames*95/100]/1000.0,
+        times[num_frames - 1]/1000.0);
+}
+
+static void Golf_Report(const GolfBenchmark *bench)
+{
+    printf("frame,cpu_us,gpu_us%s\n", bench->pixels ? ",checksum" : "");
+    for (uint32_t i = 0; i < bench->num_frames; ++i) {
+        const GolfFrameStats *frame = &bench->frames[i];
+        printf("%u,%llu,%llu", i,
+            (unsigned long long)frame->cpu_us,
+            (unsigned long long)frame->gpu_us);
+        if (bench->pixels) {
+            printf(",%016llx", (unsigned long long)frame->checksum);
+        }
+        putchar('\n');
+    }
+
+    if (bench->num_frames == 0) {
+        fprintf(stderr, "No frames were rendered.\n");
+        return;
+    }
+
+    fprintf(stderr, "%u frames at %ux%u\n",
+        bench->num_frames, bench->width, bench->height);
+    uint64_t *cpu = Malloc(bench->num_frames*sizeof(uint64_t));
+    uint64_t *gpu = Malloc(bench->num_frames*sizeof(uint64_t));
+        // On the heap, since long benchmarks have far too many frames for the
+        // stack.
+    for (uint32_t i = 0; i < bench->num_frames; ++i) {
+        cpu[i] = bench->frames[i].cpu_us;
+        gpu[i] = bench->frames[i].gpu_us;
+    }
+    Golf_SummarizeTimes("CPU", cpu, bench->num_frames);
+    Golf_SummarizeTimes("GPU", gpu, bench->num_frames);
+    free(cpu);
+    free(gpu);
+}
+
+// Make a GL 3.3 core context current, without any surface to draw to.
+static bool Golf_CreateHeadlessContext(
+    EGLDisplay *display, EGLContext *context)
+{
+    // Prefer the surfaceless platform if the EGL implementation has it.
+    // Otherwise, fall back to the default display and hope that it supports
+    // surfaceless contexts.
+    const char *client_extensions =
+        eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+            eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (client_extensions != NULL &&
+        strstr(client_extensions, "EGL_MESA_platform_surfaceless") &&
+        get_platform_display != NULL)
+    {
+        *display = get_platform_display(
+            EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    } else {
+        *display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    if (*display == EGL_NO_DISPLAY || !eglInitialize(*display, NULL, NULL)) {
+        fprintf(stderr, "Failed to initialize EGL\n");
+        return false;
+    }
+
+    // We never create a surface, so we don't need a config describing one, if
+    // the implementation lets us do without. The surfaceless platform may not
+    // have any configs at all.
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    const char *extensions = eglQueryString(*display, EGL_EXTENSIONS);
+    if (extensions == NULL ||
+        !strstr(extensions, "EGL_KHR_no_config_context"))
+    {
+        static const EGLint config_attribs[] = {
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        EGLint num_configs;
+        if (!eglChooseConfig(
+                *display, config_attribs, &config, 1, &num_configs) ||
+            num_configs < 1)
+        {
+            fprintf(stderr, "No EGL config supports OpenGL\n");
+            goto ERR_CONFIG;
+        }
+    }
+
+    static const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    if (!eglBindAPI(EGL_OPENGL_API) ||
+        (*context = eglCreateContext(
+            *display, config, EGL_NO_CONTEXT, context_attribs))
+                == EGL_NO_CONTEXT)
+    {
+        fprintf(stderr, "Could not create an OpenGL 3.3 context\n");
+        goto ERR_CONFIG;
+    }
+
+    if (!eglMakeCurrent(*display, EGL_NO_SURFACE, EGL_NO_SURFACE, *context)) {
+        fprintf(stderr, "Could not make a surfaceless context current\n");
+        goto ERR_MAKE_CURRENT;
+    }
+
+    return true;
+
+ERR_MAKE_CURRENT:
+    eglDestroyContext(*display, *context);
+ERR_CONFIG:
+    eglTerminate(*display);
+    return false;
+}
+
+static int Golf_RunHeadless(const GolfArgs *args)
+{
+    EGLDisplay display;
+    EGLContext context;
+    if (!Golf_CreateHeadlessContext(&display, &context)) {
+        return 1;
+    }
+
+    int ret = 1;
+
+    // Initialize GLEW
+    if (glewInit() != GLEW_OK) {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        goto ERR_GLEW_INIT;
+    }
+    glGetError();
+        // With glewExperimental, glewInit may leave behind a GL_INVALID_ENUM
+        // from querying extensions the old way. It's harmless.
+
+    // Create a framebuffer to stand in for the window.
+    GLuint framebuffer, renderbuffers[2];
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, args->width, args->height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+                          args->width, args->height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, renderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Could not create a %ux%u framebuffer\n",
+            args->width, args->height);
+        goto ERR_FRAMEBUFFER;
+    }
+    glViewport(0, 0, args->width, args->height);
+
+    ViewManager manager;
+    ViewManager_InitHeadless(&manager, args->width, args->height);
+    ViewManager_SetFixedTimeStep(&manager, GOLF_HEADLESS_TIME_STEP);
+
+    // Initialize game objects
+    Terrain terrain;
+    Terrain_Init(&terrain, 100, 100, 10);
+    View_Focus((View *)TerrainView_New(&manager, &terrain));
+
+    Golf_InitGLState();
+
+    GolfBenchmark bench = {
+        .manager = &manager,
+        .width = args->width,
+        .height = args->height,
+    };
+    glGenQueries(GOLF_HEADLESS_QUERY_LATENCY, bench.queries);
+    if (args->checksums) {
+        bench.pixels = Malloc(args->width*args->height*4);
+    }
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    ViewManager_Render(&manager);
+        // Render one untimed frame first. Views create some of their GL
+        // resources the first time they are rendered, which would otherwise
+        // be counted against the first frame of the script (and some drivers
+        // report nonsense GPU times for queries spanning a shader compile).
+
+    if (Golf_RunScript(&bench, args->headless)) {
+        // Collect the timings of the frames still in flight.
+        uint32_t first = bench.num_frames > GOLF_HEADLESS_QUERY_LATENCY
+                       ? bench.num_frames - GOLF_HEADLESS_QUERY_LATENCY
+                       : 0;
+        for (uint32_t i = first; i < bench.num_frames; ++i) {
+            Golf_CollectGPUTime(&bench, i);
+        }
+
+        Golf_Report(&bench);
+        ret = 0;
+    }
+
+    glDeleteQueries(GOLF_HEADLESS_QUERY_LATENCY, bench.queries);
+    free(bench.frames);
+    free(bench.pixels);
+    ViewManager_Destroy(&manager);
+    Terrain_Destroy(&terrain);
+
+ERR_FRAMEBUFFER:
+    glDeleteRenderbuffers(2, renderbuffers);
+    glDeleteFramebuffers(1, &framebuffer);
+ERR_GLEW_INIT:
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    return ret;
+}
+
+#else
+
+static int Golf_RunHeadless(const GolfArgs *args)
+{
+    (void)args;
+    fprintf(stderr, "This build of golf does not support --headless, because "
+                    "EGL was not found.\n");
+    return 1;
+}
+
+#endif
+
 int main(int argc, char *const *argv)
 {
     GolfArgs args;
     Golf_ParseArgs(argc, argv, &args);
+    Assets_SetDirectory(args.assets);
 
     glewExperimental = true;
 
     Error_SetFatalErrorCallback(GolfError, NULL);
+
+    if (args.headless != NULL) {
+        return Golf_RunHeadless(&args);
+    }
+
     glfwSetErrorCallback(GlError);
 
     // Initialize GLFW
@@ -125,7 +651,8 @@ int main(int argc, char *const *argv)
         args.windowed ? NULL
                       : glfwGetPrimaryMonitor();
                             // Window will be fullscreen on the primary monitor.
-    GLFWwindow *window = glfwCreateWindow(1024, 768, "Golf", monitor, NULL);
+    GLFWwindow *window = glfwCreateWindow(
+        args.width, args.height, "Golf", monitor, NULL);
     if (window == NULL) {
         fprintf(stderr, "Could not open window.\n");
         goto ERR_CREATE_WINDOW;
@@ -134,6 +661,10 @@ int main(int argc, char *const *argv)
 
     ViewManager manager;
     ViewManager_Init(&manager, window);
+    if (args.fps >= 0) {
+        ViewManager_SetFrameRate(&manager, args.fps);
+    }
+    ViewManager_SetVSync(&manager, args.vsync);
 
     // Initialize GLEW
     if (glewInit() != GLEW_OK) {
@@ -146,21 +677,7 @@ int main(int argc, char *const *argv)
     Terrain_Init(&terrain, 100, 100, 10);
     View_Focus((View *)TerrainView_New(&manager, &terrain));
 
-    // Enable depth testing.
-    glEnable(GL_DEPTH_TEST);
-
-    // Enable color blending based on alpha channel.
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        // When blending a new color (the destination color) with a color
-        // already in the color buffer (the source color) take the source color
-        // with intensity given by the source alpha channel, and take the
-        // destination color with the remaining intensity (1 - source alpha).
-
-    // Make points drawn with GL_POINTS a bit easier to see.
-    glHint(GL_POINT_SMOOTH_HINT, GL_NICEST);
-    glEnable(GL_POINT_SMOOTH);
-    glPointSize(3);
+    Golf_InitGLState();
 
     // Main loop
     while (!glfwWindowShouldClose(window)) {
@@ -169,9 +686,10 @@ int main(int argc, char *const *argv)
         glfwPollEvents();
     }
 
-    glfwTerminate();
     ViewManager_Destroy(&manager);
     Terrain_Destroy(&terrain);
+        // These release GL objects, so they have to go before the context.
+    glfwTerminate();
     return 0;
 
 ERR_GLEW_INIT:
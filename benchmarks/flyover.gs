@@ -0,0 +1,24 @@
+# Render benchmark: fly the camera over a two-hole course.
+#
+# Run with
+#   build/bin/golf --headless benchmarks/flyover.gs [--checksums]
+#
+# Each `frame COUNT COMMAND` line renders COUNT frames, running COMMAND before
+# each one. Other lines are console commands.
+
+# Build the course.
+terrain bulk-raise-face 20 20 60 60 1
+terrain define-hole 1 10 10 40 50 80 70
+terrain define-hole 2 90 10 60 40
+show routing
+
+# Start from a close-up of the first tee.
+camera move 150 150
+camera zoom -200
+frame 10
+
+# Follow the first hole to the green, then pull back to show the whole course,
+# and drift back towards the start.
+frame 60 camera move 5 3
+frame 60 camera zoom -7
+frame 60 camera move -3 -3
@@ -0,0 +1,77 @@
+/**
+ * \file assets.h
+ * \brief Shaders and textures built into the binary.
+ *
+ * The files under `shaders/` and `textures/` are compiled into the binary by
+ * the `embed_assets` tool at build time, so the game doesn't depend on the
+ * directory it is launched from, and doesn't have to do any I/O to start up.
+ * Bitmaps are decoded at build time too, and embedded in the layout GL expects.
+ *
+ * During development, it is convenient to be able to edit a shader without
+ * rebuilding. `Assets_SetDirectory` makes the loaders read assets from files
+ * in a directory instead.
+ */
+
+#ifndef GOLF_ASSETS_H
+#define GOLF_ASSETS_H
+
+#include <stdint.h>
+
+/**
+ * \brief An asset file embedded in the binary.
+ */
+typedef struct {
+    const char *path;
+        // Path of the file the asset was built from, relative to the root of
+        // the source tree. For example, "shaders/text_vertex.glsl".
+    const uint8_t *data;
+    uint32_t size;
+        // Contents of the asset, in bytes.
+    uint32_t width;
+    uint32_t height;
+        // For images, the dimensions in pixels, in which case `data` holds the
+        // decoded pixels in the layout returned by `BMP_Load`. Zero for other
+        // assets, whose data are the contents of the file. Distance fields,
+        // whose paths look like "textures/font.bmp:distance:4", are images
+        // with one byte per texel (see `GL_LoadDistanceField`).
+} Asset;
+
+/**
+ * \brief All of the embedded assets.
+ *
+ * These are defined in a source file generated by `embed_assets`.
+ */
+extern const Asset ASSETS[];
+extern const uint32_t NUM_ASSETS;
+
+/**
+ * \brief Load assets from files under `directory` instead of from the binary.
+ *
+ * \param directory The root of the tree to load from, laid out like the source
+ *                  tree, or NULL to go back to using the embedded assets. The
+ *                  string must outlive any assets loaded while it is set.
+ */
+void Assets_SetDirectory(const char *directory);
+
+/**
+ * \brief Get the directory set by `Assets_SetDirectory`, or NULL if assets are
+ * loaded from the binary.
+ */
+const char *Assets_GetDirectory(void);
+
+/**
+ * \brief Get the path of the file which overrides the asset at `path`, when
+ * `Assets_GetDirectory` is not NULL.
+ *
+ * The result is allocated with `Malloc`, so remember to free it.
+ */
+char *Assets_OverridePath(const char *path);
+
+/**
+ * \brief Find the embedded asset built from `path`.
+ *
+ * Raises a `FATAL` error if there is no such asset.
+ */
+const Asset *Assets_Find(const char *path);
+
+#endif
@@ -0,0 +1,27 @@
+/**
+ * \file bmp.h
+ * \brief Decoding of bitmap images.
+ */
+
+#ifndef GOLF_BMP_H
+#define GOLF_BMP_H
+
+#include <stdint.h>
+
+/**
+ * \brief Read a bitmap file and convert it to 8-bit RGBA pixels.
+ *
+ * \param[out] width    The width of the image, in pixels.
+ * \param[out] height   The height of the image, in pixels.
+ *
+ * \return The pixels, four bytes each in red, green, blue, alpha order, and in
+ * rows from the bottom of the image to the top. This is the layout GL expects
+ * for `GL_RGBA` data of type `GL_UNSIGNED_BYTE`. The pixels are allocated with
+ * `Malloc`, so remember to free them.
+ *
+ * Only 32-bit bitmaps with an alpha channel are supported. Any other file
+ * raises a `FATAL` error.
+ */
+uint8_t *BMP_Load(const char *path, uint32_t *width, uint32_t *height);
+
+#endif
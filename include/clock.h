@@ -13,9 +13,29 @@
  */
 uint64_t Clock_GetTimeMS(void);
 
+/**
+ * \brief Get the current time in microseconds since the epoch.
+ *
+ * \details
+ *      Uses the same clock as `Clock_GetTimeMS`, at a finer resolution. Useful
+ *      for timing operations which take less than a millisecond.
+ */
+uint64_t Clock_GetTimeUS(void);
+
 /**
  * \brief Suspend execution for `ms` milliseconds.
  */
 void Clock_SleepMS(uint32_t ms);
 
+/**
+ * \brief Suspend execution for `us` microseconds.
+ *
+ * \details
+ *      The operating system may not wake us up for some time after the
+ *      requested interval, so this is not suitable for waiting until a precise
+ *      time. To do that, sleep until shortly before the time and then poll
+ *      `Clock_GetTimeUS`.
+ */
+void Clock_SleepUS(uint32_t us);
+
 #endif
@@ -0,0 +1,51 @@
+/**
+ * \file distance_field.h
+ * \brief Converting coverage masks, like font bitmaps, to signed distance
+ * fields.
+ */
+
+#ifndef GOLF_DISTANCE_FIELD_H
+#define GOLF_DISTANCE_FIELD_H
+
+#include <stdint.h>
+
+/**
+ * \brief Factor by which the mask is upsampled before measuring distances.
+ *
+ * Measuring on a finer grid lets the edges of the shapes fall between texels
+ * of the mask, where its antialiasing puts them. The factor is odd so that the
+ * center of every texel of the mask is also a sample of the finer grid.
+ */
+#define DISTANCE_FIELD_UPSAMPLE 3
+
+/**
+ * \brief Compute the signed distance from each texel of a mask to the nearest
+ * edge of the shapes in it.
+ *
+ * \param mask   Coverage of each texel, where 255 is fully inside a shape. The
+ *               texels are in rows, with `stride` bytes between consecutive
+ *               texels, so a single channel of an RGBA image can be used
+ *               directly.
+ * \param width  The size of the mask, in texels.
+ * \param height
+ * \param stride
+ * \param spread The largest distance, in texels, which the field can
+ *               represent. Anything further from an edge is clamped.
+ * \param field  Receives one byte per texel, in rows with no padding. 128 is
+ *               on an edge, larger values are inside a shape, and each step of
+ *               `127/spread` is one texel of distance.
+ *
+ * \details
+ *      Distances are Euclidean, and are computed exactly on a grid
+ *      `DISTANCE_FIELD_UPSAMPLE` times finer than the mask, using the linear
+ *      time transform of Felzenszwalb and Huttenlocher. The columns, and then
+ *      the rows, are split across threads.
+ *
+ *      A texture of the field, sampled with linear filtering and thresholded at
+ *      one half, reproduces the shapes with smooth edges at any scale, so a
+ *      single texture can serve text of every size.
+ */
+void DistanceField_Compute(const uint8_t *mask, uint32_t width,
+    uint32_t height, uint32_t stride, uint8_t spread, uint8_t *field);
+
+#endif
@@ -95,4 +95,21 @@ static inline void *Malloc(size_t size)
     return ret;
 }
 
+/**
+ * \brief Resize an allocation, terminating the program on failure.
+ *
+ * \details
+ *      This is a thin wrapper around system realloc, which calls `Error_Raise`
+ *      with a `FATAL` error if the requested amount of memory is not available.
+ */
+static inline void *Realloc(void *ptr, size_t size)
+{
+    void *ret = realloc(ptr, size);
+    if (ret == NULL) {
+        Error_Raise(FATAL, ERR_OUT_OF_MEMORY, NULL);
+    }
+
+    return ret;
+}
+
 #endif
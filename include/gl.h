@@ -7,6 +7,8 @@
 #ifndef GOLF_GL_H
 #define GOLF_GL_H
 
+#include <stdint.h>
+
 #include <GL/glew.h>
 
 #include "matrix.h"
@@ -15,8 +17,12 @@ typedef enum {
     VERTEX_ATTRIB_POSITION = 0,
     VERTEX_ATTRIB_COLOR = 1,
     VERTEX_ATTRIB_TEXTURE_UV = 2,
-    VERTEX_ATTRIB_CURSOR = 3,
+    VERTEX_ATTRIB_GLYPH_SIZE = 3,
     VERTEX_ATTRIB_NORMAL = 4,
+    VERTEX_ATTRIB_MATERIAL = 5,
+    VERTEX_ATTRIB_BG_COLOR = 6,
+    VERTEX_ATTRIB_DEPTH_FADE = 7,
+    VERTEX_ATTRIB_OCCLUSION = 8,
 } VertexAttribute;
 
 /**
@@ -39,8 +45,132 @@ typedef enum {
  */
 GLuint GL_LoadShaders(const char *vertex_path, const char *fragment_path);
 
+/**
+ * \brief Release a program returned by `GL_LoadShaders`.
+ *
+ * \details
+ *      Programs are shared: loading the same pair of shaders again returns the
+ *      program which is already loaded, rather than compiling a new one. So
+ *      uniforms set on a program are seen by every user of it. The program is
+ *      deleted once each call to `GL_LoadShaders` which returned it has been
+ *      matched by a call to `GL_ReleaseShaders`.
+ */
+void GL_ReleaseShaders(GLuint program);
+
+/**
+ * \brief Load a texture from a bitmap file.
+ *
+ * \details
+ *      Like programs, textures are shared between everyone who loads them from
+ *      the same path, and deleted when the last of them calls
+ *      `GL_ReleaseTexture`.
+ */
 GLuint GL_LoadTexture(const char *bmp_path);
 
+/**
+ * \brief Load a signed distance field of the alpha channel of a bitmap as a
+ * single-channel texture.
+ *
+ * \param spread The distance in texels from an edge at which the field
+ *               saturates. See `DistanceField_Compute`.
+ *
+ * \details
+ *      The field is computed by `embed_assets` at build time, and embedded as
+ *      the asset "<bmp_path>:distance:<spread>", which must be listed in
+ *      src/CMakeLists.txt. When assets are loaded from a directory (see
+ *      `Assets_SetDirectory`), it is computed from the bitmap on first load
+ *      instead. Either way, the texture is shared like any other.
+ */
+GLuint GL_LoadDistanceField(const char *bmp_path, uint8_t spread);
+
+/**
+ * \brief Release a texture returned by `GL_LoadTexture` or
+ * `GL_LoadDistanceField`.
+ */
+void GL_ReleaseTexture(GLuint texture);
+
+/**
+ * \brief Get the number of distinct programs and textures currently loaded.
+ */
+void GL_GetResourceCounts(uint32_t *programs, uint32_t *textures);
+
+/**
+ * \brief Number of frames whose streamed data may be in flight at once.
+ */
+#define GL_STREAM_BUFFER_FRAMES 4
+
+/**
+ * \brief A ring buffer for geometry which is regenerated every frame.
+ *
+ * \details
+ *      Respecifying a small buffer with `glBufferData` every frame makes the
+ *      driver reallocate storage, and writing to a buffer the GPU is still
+ *      reading from forces it to wait. Instead, dynamic geometry is written to
+ *      successive regions of one large buffer which is never reallocated. At
+ *      the end of each frame we insert a fence, and a region is only reused
+ *      once the fences of all the frames which wrote to it have signaled.
+ *
+ *      Where `GL_ARB_buffer_storage` is available, the buffer is mapped once
+ *      and stays mapped. Otherwise each upload maps just the region it writes,
+ *      unsynchronized, since the fences already tell us it is not in use.
+ */
+typedef struct {
+    GLuint buffer;
+        // The GL buffer object. Bind this to read uploaded data.
+    GLsizeiptr capacity;
+    GLintptr head;
+        // Offset at which the next upload will start.
+    GLsizeiptr used;
+        // Bytes which may still be read by the GPU, including those written
+        // during the current frame, and any padding skipped at the end of the
+        // buffer when wrapping around.
+    GLsizeiptr frame_used;
+        // Bytes written (or skipped) during the current frame.
+    uint8_t *mapping;
+        // Persistent mapping of the whole buffer, or NULL if it is mapped for
+        // each upload.
+    GLsync fences[GL_STREAM_BUFFER_FRAMES];
+    GLsizeiptr fence_sizes[GL_STREAM_BUFFER_FRAMES];
+        // Circular queue of fences for frames the GPU may still be working on,
+        // each with the number of bytes that frame used.
+    uint8_t first_fence;
+    uint8_t num_fences;
+} GL_StreamBuffer;
+
+/**
+ * \brief Create a stream buffer able to hold `capacity` bytes in flight.
+ */
+void GL_StreamBuffer_Init(GL_StreamBuffer *stream, GLsizeiptr capacity);
+
+/**
+ * \brief Release the buffer and the fences of frames still in flight.
+ *
+ * Draws already submitted may still read the buffer; GL keeps it alive until
+ * they finish.
+ */
+void GL_StreamBuffer_Destroy(GL_StreamBuffer *stream);
+
+/**
+ * \brief Copy `size` bytes from `data` into the stream buffer.
+ *
+ * \details
+ *      The data is only guaranteed to survive until the next upload, so draw
+ *      from it right away, and upload it again in later frames. If a single
+ *      frame uploads more than the capacity of the buffer, we wait for the
+ *      GPU to finish reading earlier uploads before overwriting them. A
+ *      single upload bigger than the whole buffer replaces it with a larger
+ *      one, so `stream->buffer` may change with any upload.
+ *
+ * \return The offset of the data in `stream->buffer`.
+ */
+GLintptr GL_StreamBuffer_Upload(
+    GL_StreamBuffer *stream, const void *data, GLsizeiptr size);
+
+/**
+ * \brief Mark the end of a frame, after the draws which read its uploads.
+ */
+void GL_StreamBuffer_EndFrame(GL_StreamBuffer *stream);
+
 static const vec3 RGB_RED = { 1, 0, 0 };
 static const vec3 RGB_GREEN = { 0, 1, 0 };
 static const vec3 RGB_BLUE = { 0, 0, 1 };
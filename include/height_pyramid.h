@@ -0,0 +1,92 @@
+/**
+ * \file height_pyramid.h
+ * \brief Ray casting against a grid of heights.
+ */
+
+#ifndef GOLF_HEIGHT_PYRAMID_H
+#define GOLF_HEIGHT_PYRAMID_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+/**
+ * \brief Maximum number of levels in a `HeightPyramid`, which bounds the size
+ * of the grid at 2^(levels - 1) faces on each side.
+ */
+#define HEIGHT_PYRAMID_MAX_LEVELS 17
+
+/**
+ * \brief A hierarchy of maximum heights over a grid of square faces.
+ *
+ * \details
+ *      Level 0 holds the highest vertex of each face. Each level above that
+ *      holds the maximum of 2x2 blocks of the level below, until the top level,
+ *      which is a single height for the whole grid. A ray which passes above
+ *      the maximum height of a block can't hit anything in it, so ray casts
+ *      skip most of the grid and only test individual triangles near the hit.
+ *
+ *      The faces are triangulated the same way as the terrain mesh: each face
+ *      is split along the diagonal from its bottom left to its top right
+ *      corner.
+ */
+typedef struct {
+    const uint16_t *heights;
+        // The vertex heights, in row-major order. These are not owned by the
+        // pyramid, and must outlive it.
+    uint16_t width;
+    uint16_t height;
+        // Dimensions of the grid in faces. There is one more row and column of
+        // vertices.
+    uint8_t num_levels;
+    uint16_t level_widths[HEIGHT_PYRAMID_MAX_LEVELS];
+    uint16_t level_heights[HEIGHT_PYRAMID_MAX_LEVELS];
+    uint16_t *levels[HEIGHT_PYRAMID_MAX_LEVELS];
+        // Each level is stored in row-major order.
+} HeightPyramid;
+
+/**
+ * \brief Allocate a pyramid over a grid of `width` by `height` faces.
+ *
+ * \param heights The heights of the `(width + 1)*(height + 1)` vertices of the
+ *                grid, in row-major order. The pyramid keeps a pointer to
+ *                these, so call `HeightPyramid_Update` whenever they change.
+ *
+ * The contents of the pyramid are undefined until `HeightPyramid_Update` has
+ * been called on the whole grid.
+ */
+void HeightPyramid_Init(HeightPyramid *pyramid,
+    const uint16_t *heights, uint16_t width, uint16_t height);
+
+/**
+ * \brief Free the memory used by a pyramid.
+ */
+void HeightPyramid_Destroy(HeightPyramid *pyramid);
+
+/**
+ * \brief Recompute the pyramid after the heights of the vertices in the given
+ * rectangle (inclusive) have changed.
+ */
+void HeightPyramid_Update(HeightPyramid *pyramid,
+    uint16_t min_row, uint16_t min_col, uint16_t max_row, uint16_t max_col);
+
+/**
+ * \brief Find the first point where a line segment hits the grid.
+ *
+ * \param xy_resolution The width of each face. Vertex (`row`, `col`) is at
+ *                      `(col*xy_resolution, row*xy_resolution, height)`.
+ * \param start         The start of the segment.
+ * \param end           The end of the segment.
+ * \param[out] hit      The point where the segment first hits the grid.
+ * \param[out] row      The row of the face containing `hit`.
+ * \param[out] col      The column of the face containing `hit`.
+ *
+ * \return Whether the segment hits the grid at all. If it doesn't, the output
+ * parameters are not modified.
+ */
+bool HeightPyramid_Raycast(const HeightPyramid *pyramid, float xy_resolution,
+    const vec3 *start, const vec3 *end,
+    vec3 *hit, uint16_t *row, uint16_t *col);
+
+#endif
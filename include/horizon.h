@@ -0,0 +1,60 @@
+/**
+ * \file horizon.h
+ * \brief Baking ambient occlusion from a grid of heights.
+ */
+
+#ifndef GOLF_HORIZON_H
+#define GOLF_HORIZON_H
+
+#include <stdint.h>
+
+/**
+ * \brief Number of vertices we search for the horizon in each direction.
+ *
+ * The occlusion of a vertex only depends on heights at most this many rows and
+ * columns away, so after an edit only the occlusion within this distance of it
+ * needs to be recomputed.
+ */
+#define HORIZON_RADIUS 16
+
+/**
+ * \brief Number of directions in which we search for the horizon.
+ */
+#define HORIZON_DIRECTIONS 8
+
+/**
+ * \brief Compute how much of the sky is visible from each vertex in a
+ * rectangle of a height grid.
+ *
+ * \details
+ *      From each vertex, we march outwards along the grid in
+ *      `HORIZON_DIRECTIONS` directions, to find the steepest angle up to the
+ *      surrounding terrain in each. The sky below that angle is hidden, so the
+ *      visible fraction of the sky is one minus the average sine of the
+ *      horizon angles. A vertex on flat ground or a peak sees the whole sky,
+ *      and one at the bottom of a valley or bunker sees less, so it should
+ *      receive less ambient light.
+ *
+ *      The result is stored as one byte per vertex, where 255 means the whole
+ *      sky is visible. Large rectangles are split into bands of rows which are
+ *      computed concurrently.
+ *
+ * \param heights       The height of each vertex, in row-major order.
+ * \param width         The number of vertices in each row.
+ * \param height        The number of rows.
+ * \param xy_resolution The horizontal distance between neighbouring vertices,
+ *                      in the same units as the heights.
+ * \param min_row       The rectangle to compute, inclusive.
+ * \param min_col
+ * \param max_row
+ * \param max_col
+ * \param[out] occlusion The result for each vertex, indexed like `heights`.
+ *                       Entries outside the rectangle are not modified.
+ */
+void Horizon_ComputeOcclusion(
+    const uint16_t *heights, uint16_t width, uint16_t height,
+    float xy_resolution,
+    uint16_t min_row, uint16_t min_col, uint16_t max_row, uint16_t max_col,
+    uint8_t *occlusion);
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * \file line_batch.h
+ * \brief Drawing lines and points in a scene with as few draw calls as we can.
+ */
+
+#ifndef GOLF_LINE_BATCH_H
+#define GOLF_LINE_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#include "gl.h"
+#include "matrix.h"
+#include "render_queue.h"
+
+/**
+ * \brief One vertex of a line or point.
+ */
+typedef struct {
+    GLfloat position[3];
+        // World coordinates.
+    GLubyte color[4];
+        // RGBA.
+    GLubyte depth_fade;
+        // 255 if the vertex should fade out as it gets further from the
+        // camera, or 0 if it should be drawn with the alpha in `color`.
+} LineVertex;
+
+/**
+ * \brief Lines and points collected for a frame.
+ *
+ * \details
+ *      Debug and overlay geometry, like the ruler, hole routes, ball and axes,
+ *      is small and changes often, so rather than keeping a buffer and a draw
+ *      call for each piece, its owner adds it to a batch every frame. When the
+ *      render queue reaches the batch, it streams the vertices to the GPU and
+ *      draws them with one draw call for all the lines and one for all the
+ *      points.
+ */
+typedef struct {
+    LineVertex *line_vertices;
+    uint32_t num_line_vertices;
+    uint32_t line_vertices_capacity;
+        // Two vertices for each line segment.
+    LineVertex *points;
+    uint32_t num_points;
+    uint32_t points_capacity;
+
+    // GL stuff
+    GLuint vao;
+    GLuint shaders;
+    GLuint mvp;
+
+    // State for the draw submitted by `LineBatch_Submit`
+    GL_StreamBuffer *stream;
+    mat4 transform;
+} LineBatch;
+
+/**
+ * \brief Create the GL resources for a batch, which starts out empty.
+ */
+void LineBatch_Init(LineBatch *batch);
+
+/**
+ * \brief Release the resources acquired by `LineBatch_Init`.
+ */
+void LineBatch_Destroy(LineBatch *batch);
+
+/**
+ * \brief Pack a color and depth fading flag into a vertex.
+ */
+void LineVertex_Init(LineVertex *vertex,
+    const vec3 *position, const vec4 *color, bool depth_fade);
+
+/**
+ * \brief Append `count` line segments to the batch.
+ *
+ * \return A pointer to `2*count` new vertices, which the caller must
+ * initialize. It is only valid until the next call to `LineBatch_AddLines` or
+ * until the batch is drawn.
+ */
+LineVertex *LineBatch_AddLines(LineBatch *batch, uint32_t count);
+
+/**
+ * \brief Append a line segment from `start` to `end` to the batch.
+ */
+void LineBatch_AddLine(LineBatch *batch,
+    const vec3 *start, const vec3 *end, const vec4 *color);
+
+/**
+ * \brief Append a point to the batch.
+ */
+void LineBatch_AddPoint(LineBatch *batch, const vec3 *point, const vec4 *color);
+
+/**
+ * \brief Queue a draw of everything in the batch.
+ *
+ * The batch is cleared once the queue has drawn it.
+ *
+ * \param queue     The queue to submit the draw to.
+ * \param stream    The buffer to upload the vertices through.
+ * \param transform The model-view-projection matrix to draw with.
+ */
+void LineBatch_Submit(LineBatch *batch, RenderQueue *queue,
+    GL_StreamBuffer *stream, const mat4 *transform);
+
+#endif
@@ -255,6 +255,8 @@ static const vec4 RGBA_CLEAR = { 0, 0, 0, 0 };
     ///< A fully transparent color.
 static const vec4 RGBA_BLACK = { 0, 0, 0, 1 };
     ///< An opaque, black color.
+static const vec4 RGBA_WHITE = { 1, 1, 1, 1 };
+    ///< An opaque, white color.
 
 /**
  * \brief Multiply a vector by a scalar.
@@ -595,4 +597,36 @@ static inline float *mat4_Buffer(mat4 *m)
 const char *mat4_String(mat4 *m);
 #endif
 
+/**
+ * \brief The region of space visible through a projection.
+ *
+ * Each plane is stored as a vector `(a, b, c, d)` such that a point `(x, y, z)`
+ * is on the visible side of the plane when `ax + by + cz + d >= 0`.
+ */
+typedef struct {
+    vec4 planes[6];
+} Frustum;
+
+/**
+ * \brief Extract the view frustum of a view-projection matrix.
+ *
+ * \param m     A matrix mapping world coordinates to clip coordinates.
+ * \param out   The frustum, with planes in world coordinates.
+ */
+void Frustum_FromMatrix(const mat4 *m, Frustum *out);
+
+/**
+ * \brief Test an axis-aligned box against a frustum.
+ *
+ * \param min   The corner of the box with the smallest coordinates.
+ * \param max   The corner of the box with the largest coordinates.
+ *
+ * \return
+ *  `false` if the box is definitely outside the frustum, `true` if it may be
+ *  at least partially inside. Boxes which are near a corner of the frustum may
+ *  be reported as visible even if they are not.
+ */
+bool Frustum_IntersectsBox(
+    const Frustum *frustum, const vec3 *min, const vec3 *max);
+
 #endif
@@ -0,0 +1,129 @@
+/**
+ * \file minimap.h
+ * \brief An overview of the whole course, cached in a texture.
+ */
+
+#ifndef GOLF_MINIMAP_H
+#define GOLF_MINIMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#include "matrix.h"
+#include "render_queue.h"
+
+/**
+ * \brief Number of texels along the longer side of the minimap texture.
+ */
+#define MINIMAP_TEXTURE_SIZE 256
+
+/**
+ * \brief Number of pixels along the longer side of the minimap on screen.
+ */
+#define MINIMAP_SCREEN_SIZE 200
+
+/**
+ * \brief Number of pixels between the minimap and the corner of the window.
+ */
+#define MINIMAP_SCREEN_MARGIN 10
+
+/**
+ * \brief Draw the part of the scene within a rectangle of the world.
+ *
+ * \param object    The object passed to `Minimap_Update`.
+ * \param transform Maps world coordinates to clip coordinates in the texture.
+ * \param min_x     The rectangle to draw, in world coordinates. Anything drawn
+ * \param min_y     outside it is discarded.
+ * \param max_x
+ * \param max_y
+ */
+typedef void (*Minimap_DrawFunction)(void *object, const mat4 *transform,
+    float min_x, float min_y, float max_x, float max_y);
+
+/**
+ * \brief A top-down view of a rectangle of the world, `[0, width]` by
+ * `[0, height]` in the XY plane.
+ *
+ * \details
+ *      Drawing the whole course a second time every frame would double the
+ *      cost of the terrain, so instead the scene is rendered into a texture
+ *      once, and after that only the parts of the world which have been marked
+ *      out of date with `Minimap_Invalidate` are redrawn, clipped to the
+ *      texels they cover. Each frame, the texture is drawn in the corner of
+ *      the window, and the camera's footprint and the ball are drawn on top of
+ *      it by the fragment shader, which is much cheaper than rendering them
+ *      into the texture.
+ */
+typedef struct {
+    float world_width;
+    float world_height;
+        // Extent of the world covered by the minimap.
+    uint16_t texture_width;
+    uint16_t texture_height;
+
+    bool dirty;
+    uint16_t dirty_min_x;
+    uint16_t dirty_min_y;
+    uint16_t dirty_max_x;
+    uint16_t dirty_max_y;
+        // If `dirty` is set, the texels which need to be redrawn, inclusive.
+
+    // GL stuff
+    GLuint texture;
+    GLuint framebuffer;
+    GLuint vao;
+    GLuint shaders;
+    GLuint shader_rect;
+    GLuint shader_world_size;
+    GLuint shader_pixel_size;
+    GLuint shader_footprint;
+    GLuint shader_ball;
+} Minimap;
+
+/**
+ * \brief Create the texture for a minimap of a `width` by `height` rectangle
+ * of the world. The whole minimap starts out of date.
+ */
+void Minimap_Init(Minimap *minimap, float width, float height);
+
+/**
+ * \brief Release the resources acquired by `Minimap_Init`.
+ */
+void Minimap_Destroy(Minimap *minimap);
+
+/**
+ * \brief Mark the rectangle with corners at (`min_x`, `min_y`) and (`max_x`,
+ * `max_y`) in world coordinates as needing to be redrawn.
+ */
+void Minimap_Invalidate(Minimap *minimap,
+    float min_x, float min_y, float max_x, float max_y);
+
+/**
+ * \brief Redraw the parts of the minimap which are out of date, if any.
+ *
+ * \details
+ *      This renders straight into the minimap texture, rather than through a
+ *      render queue, so it must be called outside of `RenderQueue_Execute`.
+ *      `draw` is called with depth testing disabled, and must leave no
+ *      program, texture or vertex array bound. Afterwards, the framebuffer and
+ *      viewport which were bound before are restored.
+ */
+void Minimap_Update(Minimap *minimap, Minimap_DrawFunction draw, void *object);
+
+/**
+ * \brief Queue a draw of the minimap in the top right corner of the window.
+ *
+ * \param queue         The queue to submit the draw to.
+ * \param window_width  The size of the window, in pixels.
+ * \param window_height
+ * \param footprint     The corners of the area of the world visible to the
+ *                      camera, in order around its outline.
+ * \param ball          The position of the ball in the XY plane.
+ */
+void Minimap_Submit(Minimap *minimap, RenderQueue *queue,
+    uint32_t window_width, uint32_t window_height,
+    const vec2 footprint[4], const vec2 *ball);
+
+#endif
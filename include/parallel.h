@@ -0,0 +1,88 @@
+/**
+ * \file parallel.h
+ * \brief Splitting data-parallel loops across threads.
+ */
+
+#ifndef GOLF_PARALLEL_H
+#define GOLF_PARALLEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * \brief Maximum number of threads `Parallel_For` will use, including the
+ * calling thread.
+ */
+#define PARALLEL_MAX_THREADS 16
+
+/**
+ * \brief The body of a parallel loop.
+ *
+ * \param begin The first iteration this call is responsible for.
+ * \param end   One past the last iteration this call is responsible for.
+ * \param arg   The argument passed to `Parallel_For`.
+ */
+typedef void (*ParallelBody)(uint32_t begin, uint32_t end, void *arg);
+
+/**
+ * \brief The number of threads `Parallel_For` will split work across.
+ *
+ * \details
+ *      This is the number of online processors, capped at
+ *      `PARALLEL_MAX_THREADS`.
+ */
+uint32_t Parallel_NumThreads(void);
+
+/**
+ * \brief Run `body` over the iterations `[0, n)`, split into contiguous bands
+ * which execute concurrently.
+ *
+ * \param n     The total number of iterations.
+ * \param grain The minimum number of iterations worth handing to a thread.
+ *              Loops with fewer than `2*grain` iterations run entirely on the
+ *              calling thread, so small jobs don't pay for thread creation.
+ * \param body  The loop body. It will be called once per band, possibly from
+ *              several threads at once, so it must not write to any data
+ *              which is shared between bands.
+ * \param arg   Argument passed to every call of `body`.
+ *
+ * `Parallel_For` does not return until every band has finished.
+ */
+void Parallel_For(uint32_t n, uint32_t grain, ParallelBody body, void *arg);
+
+/**
+ * \brief A task running in the background, see `Parallel_Start`.
+ */
+typedef struct ParallelJob ParallelJob;
+
+/**
+ * \brief A function to run in the background.
+ */
+typedef void (*ParallelTask)(void *arg);
+
+/**
+ * \brief Start running `task(arg)` on a new thread, and return without
+ * waiting for it to finish.
+ *
+ * \details
+ *      The task may itself use `Parallel_For`. Until the job has finished, the
+ *      caller must not touch any data the task reads or writes. If we can't
+ *      start a thread, the task runs on the calling thread before this returns.
+ *
+ * \return A handle which must eventually be passed to `Parallel_Join`.
+ */
+ParallelJob *Parallel_Start(ParallelTask task, void *arg);
+
+/**
+ * \brief Check whether a job has finished, without waiting for it.
+ *
+ * Once this returns true, `Parallel_Join` will not block.
+ */
+bool Parallel_IsDone(ParallelJob *job);
+
+/**
+ * \brief Wait for a job to finish, and release the handle.
+ */
+void Parallel_Join(ParallelJob *job);
+
+#endif
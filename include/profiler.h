@@ -0,0 +1,163 @@
+/**
+ * \file profiler.h
+ * \brief Measuring where the time in each frame goes.
+ *
+ * The profiler times a fixed set of zones: stretches of CPU work, like
+ * rendering the views or stepping the physics, and GPU passes, which are timed
+ * with `GL_TIME_ELAPSED` queries. Zones may nest and overlap, and each
+ * measures the inclusive time between its `Profiler_Begin` and `Profiler_End`.
+ * For every zone we keep the time it took in each of the last
+ * `PROFILER_HISTORY` frames in which it ran, and a histogram of all the times
+ * since the last reset.
+ *
+ * Profiling is off by default. While it is off, `Profiler_Begin` and
+ * `Profiler_End` only test a flag, so the zones can stay in release builds.
+ * The profiler must only be used from the thread which owns the GL context.
+ */
+
+#ifndef GOLF_PROFILER_H
+#define GOLF_PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * \brief Number of recent frames summarized for each zone.
+ */
+#define PROFILER_HISTORY 128
+
+/**
+ * \brief Number of buckets in the histogram of each zone.
+ *
+ * Bucket 0 counts samples of 0 microseconds, and bucket `i > 0` counts samples
+ * from `2^(i-1)` up to `2^i` microseconds. The last bucket also counts
+ * anything longer.
+ */
+#define PROFILER_BUCKETS 24
+
+/**
+ * \brief Number of frames a GPU query may run behind before we give up on it.
+ *
+ * Results are only read once they are available, so timing the GPU never
+ * stalls the CPU.
+ */
+#define PROFILER_GPU_LATENCY 4
+
+typedef enum {
+    PROFILE_FRAME,
+        // Everything `ViewManager_Render` does, except waiting for the frame.
+    PROFILE_RENDER,
+        // Rendering the views, which submit their draws to the render queue.
+    PROFILE_ANIMATE,
+        // Advancing the round and the camera.
+    PROFILE_PHYSICS,
+        // Stepping the ball.
+    PROFILE_UPLOADS,
+        // Copying finished terrain rebuilds to the GPU while rendering, and
+        // starting the next.
+    PROFILE_QUEUE,
+        // Sorting and executing the render queue.
+    PROFILE_CONSOLE,
+        // Running console commands.
+    PROFILE_EDITS,
+        // Applying terrain edits and copying them to the GPU, whether they
+        // come from console commands or from the mouse.
+    PROFILE_GPU_SCENE,
+        // GPU time for the scene layers of the render queue.
+    PROFILE_GPU_OVERLAY,
+        // GPU time for the overlay layer of the render queue, such as text.
+    PROFILE_GPU_MINIMAP,
+        // GPU time for redrawing the minimap.
+    PROFILE_ZONES,
+} ProfileZone;
+
+/**
+ * \brief Statistics for one zone over the last `PROFILER_HISTORY` frames in
+ * which it ran.
+ */
+typedef struct {
+    const char *name;
+    uint8_t depth;
+        // How deeply the zone is nested in other zones, for indenting.
+    bool gpu;
+        // Whether the zone measures GPU time rather than CPU time.
+    uint32_t samples;
+        // Number of frames summarized, which is less than `PROFILER_HISTORY`
+        // until the zone has run in that many frames since the last reset, and
+        // may be less for GPU zones if some results were dropped.
+    float avg_ms;
+    float p95_ms;
+    float max_ms;
+} ProfileSummary;
+
+/**
+ * \brief Whether the profiler is on. Use `Profiler_Enable` to change this.
+ */
+extern bool profiler_enabled;
+
+void Profiler_BeginZone(ProfileZone zone);
+void Profiler_EndZone(ProfileZone zone);
+
+/**
+ * \brief Start timing `zone`.
+ *
+ * Calls may be nested, in which case only the outermost pair is timed.
+ */
+static inline void Profiler_Begin(ProfileZone zone)
+{
+    if (profiler_enabled) {
+        Profiler_BeginZone(zone);
+    }
+}
+
+/**
+ * \brief Stop timing `zone`.
+ */
+static inline void Profiler_End(ProfileZone zone)
+{
+    if (profiler_enabled) {
+        Profiler_EndZone(zone);
+    }
+}
+
+/**
+ * \brief Turn the profiler on or off.
+ *
+ * The change takes effect at the end of the current frame, so that no zone is
+ * left half-timed. Turning the profiler on resets it.
+ */
+void Profiler_Enable(bool enable);
+
+/**
+ * \brief Whether the profiler is on, or will be once the current frame ends.
+ */
+bool Profiler_IsEnabled(void);
+
+/**
+ * \brief Record the time each zone took in the frame which just ended, and
+ * collect any GPU timings which have become available.
+ *
+ * This must be called at the end of every frame, whether or not the profiler
+ * is on.
+ */
+void Profiler_EndFrame(void);
+
+/**
+ * \brief Discard all of the samples collected so far.
+ */
+void Profiler_Reset(void);
+
+/**
+ * \brief Summarize the recent history of `zone`.
+ */
+void Profiler_GetSummary(ProfileZone zone, ProfileSummary *summary);
+
+/**
+ * \brief Write the recent history and the histogram of every zone to a file,
+ * as CSV.
+ *
+ * \return Whether the file could be written. On failure, `errno` is set.
+ */
+bool Profiler_Dump(const char *path);
+
+#endif
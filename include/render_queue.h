@@ -0,0 +1,175 @@
+/**
+ * \file render_queue.h
+ * \brief Collecting the draws of a frame and executing them in a sorted order.
+ *
+ * Rather than binding their own programs and issuing draw calls as they are
+ * rendered, views submit draw items to a queue owned by their `ViewManager`.
+ * Each item names the GL state it needs (program, texture, vertex array and
+ * whether blending is enabled) and a function which issues its draw calls.
+ * Once every view has been rendered, the manager sorts the queue so that items
+ * sharing state are adjacent, and executes it, changing only the state which
+ * differs between consecutive items.
+ *
+ * Sorting can reorder draws, which is only safe for draws whose results don't
+ * depend on their order. Items are therefore grouped into layers, which are
+ * always drawn in order, and within a layer items with identical state are
+ * drawn in the order they were submitted.
+ */
+
+#ifndef GOLF_RENDER_QUEUE_H
+#define GOLF_RENDER_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+/**
+ * \brief Groups of draw items which are drawn one after the other.
+ */
+typedef enum {
+    RENDER_LAYER_SCENE,
+        // Surfaces of the 3D scene.
+    RENDER_LAYER_SCENE_DETAIL,
+        // Lines and points drawn onto the scene, which need its surfaces to
+        // already be in the depth buffer.
+    RENDER_LAYER_OVERLAY,
+        // Screen-space drawing, such as text, on top of everything else.
+    RENDER_LAYERS,
+} RenderLayer;
+
+struct RenderItem;
+
+/**
+ * \brief Issue the draw calls for an item.
+ *
+ * \details
+ *      When this is called, the item's program, texture and vertex array are
+ *      bound and blending is set up. The function may set uniforms and bind
+ *      buffers, but must leave the vertex array bound.
+ *
+ * \return The number of draw calls issued.
+ */
+typedef uint32_t (*RenderItem_DrawFunction)(const struct RenderItem *item);
+
+/**
+ * \brief One entry in a `RenderQueue`.
+ */
+typedef struct RenderItem {
+    // State, in the order in which it is sorted.
+    RenderLayer layer;
+    bool blend;
+        // Whether to blend with `GL_SRC_ALPHA`, `GL_ONE_MINUS_SRC_ALPHA`.
+    GLuint program;
+    GLuint texture;
+        // Texture to bind to `GL_TEXTURE_2D` on texture unit 0, or 0 for none.
+    GLuint vao;
+
+    // Drawing
+    RenderItem_DrawFunction draw;
+        // If NULL, the queue draws `count` vertices starting at 0 with
+        // `glDrawArrays`.
+    void *object;
+        // The object which submitted the item, for use by `draw`.
+    GLenum mode;
+    GLsizei count;
+        // Primitive type and number of vertices.
+    const void *data;
+        // Data attached with `RenderQueue_SetData`. Only valid during `draw`.
+
+    // Internal
+    size_t data_offset;
+    uint32_t sequence;
+} RenderItem;
+
+/**
+ * \brief Counts of the work done to execute a queue.
+ */
+typedef struct {
+    uint32_t items;
+    uint32_t draw_calls;
+    uint32_t program_changes;
+    uint32_t texture_changes;
+    uint32_t vao_changes;
+    uint32_t blend_changes;
+} RenderQueueStats;
+
+/**
+ * \brief Called by `RenderQueue_Execute` before drawing each layer.
+ *
+ * It is called for every layer in order, including layers with no items, so
+ * that whatever it starts for one layer can be finished by the next.
+ */
+typedef void (*RenderQueue_LayerFunction)(RenderLayer layer, void *object);
+
+typedef struct {
+    RenderItem *items;
+    uint32_t num_items;
+    uint32_t capacity;
+
+    uint8_t *data;
+    size_t data_size;
+    size_t data_capacity;
+        // Storage for item data, which is copied in as items are submitted
+        // since the caller's copy may not last until the queue is executed.
+
+    RenderQueueStats stats;
+        // Counts for the most recent call to `RenderQueue_Execute`.
+
+    RenderQueue_LayerFunction begin_layer;
+    void *begin_layer_object;
+        // Set with `RenderQueue_SetLayerFunction`; NULL if there is none.
+} RenderQueue;
+
+/**
+ * \brief Initialize an empty queue.
+ */
+void RenderQueue_Init(RenderQueue *queue);
+
+/**
+ * \brief Release the memory used by a queue.
+ */
+void RenderQueue_Destroy(RenderQueue *queue);
+
+/**
+ * \brief Append an item to the queue.
+ *
+ * \return A pointer to the new item, with every field zeroed except for
+ * `blend`, which is set to true. The caller must fill in the rest. The pointer
+ * is only valid until the next call to `RenderQueue_Add` or
+ * `RenderQueue_Execute`.
+ */
+RenderItem *RenderQueue_Add(RenderQueue *queue, RenderLayer layer);
+
+/**
+ * \brief Attach a copy of `size` bytes at `data` to `item`.
+ *
+ * The copy is available to the item's draw function as `item->data`.
+ */
+void RenderQueue_SetData(
+    RenderQueue *queue, RenderItem *item, const void *data, size_t size);
+
+/**
+ * \brief Have `RenderQueue_Execute` call `begin_layer` with `object` before
+ * drawing each layer, or stop calling anything if `begin_layer` is NULL.
+ */
+void RenderQueue_SetLayerFunction(RenderQueue *queue,
+    RenderQueue_LayerFunction begin_layer, void *object);
+
+/**
+ * \brief Draw and then remove all of the items in the queue.
+ *
+ * \details
+ *      Afterwards, no program, texture or vertex array is bound, and blending
+ *      is enabled, which is the state expected by code drawing outside of the
+ *      queue.
+ */
+void RenderQueue_Execute(RenderQueue *queue);
+
+/**
+ * \brief Get the counts for the most recent call to `RenderQueue_Execute`.
+ */
+void RenderQueue_GetStats(const RenderQueue *queue, RenderQueueStats *stats);
+
+#endif
@@ -16,6 +16,8 @@
 #ifndef GOLF_PLAY_H
 #define GOLF_PLAY_H
 
+#include <stdbool.h>
+
 #include "matrix.h"
 #include "physics.h"
 
@@ -68,6 +70,11 @@ void Round_Swing(Round *round, const vec3 *v, const vec3 *s);
  */
 void Round_Step(Round *round, uint32_t dt);
 
+/**
+ * \brief Determine whether the ball is moving, as the result of a shot.
+ */
+bool Round_InMotion(const Round *round);
+
 /**
  * \brief Get the location of the ball associated with this round.
  */
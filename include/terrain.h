@@ -12,9 +12,27 @@
 #include "errors.h"
 #include "matrix.h"
 
+/**
+ * \brief Compact identifiers for materials.
+ *
+ * These are small enough to store in a byte, for example when uploading the
+ * material of every face to the GPU.
+ */
+typedef enum {
+    MATERIAL_FAIRWAY,
+    MATERIAL_GREEN,
+    MATERIAL_TEE,
+    MATERIAL_ROUGH,
+    MATERIAL_SAND,
+    MATERIAL_WATER,
+
+    NUM_MATERIALS,
+} MaterialId;
+
 typedef struct {
     vec4 color;
     const char *name;
+    MaterialId id;
 } Material;
 
 extern const Material fairway;
@@ -24,6 +42,11 @@ extern const Material rough;
 extern const Material sand;
 extern const Material water;
 
+/**
+ * \brief Every material, indexed by `MaterialId`.
+ */
+extern const Material *const materials[NUM_MATERIALS];
+
 typedef struct {
     uint16_t vertices[4];       ///< \brief z-coordinate of the four vertices
                                 ///<
@@ -188,6 +211,38 @@ static inline const Face *Terrain_GetConstFace(
     return &terrain->faces[row*Terrain_FaceWidth(terrain) + col];
 }
 
+/**
+ * \brief Get the height of the vertex at a given position.
+ *
+ * \pre
+ * `row < Terrain_VertexHeight(terrain)`
+ *
+ * \pre
+ * `col < Terrain_VertexWidth(terrain)`
+ */
+static inline uint16_t Terrain_GetVertexHeight(
+    const Terrain *terrain, uint16_t row, uint16_t col)
+{
+    ASSERT(row < Terrain_VertexHeight(terrain));
+    ASSERT(col < Terrain_VertexWidth(terrain));
+
+    // Every vertex is shared by up to four faces, which always agree on its
+    // height, so we can read it from whichever face is guaranteed to exist.
+    if (row < Terrain_FaceHeight(terrain)) {
+        if (col < Terrain_FaceWidth(terrain)) {
+            return Terrain_GetConstFace(terrain, row, col)->vertices[BOTTOM_LEFT];
+        } else {
+            return Terrain_GetConstFace(terrain, row, col - 1)->vertices[BOTTOM_RIGHT];
+        }
+    } else {
+        if (col < Terrain_FaceWidth(terrain)) {
+            return Terrain_GetConstFace(terrain, row - 1, col)->vertices[TOP_LEFT];
+        } else {
+            return Terrain_GetConstFace(terrain, row - 1, col - 1)->vertices[TOP_RIGHT];
+        }
+    }
+}
+
 /**
  * \brief Get a reference to a given hole, if it is defined.
  *
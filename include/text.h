@@ -41,10 +41,12 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 #include "matrix.h"
 #include "pp.h"
+#include "text_batch.h"
 #include "view.h"
 
 /**
@@ -72,31 +74,33 @@ typedef struct {
     bool show_cursor;
 
     char *buffer;       // width x height array of characters being displayed.
-
-
-    // View transformations
-    mat3 transform;
-        // We only use one matrix to represent the full MVP transform for the
-        // text box. This matrix represents a transform from GUI coordinates
-        // (where the origin is in the lower left and the dimensions of the view
-        // correspond to pixels in the window) to 2- dimensional GL clipping
-        // coordinates (where the origin is in the center and the dimensions of
-        // the view are 2x2).
+    TextGlyph *glyphs;  // width x height array of the cells as they were last
+                        // rendered, with the characters as of the flush before
+                        // that. Only the parts which change are rewritten.
+    bool *dirty_rows;   // For each row of `buffer`, whether it has changed
+                        // since its glyphs were last brought up to date.
+    uint8_t scrolled_rows;
+                        // Number of rows `buffer` has scrolled since the
+                        // glyphs were last brought up to date, up to `height`.
+    bool flush_pending; // Whether the characters of the glyphs should be
+                        // brought up to date before the field is next
+                        // rendered.
+    bool restyle;       // Whether the location or colors have changed since
+                        // the field was last rendered, so that every glyph
+                        // has to be rewritten.
+    uint16_t cursor_cell;
+                        // Index in `glyphs` of the cell rendered as the cursor
+                        // as of the last flush, or UINT16_MAX if there is none.
+    uint16_t glyph_cursor_cell;
+                        // Index of the cell drawn as the cursor in `glyphs`,
+                        // which lags `cursor_cell` until the next render.
+    uint16_t changed_begin;
+    uint16_t changed_end;
+                        // Range of `glyphs` rewritten since they were last
+                        // added to the text batch, empty if they are equal.
 
     vec4 fg_color;
     vec4 bg_color;
-
-    // GL stuff
-    GLuint vao;
-    GLuint vertex_positions;
-    GLuint vertex_uv;
-    GLuint vertex_cursor;
-    GLuint shaders;
-    GLuint font_sampler;
-    GLuint font_texture;
-    GLuint mvp;
-    GLuint shader_fg_color;
-    GLuint shader_bg_color;
 } TextField;
 
 /**
@@ -269,6 +273,11 @@ void TextField_Printf(TextField *text_field, const char *fmt, ...);
  * After calling this function, the results of all previous calls to
  * `TextField_PutChar`, `TextField_PutString`, and `TextField_PutLine` will be
  * accurately rendered to the screen at the next call to `TextField_Render`.
+ *
+ * Flushing is cheap, so it's fine to flush after every character. The work of
+ * looking up the new characters in the font is deferred until the field is
+ * rendered, so it happens at most once per frame however often the field is
+ * flushed, and only for the rows which have changed.
  */
 void TextField_Flush(TextField *text_field);
 
@@ -375,6 +384,14 @@ Console *Console_New(
  */
 void Console_RunScript(Console *console, const char *script_path, bool echo);
 
+/**
+ * \brief Execute a single command using the given console.
+ *
+ * `command` is processed as if it had been entered by the user into the
+ * console.
+ */
+void Console_RunCommand(Console *console, const char *command);
+
 /**
  * \defgroup Console_Programming Programming a `Console`
  *
@@ -0,0 +1,145 @@
+/**
+ * \file text_batch.h
+ * \brief Drawing the glyphs of every text field in a single draw call.
+ */
+
+#ifndef GOLF_TEXT_BATCH_H
+#define GOLF_TEXT_BATCH_H
+
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#include "gl.h"
+#include "matrix.h"
+#include "render_queue.h"
+
+/**
+ * \brief Width of a character cell as a fraction of its height.
+ */
+#define TEXT_BATCH_FONT_ASPECT 0.6
+
+/**
+ * \brief Per-instance data for one character cell.
+ */
+typedef struct {
+    GLfloat position[2];
+        // Top left corner of the cell, in pixels from the bottom left corner
+        // of the window.
+    GLfloat uv[2];
+        // Bottom left corner of the character in the font texture (see
+        // `TextBatch_FontCoords`).
+    GLushort size[2];
+        // Width and height of the cell, in pixels.
+    GLubyte fg_color[4];
+    GLubyte bg_color[4];
+        // Colors of the character and of the rest of the cell, in RGBA format.
+} TextGlyph;
+
+/**
+ * \brief The glyphs added to a batch by one text field in a frame.
+ */
+typedef struct {
+    const void *owner;
+    uint32_t first;
+    uint32_t count;
+} TextBatchRun;
+
+/**
+ * \brief Glyphs collected from all of the text fields in a frame.
+ *
+ * \details
+ *      Text fields don't draw anything themselves. Instead, each one appends
+ *      the glyphs for its cells to the batch as it is rendered, and the
+ *      `ViewManager` draws the whole batch as one instanced draw in the
+ *      overlay layer of its render queue, after all of the views have been
+ *      rendered. Since text fields are always below the views they annotate
+ *      in the view tree, they are already rendered after them, so deferring
+ *      the draw doesn't change what ends up on top.
+ *
+ *      Most text doesn't change from one frame to the next, so the glyphs are
+ *      kept in a buffer of their own between frames rather than streamed.
+ *      When a text field adds the same number of glyphs at the same place in
+ *      the batch as it did last frame, only the glyphs it says have changed
+ *      are uploaded again.
+ */
+typedef struct {
+    TextGlyph *glyphs;
+    uint32_t num_glyphs;
+    uint32_t capacity;
+        // Glyphs added since the last draw, and the number which fit in the
+        // `glyphs` array before we have to grow it. Past `num_glyphs`, the
+        // array still holds the glyphs of earlier frames.
+    TextBatchRun *runs;
+    uint32_t num_runs;
+    uint32_t num_prev_runs;
+    uint32_t runs_capacity;
+        // The runs added this frame, followed by the rest of those added last
+        // frame, which are compared with the new runs as they replace them.
+    uint32_t upload_begin;
+    uint32_t upload_end;
+        // Range of `glyphs` which differs from the contents of `buffer`.
+
+    // GL stuff
+    GLuint vao;
+    GLuint buffer;
+    uint32_t buffer_capacity;
+        // Number of glyphs which fit in `buffer`.
+    GLuint shaders;
+    GLuint font_sampler;
+    GLuint font_texture;
+    GLuint mvp;
+    GLuint shader_font_glyph_size;
+
+    // State for the draw submitted by `TextBatch_Submit`
+    mat3 transform;
+} TextBatch;
+
+/**
+ * \brief Create the GL resources for a batch, which starts out empty.
+ */
+void TextBatch_Init(TextBatch *batch);
+
+/**
+ * \brief Release the resources acquired by `TextBatch_Init`.
+ */
+void TextBatch_Destroy(TextBatch *batch);
+
+/**
+ * \brief Get the texture-space coordinates of the bottom left corner of the
+ * character `c` in the font texture.
+ *
+ * Characters which are not in the font are drawn as a question mark.
+ */
+void TextBatch_FontCoords(char c, vec2 *uv);
+
+/**
+ * \brief Append the glyphs of a text field to the batch.
+ *
+ * \param owner         Identifies the text field adding the glyphs.
+ * \param glyphs        The glyphs to append, which are copied.
+ * \param count         The number of glyphs.
+ * \param changed_begin Range of `glyphs` which has changed since `owner` last
+ *                      added them, or an empty range if none has.
+ * \param changed_end
+ *
+ * If `owner` added a different number of glyphs last frame, or its glyphs are
+ * at a different place in the batch, they are all uploaded again.
+ */
+void TextBatch_Add(TextBatch *batch, const void *owner,
+    const TextGlyph *glyphs, uint32_t count,
+    uint32_t changed_begin, uint32_t changed_end);
+
+/**
+ * \brief Queue a draw of all of the glyphs in the batch.
+ *
+ * The batch is cleared once the queue has drawn it.
+ *
+ * \param queue         The queue to submit the draw to.
+ * \param window_width  The width of the window, in pixels.
+ * \param window_height The height of the window, in pixels.
+ */
+void TextBatch_Submit(TextBatch *batch, RenderQueue *queue,
+    uint32_t window_width, uint32_t window_height);
+
+#endif
@@ -120,15 +120,56 @@
 
 #include <stdbool.h>
 
+#include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include "gl.h"
+#include "render_queue.h"
+#include "text_batch.h"
+
 /**
  * \defgroup ViewManager ViewManager: Interface to the main application.
  * @{
  */
 
+/**
+ * \brief Counters describing how well the `ViewManager` is keeping up with its
+ * target frame rate.
+ */
+typedef struct {
+    uint64_t frames;
+        // Frames rendered.
+    uint64_t missed;
+        // Frame deadlines which passed without a frame being started, because
+        // rendering the previous frame took too long.
+    uint64_t background;
+        // Frames rendered at the reduced background rate, because the window
+        // was unfocused or idle.
+} ViewFrameStats;
+
 typedef struct ViewManager {
     GLFWwindow *window;
+        // The managed window, or NULL if the manager is headless (see
+        // `ViewManager_InitHeadless`).
+    uint32_t width;
+    uint32_t height;
+        // Size of the framebuffer a headless manager renders to. Unused when
+        // there is a window, since the window can tell us its own size.
+    uint32_t fixed_dt;
+        // If nonzero, every frame advances time by exactly this many
+        // milliseconds, regardless of how long it actually took to render.
+
+    // Frame pacing (see `ViewManager_SetFrameRate`)
+    uint32_t frame_rate;
+        // Target frames per second, or 0 for no limit.
+    bool vsync;
+    uint64_t frame_deadline;
+        // Time in microseconds at which the last frame was scheduled to start.
+        // The next frame is scheduled one frame period later.
+    uint64_t last_activity;
+        // Time in microseconds of the last input event or call to
+        // `View_KeepAwake`.
+    ViewFrameStats stats;
 
     struct View *roots;
         // First view in the list of top-level trees.
@@ -137,6 +178,16 @@ typedef struct ViewManager {
     uint32_t last_time;
         // Absolute time in milliseconds when the last frame was rendered (or
         // when the manager was created, if nothing has been rendered yet).
+    GL_StreamBuffer stream;
+        // Shared ring buffer for per-frame geometry. This is created on first
+        // use, since the manager is initialized before GL is (see
+        // `View_GetStreamBuffer`).
+    RenderQueue queue;
+        // Draws submitted by views this frame (see `View_GetRenderQueue`).
+    TextBatch text;
+        // Glyphs of all the text fields rendered this frame, which are drawn
+        // together after every view has been rendered. Like `stream`, this is
+        // created on first use (see `View_GetTextBatch`).
 } ViewManager;
 
 /**
@@ -149,6 +200,70 @@ typedef struct ViewManager {
  */
 void ViewManager_Init(ViewManager *manager, GLFWwindow *window);
 
+/**
+ * \brief Initialize a view manager which renders without a window.
+ *
+ * \details
+ *      The caller is responsible for making a GL context current and binding a
+ *      `width` by `height` framebuffer to draw to. Views see a window of that
+ *      size, with the cursor resting in the middle of it, and receive no input
+ *      events. `ViewManager_Render` leaves the finished frame in the bound
+ *      framebuffer instead of swapping buffers.
+ */
+void ViewManager_InitHeadless(
+    ViewManager *manager, uint32_t width, uint32_t height);
+
+/**
+ * \brief Limit the rate at which `ViewManager_Render` renders frames.
+ *
+ * \details
+ *      `ViewManager_Render` waits until one frame period has passed since the
+ *      last frame was scheduled before rendering the next one. It sleeps for
+ *      most of the wait and spins for the last fraction of a millisecond, so
+ *      frames start on time despite the coarse granularity of sleeping. If a
+ *      frame takes so long that the deadline for the next one passes, the
+ *      missed frames are counted (see `ViewManager_GetFrameStats`) and the
+ *      schedule restarts from the current time, rather than rushing out
+ *      frames to catch up.
+ *
+ *      While the window is unfocused or minimized, or no input has arrived for
+ *      a while (and no view has asked to stay awake with `View_KeepAwake`),
+ *      frames are rendered at a much lower background rate to save CPU.
+ *
+ * \param fps   Target frames per second, or 0 to render frames as fast as
+ *              possible. The default is 60.
+ */
+void ViewManager_SetFrameRate(ViewManager *manager, uint32_t fps);
+
+/**
+ * \brief Synchronize frames with the display's refresh rate.
+ *
+ * \details
+ *      With vsync enabled, swapping buffers blocks until the next vertical
+ *      blank, which paces rendering in place of the frame rate limit set by
+ *      `ViewManager_SetFrameRate`. The background rate still applies.
+ */
+void ViewManager_SetVSync(ViewManager *manager, bool vsync);
+
+/**
+ * \brief Get counters describing the frames rendered so far.
+ */
+void ViewManager_GetFrameStats(
+    const ViewManager *manager, ViewFrameStats *stats);
+
+/**
+ * \brief Advance time by a fixed amount each frame.
+ *
+ * \details
+ *      By default, each frame is passed the real time elapsed since the last
+ *      one, and rendering is throttled to a reasonable frame rate. With a fixed
+ *      time step of `dt` milliseconds, animations instead proceed the same way
+ *      no matter how fast frames are rendered, and frames are rendered as fast
+ *      as possible. This makes rendering deterministic, which is useful for
+ *      benchmarks and regression tests. Passing 0 restores the default.
+ */
+void ViewManager_SetFixedTimeStep(ViewManager *manager, uint32_t dt);
+
 /**
  * \brief Close a `ViewManager`.
  *
@@ -419,6 +534,48 @@ static inline ViewManager *View_GetManager(View *view)
     return view->manager;
 }
 
+/**
+ * \brief Get the buffer which this view's per-frame geometry should be streamed
+ * through.
+ *
+ * \details
+ *      The buffer is shared by every view under the same `ViewManager`, which
+ *      marks the end of each frame after rendering all of the views. See
+ *      `GL_StreamBuffer_Upload` for how long uploaded data remains valid.
+ */
+GL_StreamBuffer *View_GetStreamBuffer(View *view);
+
+/**
+ * \brief Get the queue which this view should submit its draws to.
+ *
+ * \details
+ *      The queue is shared by every view under the same `ViewManager`, which
+ *      sorts and executes it after rendering all of the views. Views may still
+ *      draw directly from their render callbacks, but those draws happen before
+ *      anything in the queue.
+ */
+RenderQueue *View_GetRenderQueue(View *view);
+
+/**
+ * \brief Get the batch which text rendered by this view should be added to.
+ *
+ * \details
+ *      The batch is shared by every view under the same `ViewManager`, which
+ *      draws it after rendering all of the views, so text is always drawn on
+ *      top of everything else.
+ */
+TextBatch *View_GetTextBatch(View *view);
+
+/**
+ * \brief Keep rendering at the full frame rate.
+ *
+ * \details
+ *      Views which are animating without user input (for example, showing a
+ *      ball in flight) should call this each frame, so that the manager doesn't
+ *      decide the window is idle and drop to the background frame rate.
+ */
+void View_KeepAwake(View *view);
+
 /**
  * \brief Get the dimensions of the window containing this view.
  */
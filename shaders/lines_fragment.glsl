@@ -1,8 +1,19 @@
 #version 330 core
 
+in vec4 frag_color;
+in float frag_depth_fade;
+
 out vec4 color;
 
 void main()
 {
-    color = vec4(1);
+    float fade = mix(1.0, 1.0 - gl_FragCoord.z, frag_depth_fade);
+        // Lines which fade with depth use 1 - z for the alpha channel. This is
+        // used for the axes, so that they get darker as they move away from
+        // the camera. This makes it possible to visually determine which way
+        // the coordinate system is oriented without playing around with it
+        // dynamically. This also makes it possible to distinguish between a
+        // left-handed coordinate system (which is a bug) and a right-handed
+        // one just by looking.
+    color = vec4(frag_color.rgb, frag_color.a * fade);
 }
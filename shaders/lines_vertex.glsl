@@ -1,10 +1,17 @@
 #version 330 core
 
 layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 vert_color;
+layout(location = 7) in float vert_depth_fade;
 uniform mat4 mvp;
     // The model-view-projection matrix.
 
+out vec4 frag_color;
+out float frag_depth_fade;
+
 void main()
 {
     gl_Position = mvp * vec4(position, 1);
+    frag_color = vert_color;
+    frag_depth_fade = vert_depth_fade;
 }
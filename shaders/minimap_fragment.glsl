@@ -0,0 +1,49 @@
+#version 330 core
+
+in vec2 uv;
+
+out vec4 color;
+
+uniform sampler2D minimap;
+uniform vec2 world_size;
+    // The size of the world covered by the minimap.
+uniform float pixel_size;
+    // The size of one pixel of the minimap on screen, in world coordinates.
+uniform vec2 footprint[4];
+    // The corners of the area visible to the camera, in world coordinates.
+uniform vec2 ball;
+    // The position of the ball, in world coordinates.
+
+const float FOOTPRINT_WIDTH = 1.0;
+const float BALL_RADIUS = 2.5;
+    // Sizes of the overlays, in pixels.
+
+// The distance from `p` to the line segment from `a` to `b`.
+float segment_distance(vec2 p, vec2 a, vec2 b)
+{
+    vec2 ab = b - a;
+    float t = clamp(dot(p - a, ab)/max(dot(ab, ab), 1e-6), 0.0, 1.0);
+    return distance(p, a + t*ab);
+}
+
+void main()
+{
+    color = vec4(texture(minimap, uv).rgb, 1);
+        // The terrain may have been drawn with some transparency, but the
+        // minimap covers whatever is behind it.
+
+    // The overlays change every frame, so rather than rendering them into the
+    // texture, we draw them on top of it here. Testing a handful of shapes
+    // per fragment of a small quad is much cheaper than redrawing the texture.
+    vec2 p = uv*world_size;
+    float d = segment_distance(p, footprint[3], footprint[0]);
+    for (int i = 1; i < 4; ++i) {
+        d = min(d, segment_distance(p, footprint[i - 1], footprint[i]));
+    }
+    if (d <= FOOTPRINT_WIDTH*pixel_size) {
+        color = vec4(1, 1, 1, 1);
+    }
+    if (distance(p, ball) <= BALL_RADIUS*pixel_size) {
+        color = vec4(1, 1, 1, 1);
+    }
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+uniform vec4 rect;
+    // Left, bottom, right and top edges of the minimap, in clip coordinates.
+
+out vec2 uv;
+
+void main()
+{
+    uv = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+        // The minimap is drawn as a triangle strip of 4 vertices, so this runs
+        // through the corners (0, 0), (1, 0), (0, 1), (1, 1), starting from
+        // the bottom left.
+    gl_Position = vec4(mix(rect.xy, rect.zw, uv), -1, 1);
+        // Like text, the minimap goes on the front clipping plane.
+}
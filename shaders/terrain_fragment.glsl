@@ -5,10 +5,15 @@ uniform uint mesh;
 uniform vec3 light_position;
     // The position of the light in terrain-space.
 uniform vec4 light_color;
+uniform vec4 palette[16];
+    // The color of each material, indexed by material ID.
 
-in vec4 frag_color;
+flat in uint frag_material;
 in vec3 frag_normal;
     // The normal vector for the fragment, in terrain-space.
+in float frag_occlusion;
+    // The fraction of the sky which is visible from the fragment, rather than
+    // hidden behind surrounding terrain.
 out vec4 color;
 
 const float ambient_strength = 0.4;
@@ -29,11 +34,16 @@ void main()
         return;
     }
 
-    vec4 ambient_color = frag_color;
+    vec4 frag_color = palette[frag_material];
+
+    vec4 ambient_color = frag_color*frag_occlusion;
         // The portion of the final color due to ambient lighting of the
         // terrain. This simulates the way light bouncing off of nearby surfaces
-        // can illuminate even surfaces which aren't facing the light, and so it
-        // doesn't depend on the position or orientation of the fragment.
+        // can illuminate even surfaces which aren't facing the light, so it
+        // doesn't depend on the orientation of the fragment. It does depend on
+        // how much of the sky the fragment can see, though, so valleys and
+        // bunkers, which are partly enclosed by the terrain around them,
+        // receive less of it.
 
     float cos_theta = clamp(
         dot(normalize(frag_normal), normalize(light_position)), 0, 1);
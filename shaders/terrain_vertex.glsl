@@ -1,19 +1,101 @@
 #version 330 core
 
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec4 vert_color;
 layout(location = 4) in vec3 vert_normal;
+layout(location = 5) in uint vert_material;
+layout(location = 8) in float vert_occlusion;
+    // The fraction of the sky visible from this vertex, baked on the CPU.
 uniform mat4 mvp;
     // The model-view-projection matrix.
+uniform usampler2D heights;
+    // The height of each vertex in the terrain grid, indexed by column and
+    // row.
+uniform float xy_resolution;
+    // The length and width of each face, in yards.
+uniform vec3 camera_position;
+    // The position of the camera, in terrain space.
+uniform int lod_stride;
+    // The number of faces between neighbouring vertices in the grid we are
+    // drawing, which is coarser than the full terrain grid when the terrain is
+    // far from the camera.
+uniform vec2 morph_range;
+    // Distances from the camera at which vertices begin and finish morphing
+    // onto the grid with twice the spacing of this one.
+uniform uint mesh;
+    // Are we drawing the edges of the mesh, or the faces?
 
-out vec4 frag_color;
+const float MESH_DEPTH_BIAS = 0.0003;
+    // How far to move the mesh towards the camera, in normalized device
+    // coordinates.
+
+flat out uint frag_material;
+    // Materials are per-face, not per-vertex, so we don't interpolate them.
+    // The material of a face is stored in the provoking (last) vertex of both
+    // of its triangles.
 out vec3 frag_normal;
+out float frag_occlusion;
+
+float height(ivec2 vertex)
+{
+    return float(texelFetch(heights, vertex, 0).r);
+}
+
+// The height of the surface drawn at twice the current grid spacing, at the
+// location of `grid`. Blocks of that grid are aligned to multiples of their
+// size, except that they are cut short by the edges of the terrain, and are
+// split into two triangles along the diagonal from their bottom left to top
+// right corners.
+float coarse_height(ivec2 grid)
+{
+    ivec2 size = textureSize(heights, 0);
+    int spacing = 2*lod_stride;
+    ivec2 bl = (grid / spacing) * spacing;
+    ivec2 tr = min(bl + spacing, size - 1);
+    vec2 uv = vec2(grid - bl) / vec2(max(tr - bl, 1));
+        // Position of the vertex within its block, from 0 to 1.
+
+    float z_bl = height(bl);
+    float z_tr = height(tr);
+    float z_tl = height(ivec2(bl.x, tr.y));
+    float z_br = height(ivec2(tr.x, bl.y));
+    if (uv.x >= uv.y) {
+        // Bottom right triangle.
+        return z_bl + uv.x*(z_br - z_bl) + uv.y*(z_tr - z_br);
+    } else {
+        // Top left triangle.
+        return z_bl + uv.y*(z_tl - z_bl) + uv.x*(z_tr - z_tl);
+    }
+}
 
 void main()
 {
+    int width = textureSize(heights, 0).x;
+    ivec2 grid = ivec2(gl_VertexID % width, gl_VertexID / width);
+        // Vertices are numbered in row-major order, so we can recover the
+        // column and row of this vertex from its index, and from that its
+        // position in the XY plane.
+    vec3 position = vec3(xy_resolution*vec2(grid), height(grid));
+
+    // Vertices near the end of their level of detail's range slide vertically
+    // onto the coarser surface drawn beyond it. Once fully morphed, the finer
+    // triangles lie exactly on the coarser ones, so there are no cracks where
+    // chunks at different levels meet, and no popping when a chunk switches.
+    float morph = clamp(
+        (distance(position, camera_position) - morph_range.x) /
+            (morph_range.y - morph_range.x),
+        0.0, 1.0);
+    if (morph > 0.0) {
+        position.z = mix(position.z, coarse_height(grid), morph);
+    }
+
     gl_Position = mvp * vec4(position, 1);
-    frag_color = vert_color;
+    if (bool(mesh)) {
+        gl_Position.z -= MESH_DEPTH_BIAS*gl_Position.w;
+            // Pull the edges slightly towards the camera, so they aren't hidden
+            // by the faces they border, which are already in the depth buffer.
+    }
+    frag_material = vert_material;
     frag_normal = vert_normal;
+    frag_occlusion = vert_occlusion;
         // Unlike the position output, which we multiplied by MVP to convert
         // from terrain-space to clip-space, the normal vector stays in terrain-
         // space. This is allowed because the normal vector is only used to
@@ -1,30 +1,32 @@
 #version 330 core
 
 in vec2 uv;
-flat in uint cursor;
+flat in vec4 fg_color;
+flat in vec4 bg_color;
 
 out vec4 color;
 
 uniform sampler2D font;
-uniform vec4 fg_color;
-uniform vec4 bg_color;
+    // Signed distance field of the font, which is above one half inside the
+    // characters.
 
 void main()
 {
-    float alpha = texture(font, uv).w;
-        // The texture is black-and-white, so we only care about the alpha
-        // channel, not the value.
+    float distance = texture(font, uv).r - 0.5;
+    float alpha = clamp(distance/max(fwidth(distance), 1e-5) + 0.5, 0, 1);
+        // Dividing by the change in distance across one pixel gives the
+        // distance to the edge in pixels, so the edge is antialiased over
+        // about one pixel however large or small the text is drawn. Away from
+        // the edges the field is flat, and the guard against dividing by zero
+        // still leaves alpha at 0 or 1.
 
-    // For most fragments, we set the color by blending the foreground color
-    // with alpha `alpha` and the background color with alpha `1 - alpha`. For
-    // fragments within a character, `alpha` will be `1`, so character fragments
-    // get the foreground color. Fragments outside a character will have alpha
-    // `0`, and will get the background color.
+    // We set the color by blending the foreground color with alpha `alpha` and
+    // the background color with alpha `1 - alpha`. For fragments within a
+    // character, `alpha` will be `1`, so character fragments get the
+    // foreground color. Fragments outside a character will have alpha `0`, and
+    // will get the background color.
     //
-    // For fragments under the cursor (`cursor == 1`), we swap the alpha values
-    // that we give to the foreground and background colors. This has the effect
-    // of swapping the foreground and background color to indicate the position
-    // of the cursor.
-    color = (bool(cursor) ? 1-alpha : alpha  )*fg_color +
-            (bool(cursor) ? alpha   : 1-alpha)*bg_color;
+    // The cell under the cursor has its foreground and background colors
+    // swapped before it gets here, to indicate the position of the cursor.
+    color = alpha*fg_color + (1-alpha)*bg_color;
 }
@@ -1,16 +1,30 @@
 #version 330 core
 
 uniform mat3 mvp;
+uniform vec2 font_glyph_size;
+    // The size of one character in the font texture, in texture coordinates.
 
-layout(location = 0) in vec2 position;
-layout(location = 2) in vec2 vertex_uv;
-layout(location = 3) in uint vertex_cursor;
+// Each instance is one character cell.
+layout(location = 0) in vec2 glyph_position;
+    // Top left corner of the cell.
+layout(location = 2) in vec2 glyph_uv;
+    // Bottom left corner of the character in the font texture.
+layout(location = 3) in vec2 glyph_size;
+layout(location = 1) in vec4 glyph_fg_color;
+layout(location = 6) in vec4 glyph_bg_color;
 
 out vec2 uv;
-flat out uint cursor;
+flat out vec4 fg_color;
+flat out vec4 bg_color;
 
 void main()
 {
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+        // The cell is drawn as a triangle strip of 4 vertices, so this runs
+        // through the corners (0, 0), (1, 0), (0, 1), (1, 1), starting from
+        // the bottom left.
+    vec2 position = glyph_position + glyph_size*vec2(corner.x, corner.y - 1);
+
     gl_Position.xyw = mvp*vec3(position, 1);
         // Assign 1 to the w-coordinate, since these are position vectors. We
         // are given a 3x3 MVP matrix, since we're dealing with 2-dimensional
@@ -25,6 +39,7 @@ void main()
         // places them on the front clipping plane.
 
     // Pass-throughs to the fragment shader.
-    uv = vertex_uv;
-    cursor = vertex_cursor;
+    uv = glyph_uv + font_glyph_size*corner;
+    fg_color = glyph_fg_color;
+    bg_color = glyph_bg_color;
 }
@@ -0,0 +1,39 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "assets.h"
+#include "errors.h"
+
+static const char *asset_directory = NULL;
+
+void Assets_SetDirectory(const char *directory)
+{
+    asset_directory = directory;
+}
+
+const char *Assets_GetDirectory(void)
+{
+    return asset_directory;
+}
+
+char *Assets_OverridePath(const char *path)
+{
+    ASSERT(asset_directory != NULL);
+
+    char *override = Malloc(strlen(asset_directory) + strlen(path) + 2);
+    sprintf(override, "%s/%s", asset_directory, path);
+    return override;
+}
+
+const Asset *Assets_Find(const char *path)
+{
+    for (uint32_t i = 0; i < NUM_ASSETS; ++i) {
+        if (strcmp(ASSETS[i].path, path) == 0) {
+            return &ASSETS[i];
+        }
+    }
+
+    Error_Raise(FATAL, ERR_IO, "asset not found");
+    return NULL;
+}
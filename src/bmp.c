@@ -0,0 +1,184 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bmp.h"
+#include "errors.h"
+
+typedef struct __attribute__((__packed__)) {
+    // File header
+    char magic_number[2];   // Must be "BM"
+    uint32_t file_size;
+    uint8_t reserved1[2];
+    uint8_t reserved2[2];
+    uint32_t data_offset;
+
+    // DIB header
+    uint32_t header_size;   // Size of this header. This is typically used to
+                            // figure out which version of the header we're
+                            // working with, as later versions add lots of extra
+                            // features after the core DIB header. We don't care
+                            // about this header, so we'll just ignore this
+                            // field and only use the fields which are common to
+                            // all versions.
+    uint32_t width;         // Width in pixels.
+    uint32_t height;        // Height in pixels;
+    uint16_t num_color_planes;
+                            // Always 1
+    uint16_t bit_depth;
+    uint32_t compression_method;
+    uint32_t image_size;
+    uint32_t x_resolution;
+    uint32_t y_resolution;
+    uint32_t num_colors;
+    uint32_t num_important_colors;
+
+    // Bit field masks, only present in version 3 of the DIB header and later.
+    // These give the bits of each 32-bit pixel which hold each channel.
+    uint32_t masks[4];      // Red, green, blue, alpha
+} BmpHeader;
+
+typedef enum {
+    BMP_PIXEL_RGBA,
+    BMP_PIXEL_UNSUPPORTED,
+} BmpPixelLayout;
+
+static void BMP_ReadHeader(BmpHeader *header, FILE *bmp)
+{
+    if (fread(header, 1, sizeof(*header), bmp) != sizeof(*header)) {
+        Error_Raise(FATAL, ERR_IO, "unable to read bitmap header");
+    }
+    if (header->magic_number[0] != 'B' ||
+        header->magic_number[1] != 'M') {
+        Error_Raise(FATAL, ERR_IO, "invalid bitmap texture");
+    }
+
+    trace("Read bitmap header:"
+          "    size:        %u\n"
+          "    data offset: 0x%x\n"
+          "    header size: %u\n"
+          "    image size:  %ux%u\n"
+          "    bit depth:   %u\n"
+          "    compression: %u\n",
+        header->file_size, header->data_offset,
+        header->header_size, header->width, header->height,
+        header->bit_depth, header->compression_method
+    );
+
+    // Validate the header.
+    switch (header->bit_depth) {
+        case 8:
+        case 16:
+        case 24:
+        case 32:
+            break;
+        default:
+            Error_Raise(FATAL, ERR_IO, "invalid bitmap bit depth");
+    }
+}
+
+static uint8_t *BMP_ReadData(const BmpHeader *header, FILE *bmp)
+    // This function allocates space for the pixel data using `Malloc`, remember
+    // to free the result when finished with it.
+{
+    // Find the start of the data.
+    uint32_t data_offset = header->data_offset
+                            ? header->data_offset
+                            : header->header_size;
+    fseek(bmp, data_offset, SEEK_SET);
+
+    // Compute the size of the image. The `image_size` field in the header is
+    // not always reliable, sometimes it is incorrectly 0.
+    ASSERT(header->bit_depth % 8 == 0);
+    uint32_t data_size =
+        header->image_size
+            ? header->image_size
+            : header->width*header->height*(header->bit_depth/8);
+
+    // Read in the data.
+    uint8_t *pixels = Malloc(data_size);
+    if (fread(pixels, 1, data_size, bmp) != data_size) {
+        Error_Raise(FATAL, ERR_IO, "unable to read bitmap data");
+    }
+    return pixels;
+}
+
+static BmpPixelLayout BMP_GetPixelLayout(const BmpHeader *header)
+{
+    if (header->compression_method == 3 &&
+            // Compression method 3 can indicate one of several things,
+            // depending on header version:
+            //  * OS22X header: Huffman 1D compression
+            //  * BITMAPV2 header: RGB bit field masks
+            //  * BITMAPV3+ header: RGBA 32-bit encoding
+            // Of these, we only support the RGBA encoding, so we next check if
+            // this header is V3+.
+        header->header_size >= 56
+            // Bitmap header version is indicated by the size of the header;
+            // The size increases with the version. The V3 header is 56 bytes,
+            // subsequent headers are larger.
+        ) {
+        return BMP_PIXEL_RGBA;
+    }
+
+    return BMP_PIXEL_UNSUPPORTED;
+}
+
+// Get the 8-bit value of the channel selected by `mask` from a pixel.
+static uint8_t BMP_ExtractChannel(uint32_t pixel, uint32_t mask)
+{
+    if (mask == 0) {
+        return 0xff;
+            // The channel is missing. Treat it as saturated, which for alpha
+            // means fully opaque.
+    }
+
+    uint8_t shift = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        ++shift;
+    }
+    return (uint64_t)(pixel >> shift & mask)*0xff/mask;
+        // Scale channels narrower than 8 bits up to the full range.
+}
+
+uint8_t *BMP_Load(const char *path, uint32_t *width, uint32_t *height)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        Error_Raise(FATAL, ERR_IO, strerror(errno));
+    }
+
+    // Read in the header.
+    BmpHeader header;
+    BMP_ReadHeader(&header, file);
+    if (BMP_GetPixelLayout(&header) != BMP_PIXEL_RGBA) {
+        Error_Raise(FATAL, ERR_IO, "unsupported bitmap pixel format");
+    }
+    ASSERT(header.bit_depth == 32);
+
+    // Bring the pixel data into memory.
+    uint8_t *data = BMP_ReadData(&header, file);
+
+    // All the data is in memory now, we're done with the file.
+    fclose(file);
+
+    // Each pixel is a little-endian 32-bit word, which the masks in the header
+    // split into channels. Rearrange them into bytes in RGBA order. Rows are
+    // already stored from the bottom up, as GL wants them.
+    uint32_t num_pixels = header.width*header.height;
+    for (uint32_t i = 0; i < num_pixels; ++i) {
+        uint8_t *pixel = &data[4*i];
+        uint32_t word = (uint32_t)pixel[0]       | (uint32_t)pixel[1] << 8 |
+                        (uint32_t)pixel[2] << 16 | (uint32_t)pixel[3] << 24;
+        for (uint8_t channel = 0; channel < 4; ++channel) {
+            pixel[channel] = BMP_ExtractChannel(word, header.masks[channel]);
+        }
+    }
+
+    *width = header.width;
+    *height = header.height;
+    return data;
+}
@@ -9,7 +9,7 @@
 
 #ifdef GOLF_OS_POSIX
 
-uint64_t Clock_GetTimeMS(void)
+static struct timespec Clock_GetTime(void)
 {
     struct timespec ts = {0};
     clock();
@@ -32,12 +32,32 @@ uint64_t Clock_GetTimeMS(void)
         }
     }
 
+    return ts;
+}
+
+uint64_t Clock_GetTimeMS(void)
+{
+    struct timespec ts = Clock_GetTime();
     return ts.tv_sec*1000 + ts.tv_nsec/1000000;
 }
 
+uint64_t Clock_GetTimeUS(void)
+{
+    struct timespec ts = Clock_GetTime();
+    return ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
 void Clock_SleepMS(uint32_t ms)
 {
-    struct timespec ts = { .tv_sec = 0, .tv_nsec = ms*1000000 };
+    Clock_SleepUS(ms*1000);
+}
+
+void Clock_SleepUS(uint32_t us)
+{
+    struct timespec ts = {
+        .tv_sec = us/1000000,
+        .tv_nsec = (long)(us%1000000)*1000
+    };
     nanosleep(&ts, NULL);
 }
 
@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include "errors.h"
+#include "profiler.h"
 #include "text.h"
 
 #if !(_SVID_SOURCE || _BSD_SOURCE || _POSIX_C_SOURCE >= 1 || _XOPEN_SOURCE || _POSIX_SOURCE)
@@ -239,7 +240,9 @@ static void Console_HandleLine(TextInput *text_input, char *line)
 
     // Run the command.
     ASSERT(command->type == RUN_COMMAND);
+    Profiler_Begin(PROFILE_CONSOLE);
     command->impl.run(console, console->state, argc, argv);
+    Profiler_End(PROFILE_CONSOLE);
 }
 
 Console *Console_New(
@@ -315,3 +318,13 @@ void Console_RunScript(Console *console, const char *script_path, bool echo)
         Console_HandleLine((TextInput *)console, line);
     }
 }
+
+void Console_RunCommand(Console *console, const char *command)
+{
+    size_t length = strlen(command) + 1;
+    char line[length];
+    memcpy(line, command, length);
+        // `Console_HandleLine` tokenizes the line in place, so give it a copy.
+
+    Console_HandleLine((TextInput *)console, line);
+}
@@ -0,0 +1,192 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "distance_field.h"
+#include "errors.h"
+#include "matrix.h"
+#include "parallel.h"
+
+#define DISTANCE_FIELD_LINES_PER_THREAD 64
+    // Minimum number of rows or columns of the fine grid worth transforming on
+    // a separate thread.
+
+#define DISTANCE_FIELD_FAR 1e20f
+    // Squared distance of samples with no feature yet. It only has to be
+    // bigger than any real squared distance on the grid.
+
+// The fine grid, shared by every band of a transform.
+typedef struct {
+    float *inside;
+        // For samples inside a shape, the squared distance to the nearest
+        // sample outside, in samples. Far for samples outside.
+    float *outside;
+        // For samples outside every shape, the squared distance to the nearest
+        // sample inside. Far for samples inside.
+    uint32_t width;
+    uint32_t height;
+} DistanceGrid;
+
+// Compute the lower envelope of the parabolas rooted at each of the `n` points
+// of `f`, that is `d[q] = min_p (q - p)^2 + f[p]`. `v` and `z` are scratch
+// space for `n` and `n + 1` elements.
+static void DistanceField_Transform(
+    const float *f, uint32_t n, float *d, uint32_t *v, float *z)
+{
+    uint32_t k = 0;
+        // Index in `v` of the rightmost parabola in the envelope so far.
+    v[0] = 0;
+    z[0] = -DISTANCE_FIELD_FAR;
+    z[1] = DISTANCE_FIELD_FAR;
+        // Parabola `v[k]` is lowest between `z[k]` and `z[k + 1]`.
+
+    for (uint32_t q = 1; q < n; ++q) {
+        float s;
+        for (;;) {
+            uint32_t p = v[k];
+            s = ((f[q] + (float)q*q) - (f[p] + (float)p*p))/(2.0f*q - 2.0f*p);
+                // Where the parabolas rooted at `p` and `q` intersect.
+            if (s > z[k] || k == 0) {
+                break;
+            }
+            --k;
+                // Parabola `p` is below `q` nowhere in its range, so it isn't
+                // part of the envelope.
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = DISTANCE_FIELD_FAR;
+    }
+
+    k = 0;
+    for (uint32_t q = 0; q < n; ++q) {
+        while (z[k + 1] < q) {
+            ++k;
+        }
+        float dq = (float)q - v[k];
+        d[q] = dq*dq + f[v[k]];
+    }
+}
+
+// Transform `n` lines of both grids, each `length` samples long. The samples
+// of line `i` start at `i*line_step` and are `sample_step` apart.
+static void DistanceField_TransformLines(const DistanceGrid *grid,
+    uint32_t begin, uint32_t end, uint32_t length,
+    uint32_t line_step, uint32_t sample_step)
+{
+    float *f = Malloc(length*sizeof(float));
+    float *d = Malloc(length*sizeof(float));
+    uint32_t *v = Malloc(length*sizeof(uint32_t));
+    float *z = Malloc((length + 1)*sizeof(float));
+
+    float *grids[2] = { grid->inside, grid->outside };
+    for (uint32_t line = begin; line < end; ++line) {
+        for (uint8_t g = 0; g < 2; ++g) {
+            float *samples = grids[g] + line*line_step;
+            for (uint32_t i = 0; i < length; ++i) {
+                f[i] = samples[i*sample_step];
+            }
+            DistanceField_Transform(f, length, d, v, z);
+            for (uint32_t i = 0; i < length; ++i) {
+                samples[i*sample_step] = d[i];
+            }
+        }
+    }
+
+    free(f);
+    free(d);
+    free(v);
+    free(z);
+}
+
+static void DistanceField_TransformColumns(
+    uint32_t begin, uint32_t end, void *arg)
+{
+    const DistanceGrid *grid = (const DistanceGrid *)arg;
+    DistanceField_TransformLines(
+        grid, begin, end, grid->height, 1, grid->width);
+}
+
+static void DistanceField_TransformRows(
+    uint32_t begin, uint32_t end, void *arg)
+{
+    const DistanceGrid *grid = (const DistanceGrid *)arg;
+    DistanceField_TransformLines(
+        grid, begin, end, grid->width, grid->width, 1);
+}
+
+// Bilinearly interpolate the coverage of the mask at a point, in texels from
+// the center of the bottom left texel.
+static float DistanceField_Coverage(const uint8_t *mask, uint32_t width,
+    uint32_t height, uint32_t stride, float x, float y)
+{
+    x = FloatClamp(x, 0, width - 1);
+    y = FloatClamp(y, 0, height - 1);
+    uint32_t x0 = (uint32_t)x;
+    uint32_t y0 = (uint32_t)y;
+    uint32_t x1 = UintMin(x0 + 1, width - 1);
+    uint32_t y1 = UintMin(y0 + 1, height - 1);
+    float tx = x - x0;
+    float ty = y - y0;
+
+    float bottom = (1 - tx)*mask[(y0*width + x0)*stride] +
+                   tx*mask[(y0*width + x1)*stride];
+    float top = (1 - tx)*mask[(y1*width + x0)*stride] +
+                tx*mask[(y1*width + x1)*stride];
+    return (1 - ty)*bottom + ty*top;
+}
+
+void DistanceField_Compute(const uint8_t *mask, uint32_t width,
+    uint32_t height, uint32_t stride, uint8_t spread, uint8_t *field)
+{
+    ASSERT(width > 0 && height > 0 && spread > 0);
+
+    const uint32_t k = DISTANCE_FIELD_UPSAMPLE;
+    DistanceGrid grid;
+    grid.width = k*width;
+    grid.height = k*height;
+    grid.inside = Malloc(grid.width*grid.height*sizeof(float));
+    grid.outside = Malloc(grid.width*grid.height*sizeof(float));
+
+    // Classify every sample of the fine grid as inside or outside, by whether
+    // the interpolated coverage there is more than half. Each sample is a
+    // feature of the transform which measures distances to its class.
+    for (uint32_t row = 0; row < grid.height; ++row) {
+        for (uint32_t col = 0; col < grid.width; ++col) {
+            float coverage = DistanceField_Coverage(mask, width, height,
+                stride, (col + 0.5f)/k - 0.5f, (row + 0.5f)/k - 0.5f);
+            bool inside = coverage > 127.5f;
+            uint32_t i = row*grid.width + col;
+            grid.inside[i] = inside ? DISTANCE_FIELD_FAR : 0;
+            grid.outside[i] = inside ? 0 : DISTANCE_FIELD_FAR;
+        }
+    }
+
+    // The squared Euclidean distance is separable: transforming every column
+    // and then every row gives the exact distance to the nearest feature.
+    Parallel_For(grid.width, DISTANCE_FIELD_LINES_PER_THREAD,
+        DistanceField_TransformColumns, &grid);
+    Parallel_For(grid.height, DISTANCE_FIELD_LINES_PER_THREAD,
+        DistanceField_TransformRows, &grid);
+
+    // Read the distance at the center of each texel of the mask.
+    for (uint32_t row = 0; row < height; ++row) {
+        for (uint32_t col = 0; col < width; ++col) {
+            uint32_t i = (k*row + k/2)*grid.width + k*col + k/2;
+            float distance = grid.inside[i] > 0
+                ?   sqrtf(grid.inside[i]) - 0.5f
+                : -(sqrtf(grid.outside[i]) - 0.5f);
+                // The edge is halfway between the nearest samples on either
+                // side of it.
+            distance /= k;
+
+            float value = 128 + distance*127/spread;
+            field[row*width + col] = (uint8_t)FloatClamp(value + 0.5f, 0, 255);
+        }
+    }
+
+    free(grid.inside);
+    free(grid.outside);
+}
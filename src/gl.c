@@ -1,17 +1,128 @@
+#include "os.h"
+
 #include <errno.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef GOLF_OS_POSIX
+#include <sys/stat.h>
+#endif
+
 #include <GL/glew.h>
 
+#include "assets.h"
+#include "bmp.h"
+#include "distance_field.h"
 #include "errors.h"
 #include "gl.h"
 
-static void GL_CompileShader(GLuint shader, const char *source_path)
+////////////////////////////////////////////////////////////////////////////////
+// Resource registry
+//
+// Programs and textures are loaded from files, and several views often load
+// the same ones. Rather than compiling or uploading a copy for each of them, we
+// keep a list of everything loaded so far, keyed by the paths it was loaded
+// from, and hand out references to the existing GL object. There are only ever
+// a handful of these, so a linked list is plenty.
+
+typedef struct GL_Resource {
+    struct GL_Resource *next;
+    char *key;
+        // The path(s) the resource was loaded from.
+    GLuint id;
+    uint32_t refs;
+        // Number of `GL_Load*` calls not yet matched by a `GL_Release*`.
+} GL_Resource;
+
+static GL_Resource *gl_programs = NULL;
+static GL_Resource *gl_textures = NULL;
+
+// Find the resource in `list` with the given key, and take a reference to it.
+// Returns 0 if there is no such resource.
+static GLuint GL_AcquireResource(GL_Resource *list, const char *key)
+{
+    for (GL_Resource *resource = list; resource; resource = resource->next) {
+        if (strcmp(resource->key, key) == 0) {
+            ++resource->refs;
+            return resource->id;
+        }
+    }
+    return 0;
+}
+
+static void GL_AddResource(GL_Resource **list, const char *key, GLuint id)
+{
+    GL_Resource *resource = Malloc(sizeof(GL_Resource));
+    resource->key = Malloc(strlen(key) + 1);
+    strcpy(resource->key, key);
+    resource->id = id;
+    resource->refs = 1;
+    resource->next = *list;
+    *list = resource;
+}
+
+// Drop a reference to the resource in `list` with the given ID. Returns true
+// if that was the last reference, in which case the caller should delete the
+// GL object.
+static bool GL_ReleaseResource(GL_Resource **list, GLuint id)
+{
+    for (GL_Resource **link = list; *link; link = &(*link)->next) {
+        GL_Resource *resource = *link;
+        if (resource->id != id) {
+            continue;
+        }
+
+        if (--resource->refs > 0) {
+            return false;
+        }
+        *link = resource->next;
+        free(resource->key);
+        free(resource);
+        return true;
+    }
+
+    ASSERT(false);
+        // The resource was never loaded, or has already been released.
+    return false;
+}
+
+static uint32_t GL_CountResources(const GL_Resource *list)
+{
+    uint32_t count = 0;
+    for (; list; list = list->next) {
+        ++count;
+    }
+    return count;
+}
+
+void GL_GetResourceCounts(uint32_t *programs, uint32_t *textures)
+{
+    *programs = GL_CountResources(gl_programs);
+    *textures = GL_CountResources(gl_textures);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Shaders
+//
+
+// Read the source of a shader into memory. The result is allocated with
+// `Malloc` and is not null-terminated.
+static char *GL_ReadShaderSource(const char *source_path, GLint *size)
 {
-    FILE *file = fopen(source_path, "r");
+    if (Assets_GetDirectory() == NULL) {
+        const Asset *asset = Assets_Find(source_path);
+        char *source = Malloc(asset->size);
+        memcpy(source, asset->data, asset->size);
+        *size = asset->size;
+        return source;
+    }
+
+    char *path = Assets_OverridePath(source_path);
+    FILE *file = fopen(path, "r");
+    free(path);
     if (file == NULL) {
         Error_Raise(FATAL, ERR_IO, strerror(errno));
     }
@@ -27,10 +138,15 @@ static void GL_CompileShader(GLuint shader, const char *source_path)
     }
     fclose(file);
 
+    *size = file_size;
+    return source;
+}
+
+static void GL_CompileShader(GLuint shader, const char *source, GLint size)
+{
     // Compile the shader
-    glShaderSource(shader, 1, (const char * const *)&source, &file_size);
+    glShaderSource(shader, 1, (const char * const *)&source, &size);
     glCompileShader(shader);
-    free(source);
 
     // Check compilation
     GLint result = GL_FALSE;
@@ -44,19 +160,20 @@ static void GL_CompileShader(GLuint shader, const char *source_path)
     }
 }
 
-GLuint GL_LoadShaders(const char *vertex_path, const char *fragment_path)
+// Compile and link a program from source.
+static void GL_LinkProgram(GLuint program,
+    const char *vertex_source, GLint vertex_size,
+    const char *fragment_source, GLint fragment_size)
 {
-
     // Create the shaders
     GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
     GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
 
     // Compile them
-    GL_CompileShader(vertex_shader, vertex_path);
-    GL_CompileShader(fragment_shader, fragment_path);
+    GL_CompileShader(vertex_shader, vertex_source, vertex_size);
+    GL_CompileShader(fragment_shader, fragment_source, fragment_size);
 
     // Link the program
-    GLuint program = glCreateProgram();
     glAttachShader(program, vertex_shader);
     glAttachShader(program, fragment_shader);
     glLinkProgram(program);
@@ -77,165 +194,267 @@ GLuint GL_LoadShaders(const char *vertex_path, const char *fragment_path)
     glDetachShader(program, fragment_shader);
     glDeleteShader(vertex_shader);
     glDeleteShader(fragment_shader);
+}
 
-    return program;
+////////////////////////////////////////////////////////////////////////////////
+// Program binary cache
+//
+// Compiling and linking from source can take a noticeable fraction of a second
+// per program on some drivers. Where the driver supports it, we save each
+// linked program in the format the driver itself uses, and on later runs give
+// that straight back to the driver instead of compiling.
+//
+// Binaries are only valid for the driver that produced them, so each one is
+// stored under a hash of both shader sources and the vendor, renderer and
+// version strings of the driver. A change to any of those simply misses the
+// cache. The driver may also reject a binary it produced itself (for example
+// after an update that doesn't change the version string), in which case we
+// fall back to compiling from source and overwrite the stale binary.
+
+#define GL_PROGRAM_CACHE_DIR "golfsim"
+    // Directory for cached binaries, within the user's cache directory.
+
+// Fold `size` bytes of `data` into a 64-bit FNV-1a hash.
+static uint64_t GL_Hash(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
 }
 
-typedef struct __attribute__((__packed__)) {
-    // File header
-    char magic_number[2];   // Must be "BM"
-    uint32_t file_size;
-    uint8_t reserved1[2];
-    uint8_t reserved2[2];
-    uint32_t data_offset;
-
-    // DIB header
-    uint32_t header_size;   // Size of this header. This is typically used to
-                            // figure out which version of the header we're
-                            // working with, as later versions add lots of extra
-                            // features after the core DIB header. We don't care
-                            // about this header, so we'll just ignore this
-                            // field and only use the fields which are common to
-                            // all versions.
-    uint32_t width;         // Width in pixels.
-    uint32_t height;        // Height in pixels;
-    uint16_t num_color_planes;
-                            // Always 1
-    uint16_t bit_depth;
-    uint32_t compression_method;
-    uint32_t image_size;
-
-} BmpHeader;
-
-typedef enum {
-    BMP_PIXEL_RGBA,
-    BMP_PIXEL_UNSUPPORTED,
-} BmpPixelLayout;
-
-static void BMP_ReadHeader(BmpHeader *header, FILE *bmp)
-{
-    if (fread(header, 1, sizeof(*header), bmp) != sizeof(*header)) {
-        Error_Raise(FATAL, ERR_IO, "unable to read bitmap header");
-    }
-    if (header->magic_number[0] != 'B' ||
-        header->magic_number[1] != 'M') {
-        Error_Raise(FATAL, ERR_IO, "invalid bitmap texture");
-    }
-
-    trace("Read bitmap header:"
-          "    size:        %u\n"
-          "    data offset: 0x%x\n"
-          "    header size: %u\n"
-          "    image size:  %ux%u\n"
-          "    bit depth:   %u\n"
-          "    compression: %u\n",
-        header->file_size, header->data_offset,
-        header->header_size, header->width, header->height,
-        header->bit_depth, header->compression_method
-    );
-
-    // Validate the header.
-    switch (header->bit_depth) {
-        case 8:
-        case 16:
-        case 24:
-        case 32:
-            break;
-        default:
-            Error_Raise(FATAL, ERR_IO, "invalid bitmap bit depth");
+static uint64_t GL_HashString(uint64_t hash, const char *string)
+{
+    return GL_Hash(hash, string, strlen(string) + 1);
+        // Include the terminator, so that moving characters from the end of
+        // one string to the start of the next changes the hash.
+}
+
+// Get the path of the cached binary for a program with the given sources,
+// creating the cache directory if necessary. The result is allocated with
+// `Malloc`. Returns NULL if program binaries can't be cached.
+static char *GL_ProgramCachePath(
+    const char *vertex_source, GLint vertex_size,
+    const char *fragment_source, GLint fragment_size)
+{
+#ifdef GOLF_OS_POSIX
+    if (!GLEW_ARB_get_program_binary) {
+        return NULL;
     }
+    GLint num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+    if (num_formats == 0) {
+        return NULL;
+    }
+
+    // Find the user's cache directory, following the XDG convention.
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    const char *suffix = "";
+    if (cache_home == NULL || cache_home[0] == '\0') {
+        cache_home = getenv("HOME");
+        suffix = "/.cache";
+        if (cache_home == NULL || cache_home[0] == '\0') {
+            return NULL;
+        }
+    }
+
+    char *path = Malloc(strlen(cache_home) + strlen(suffix) +
+        strlen("/" GL_PROGRAM_CACHE_DIR "/0123456789abcdef.bin") + 1);
+    sprintf(path, "%s%s", cache_home, suffix);
+    if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+        free(path);
+        return NULL;
+    }
+    strcat(path, "/" GL_PROGRAM_CACHE_DIR);
+    if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+        warn("unable to create shader cache %s: %s\n", path, strerror(errno));
+        free(path);
+        return NULL;
+    }
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = GL_HashString(hash, (const char *)glGetString(GL_VENDOR));
+    hash = GL_HashString(hash, (const char *)glGetString(GL_RENDERER));
+    hash = GL_HashString(hash, (const char *)glGetString(GL_VERSION));
+    hash = GL_Hash(hash, &vertex_size, sizeof(vertex_size));
+    hash = GL_Hash(hash, vertex_source, vertex_size);
+    hash = GL_Hash(hash, &fragment_size, sizeof(fragment_size));
+    hash = GL_Hash(hash, fragment_source, fragment_size);
+    sprintf(path + strlen(path), "/%016llx.bin", (unsigned long long)hash);
+
+    return path;
+#else
+    (void)vertex_source;
+    (void)vertex_size;
+    (void)fragment_source;
+    (void)fragment_size;
+    return NULL;
+#endif
 }
 
-static uint8_t *BMP_ReadData(const BmpHeader *header, FILE *bmp)
-    // This function allocates space for the pixel data using `Malloc`, remember
-    // to free the result when finished with it.
+// Try to load `program` from the binary cached at `path`, returning whether it
+// is ready to use.
+static bool GL_LoadProgramBinary(GLuint program, const char *path)
 {
-    // Find the start of the data.
-    uint32_t data_offset = header->data_offset
-                            ? header->data_offset
-                            : header->header_size;
-    fseek(bmp, data_offset, SEEK_SET);
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+            // Not cached yet.
+    }
 
-    // Compute the size of the image. The `image_size` field in the header is
-    // not always reliable, sometimes it is incorrectly 0.
-    ASSERT(header->bit_depth % 8 == 0);
-    uint32_t data_size =
-        header->image_size
-            ? header->image_size
-            : header->width*header->height*(header->bit_depth/8);
+    // The file holds the driver's format for the binary, followed by the
+    // binary itself.
+    uint32_t format;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file) - (long)sizeof(format);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0 || fread(&format, sizeof(format), 1, file) != 1) {
+        fclose(file);
+        return false;
+    }
+
+    void *binary = Malloc(size);
+    bool ok = fread(binary, 1, size, file) == (size_t)size;
+    fclose(file);
+
+    if (ok) {
+        glProgramBinary(program, format, binary, size);
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        ok = status == GL_TRUE;
+    }
+    free(binary);
 
-    // Read in the data.
-    uint8_t *pixels = Malloc(data_size);
-    if (fread(pixels, 1, data_size, bmp) != data_size) {
-        Error_Raise(FATAL, ERR_IO, "unable to read bitmap data");
+    if (!ok) {
+        debug("discarding stale program binary %s\n", path);
     }
-    return pixels;
+    return ok;
 }
 
-static BmpPixelLayout BMP_GetPixelLayout(const BmpHeader *header)
+// Save the binary for a linked program to `path`.
+static void GL_SaveProgramBinary(GLuint program, const char *path)
 {
-    if (header->compression_method == 3 &&
-            // Compression method 3 can indicate one of several things,
-            // depending on header version:
-            //  * OS22X header: Huffman 1D compression
-            //  * BITMAPV2 header: RGB bit field masks
-            //  * BITMAPV3+ header: RGBA 32-bit encoding
-            // Of these, we only support the RGBA encoding, so we next check if
-            // this header is V3+.
-        header->header_size >= 56
-            // Bitmap header version is indicated by the size of the header;
-            // The size increases with the version. The V3 header is 56 bytes,
-            // subsequent headers are larger.
-        ) {
-        return BMP_PIXEL_RGBA;
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) {
+        return;
     }
 
-    return BMP_PIXEL_UNSUPPORTED;
+    void *binary = Malloc(size);
+    GLenum format;
+    glGetProgramBinary(program, size, &size, &format, binary);
+    uint32_t format32 = format;
+
+    // Write to a temporary file and then move it into place, so that a run
+    // which crashes, or another instance of the game starting at the same time,
+    // never sees a partial binary.
+    char *tmp_path = Malloc(strlen(path) + strlen(".tmp") + 1);
+    sprintf(tmp_path, "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (file != NULL) {
+        bool ok = fwrite(&format32, sizeof(format32), 1, file) == 1 &&
+                  fwrite(binary, 1, size, file) == (size_t)size;
+        ok = fclose(file) == 0 && ok;
+        if (!ok || rename(tmp_path, path) != 0) {
+            warn("unable to write program binary %s\n", path);
+            remove(tmp_path);
+        }
+    }
+
+    free(tmp_path);
+    free(binary);
 }
 
-GLuint GL_LoadTexture(const char *bmp_path)
+GLuint GL_LoadShaders(const char *vertex_path, const char *fragment_path)
 {
-    FILE *file = fopen(bmp_path, "rb");
-    if (file == NULL) {
-        Error_Raise(FATAL, ERR_IO, strerror(errno));
+    char *key = Malloc(strlen(vertex_path) + strlen(fragment_path) + 2);
+    sprintf(key, "%s:%s", vertex_path, fragment_path);
+    GLuint program = GL_AcquireResource(gl_programs, key);
+    if (program != 0) {
+        free(key);
+        return program;
+    }
+
+    GLint vertex_size, fragment_size;
+    char *vertex_source = GL_ReadShaderSource(vertex_path, &vertex_size);
+    char *fragment_source = GL_ReadShaderSource(fragment_path, &fragment_size);
+
+    program = glCreateProgram();
+    char *cache_path = GL_ProgramCachePath(
+        vertex_source, vertex_size, fragment_source, fragment_size);
+    if (cache_path == NULL || !GL_LoadProgramBinary(program, cache_path)) {
+        if (cache_path != NULL) {
+            glProgramParameteri(
+                program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        GL_LinkProgram(program,
+            vertex_source, vertex_size, fragment_source, fragment_size);
+        if (cache_path != NULL) {
+            GL_SaveProgramBinary(program, cache_path);
+        }
     }
 
-    // Read in the header.
-    BmpHeader header;
-    BMP_ReadHeader(&header, file);
+    free(cache_path);
+    free(vertex_source);
+    free(fragment_source);
 
-    // Bring the pixel data into memory.
-    uint8_t *data = BMP_ReadData(&header, file);
+    GL_AddResource(&gl_programs, key, program);
+    free(key);
+    return program;
+}
 
-    // All the data is in memory now, we're done with the file.
-    fclose(file);
+void GL_ReleaseShaders(GLuint program)
+{
+    if (GL_ReleaseResource(&gl_programs, program)) {
+        glDeleteProgram(program);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Textures
+//
+
+// Get the decoded pixels of a bitmap, either from the copy embedded in the
+// binary, or by decoding the file in the asset directory. In the latter case,
+// `*decoded` is set to the pixels, which the caller must free.
+static const uint8_t *GL_GetBitmap(const char *bmp_path,
+    uint32_t *width, uint32_t *height, uint8_t **decoded)
+{
+    if (Assets_GetDirectory() != NULL) {
+        char *path = Assets_OverridePath(bmp_path);
+        *decoded = BMP_Load(path, width, height);
+        free(path);
+        return *decoded;
+    } else {
+        const Asset *asset = Assets_Find(bmp_path);
+        ASSERT(asset->width > 0 && asset->height > 0);
+        *decoded = NULL;
+        *width = asset->width;
+        *height = asset->height;
+        return asset->data;
+    }
+}
+
+GLuint GL_LoadTexture(const char *bmp_path)
+{
+    GLuint texture = GL_AcquireResource(gl_textures, bmp_path);
+    if (texture != 0) {
+        return texture;
+    }
+
+    uint8_t *decoded;
+    uint32_t width, height;
+    const uint8_t *pixels = GL_GetBitmap(bmp_path, &width, &height, &decoded);
 
     // Give the data to GL.
-    GLuint texture;
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
     {
-        // Format-specific processing.
-        switch (BMP_GetPixelLayout(&header)) {
-            case BMP_PIXEL_RGBA: {
-                ASSERT(header.bit_depth == 32);
-                glTexImage2D(
-                    GL_TEXTURE_2D,
-                    0,
-                    GL_RGBA8,
-                    header.width,
-                    header.height,
-                    0,
-                    GL_BGRA,
-                    GL_UNSIGNED_INT_8_8_8_8,
-                    data
-                );
-            }
-            break;
-
-            default:
-                Error_Raise(FATAL, ERR_IO, "unsupported bitmap pixel format");
-        }
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 
         // Use linear filtering to interpolate between texels.
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -243,7 +462,261 @@ GLuint GL_LoadTexture(const char *bmp_path)
     }
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    free(data);
+    free(decoded);
 
+    GL_AddResource(&gl_textures, bmp_path, texture);
     return texture;
 }
+
+GLuint GL_LoadDistanceField(const char *bmp_path, uint8_t spread)
+{
+    char *key = Malloc(strlen(bmp_path) + sizeof(":distance:255"));
+    sprintf(key, "%s:distance:%u", bmp_path, spread);
+        // Distinct from the key of the plain texture, so both can be loaded.
+    GLuint texture = GL_AcquireResource(gl_textures, key);
+    if (texture != 0) {
+        free(key);
+        return texture;
+    }
+
+    uint32_t width, height;
+    const uint8_t *texels;
+    uint8_t *field = NULL;
+    if (Assets_GetDirectory() != NULL) {
+        // Computing the field takes a while, but it lets an edited bitmap show
+        // up without rebuilding.
+        uint8_t *decoded;
+        const uint8_t *pixels =
+            GL_GetBitmap(bmp_path, &width, &height, &decoded);
+        field = Malloc(width*height);
+        DistanceField_Compute(pixels + 3, width, height, 4, spread, field);
+            // Measure from the edges of the alpha channel.
+        free(decoded);
+        texels = field;
+    } else {
+        const Asset *asset = Assets_Find(key);
+            // Computed by `embed_assets` at build time, since it's too slow to
+            // do every time we start up.
+        ASSERT(asset->size == asset->width*asset->height);
+        width = asset->width;
+        height = asset->height;
+        texels = asset->data;
+    }
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            // Rows of single-byte texels needn't be 4-byte aligned.
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0,
+            GL_RED, GL_UNSIGNED_BYTE, texels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        // Interpolating distances is what makes the edges smooth at any scale.
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    free(field);
+
+    GL_AddResource(&gl_textures, key, texture);
+    free(key);
+    return texture;
+}
+
+void GL_ReleaseTexture(GLuint texture)
+{
+    if (GL_ReleaseResource(&gl_textures, texture)) {
+        glDeleteTextures(1, &texture);
+    }
+}
+
+#define GL_STREAM_BUFFER_ALIGNMENT 16
+    // Uploads start at multiples of this many bytes, which is enough alignment
+    // for any vertex attribute type.
+
+#define GL_STREAM_BUFFER_WAIT_NS 1000000000
+    // How long to block in each call to `glClientWaitSync` when we have to wait
+    // for the GPU. We keep waiting until the fence signals, but waking up
+    // periodically keeps us from relying on an unbounded timeout.
+
+void GL_StreamBuffer_Init(GL_StreamBuffer *stream, GLsizeiptr capacity)
+{
+    memset(stream, 0, sizeof(*stream));
+    stream->capacity = capacity;
+
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+    {
+        // We bind to `GL_COPY_WRITE_BUFFER` here and when uploading, so as not
+        // to disturb the `GL_ARRAY_BUFFER` binding of whoever is uploading.
+        if (GLEW_ARB_buffer_storage) {
+            GLbitfield flags =
+                GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                // A coherent mapping makes our writes visible to the GPU
+                // without having to flush them explicitly.
+            glBufferStorage(GL_COPY_WRITE_BUFFER, capacity, NULL, flags);
+            stream->mapping = glMapBufferRange(
+                GL_COPY_WRITE_BUFFER, 0, capacity, flags);
+            if (stream->mapping == NULL) {
+                warn("unable to map stream buffer, mapping each upload\n", 0);
+            }
+        } else {
+            glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GL_StreamBuffer_Destroy(GL_StreamBuffer *stream)
+{
+    for (uint8_t i = 0; i < stream->num_fences; ++i) {
+        glDeleteSync(
+            stream->fences[(stream->first_fence + i)%GL_STREAM_BUFFER_FRAMES]);
+    }
+    stream->num_fences = 0;
+    glDeleteBuffers(1, &stream->buffer);
+        // This also unmaps it, if it's persistently mapped.
+    stream->buffer = 0;
+    stream->mapping = NULL;
+}
+
+// Reclaim the space used by the oldest frame still in flight, once the GPU has
+// finished with it. If `wait` is false and the GPU is not done yet, or if there
+// are no frames in flight, return false without blocking.
+static bool GL_StreamBuffer_RetireFrame(GL_StreamBuffer *stream, bool wait)
+{
+    if (stream->num_fences == 0) {
+        return false;
+    }
+
+    GLsync fence = stream->fences[stream->first_fence];
+    GLenum status;
+    do {
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+            wait ? GL_STREAM_BUFFER_WAIT_NS : 0);
+    } while (wait && status == GL_TIMEOUT_EXPIRED);
+
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return false;
+    } else if (status == GL_WAIT_FAILED) {
+        warn("unable to wait for stream buffer fence\n", 0);
+        glFinish();
+            // We can't tell when the frame finishes, so make sure it has.
+    }
+
+    glDeleteSync(fence);
+    stream->used -= stream->fence_sizes[stream->first_fence];
+    stream->first_fence = (stream->first_fence + 1)%GL_STREAM_BUFFER_FRAMES;
+    --stream->num_fences;
+    return true;
+}
+
+// Replace the buffer with a new one big enough for an upload of `size` bytes.
+// The old buffer may still be read by draws in flight, but GL keeps it alive
+// until they finish, so we can drop it right away.
+static void GL_StreamBuffer_Grow(GL_StreamBuffer *stream, GLsizeiptr size)
+{
+    GLsizeiptr capacity = 2*stream->capacity;
+    if (capacity < size) {
+        capacity = size;
+    }
+    warn("growing stream buffer from %ld to %ld bytes\n",
+        (long)stream->capacity, (long)capacity);
+
+    GL_StreamBuffer_Destroy(stream);
+    GL_StreamBuffer_Init(stream, capacity);
+}
+
+GLintptr GL_StreamBuffer_Upload(
+    GL_StreamBuffer *stream, const void *data, GLsizeiptr size)
+{
+    ASSERT(0 < size);
+    if (size > stream->capacity) {
+        GL_StreamBuffer_Grow(stream, size);
+            // Otherwise we would wait forever for room which can never free
+            // up.
+    }
+
+    GLintptr offset;
+    GLsizeiptr consumed;
+        // The bytes this upload takes up, including alignment padding and any
+        // space skipped at the end of the buffer when we wrap around.
+    for (;;) {
+        if (stream->used == 0) {
+            stream->head = 0;
+                // Nothing is in flight, so we may as well start from the
+                // beginning, and avoid wrapping around.
+        }
+
+        offset = (stream->head + GL_STREAM_BUFFER_ALIGNMENT - 1)/
+                 GL_STREAM_BUFFER_ALIGNMENT*GL_STREAM_BUFFER_ALIGNMENT;
+        if (offset + size <= stream->capacity) {
+            consumed = offset - stream->head + size;
+        } else {
+            offset = 0;
+            consumed = stream->capacity - stream->head + size;
+        }
+
+        if (consumed <= stream->capacity - stream->used) {
+            break;
+        }
+
+        // Everything after `head` may still be in use, so wait for the oldest
+        // frame to finish. If the current frame is the only one in flight, it
+        // has outgrown the buffer; fence the draws it has made so far and wait
+        // for those instead.
+        if (!GL_StreamBuffer_RetireFrame(stream, true)) {
+            GL_StreamBuffer_EndFrame(stream);
+        }
+    }
+
+    if (stream->mapping != NULL) {
+        memcpy(stream->mapping + offset, data, size);
+    } else {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stream->buffer);
+        {
+            void *dst = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                GL_MAP_UNSYNCHRONIZED_BIT);
+                // The fences already guarantee this range is not in use, so
+                // there is no need for GL to synchronize with the GPU.
+            if (dst != NULL) {
+                memcpy(dst, data, size);
+                glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            } else {
+                glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+            }
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    stream->head = offset + size;
+    stream->used += consumed;
+    stream->frame_used += consumed;
+    return offset;
+}
+
+void GL_StreamBuffer_EndFrame(GL_StreamBuffer *stream)
+{
+    // Reclaim space from earlier frames which have already finished, without
+    // blocking on the ones which haven't.
+    while (GL_StreamBuffer_RetireFrame(stream, false)) {
+        continue;
+    }
+
+    if (stream->frame_used == 0) {
+        return;
+    }
+
+    if (stream->num_fences == GL_STREAM_BUFFER_FRAMES) {
+        GL_StreamBuffer_RetireFrame(stream, true);
+    }
+    uint8_t i = (stream->first_fence + stream->num_fences)%
+                GL_STREAM_BUFFER_FRAMES;
+    stream->fences[i] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->fence_sizes[i] = stream->frame_used;
+    ++stream->num_fences;
+    stream->frame_used = 0;
+}
@@ -0,0 +1,291 @@
+#include <stdlib.h>
+
+#include "errors.h"
+#include "height_pyramid.h"
+#include "matrix.h"
+
+#define HEIGHT_PYRAMID_EPSILON 1e-5
+    // Slack in the barycentric coordinates of a hit, so that rays which pass
+    // exactly along the edge between two triangles don't slip through both due
+    // to rounding.
+
+static inline uint16_t HeightPyramid_VertexHeight(
+    const HeightPyramid *pyramid, uint32_t row, uint32_t col)
+{
+    return pyramid->heights[row*(pyramid->width + 1) + col];
+}
+
+void HeightPyramid_Init(HeightPyramid *pyramid,
+    const uint16_t *heights, uint16_t width, uint16_t height)
+{
+    ASSERT(width > 0 && height > 0);
+
+    pyramid->heights = heights;
+    pyramid->width = width;
+    pyramid->height = height;
+
+    // Halve the dimensions, rounding up, until we get down to a single cell.
+    pyramid->num_levels = 0;
+    for (;;) {
+        ASSERT(pyramid->num_levels < HEIGHT_PYRAMID_MAX_LEVELS);
+        pyramid->level_widths[pyramid->num_levels] = width;
+        pyramid->level_heights[pyramid->num_levels] = height;
+        pyramid->levels[pyramid->num_levels] =
+            Malloc(sizeof(uint16_t)*width*height);
+        ++pyramid->num_levels;
+
+        if (width == 1 && height == 1) {
+            break;
+        }
+        width = (width + 1)/2;
+        height = (height + 1)/2;
+    }
+}
+
+void HeightPyramid_Destroy(HeightPyramid *pyramid)
+{
+    for (uint8_t i = 0; i < pyramid->num_levels; ++i) {
+        free(pyramid->levels[i]);
+    }
+}
+
+void HeightPyramid_Update(HeightPyramid *pyramid,
+    uint16_t min_row, uint16_t min_col, uint16_t max_row, uint16_t max_col)
+{
+    if (min_row > max_row || min_col > max_col) {
+        return;
+    }
+
+    // A vertex is a corner of the faces up to one row and column below and to
+    // the left of it.
+    uint32_t face_min_row = min_row > 0 ? min_row - 1 : 0;
+    uint32_t face_min_col = min_col > 0 ? min_col - 1 : 0;
+    uint32_t face_max_row = UintMin(max_row, pyramid->height - 1);
+    uint32_t face_max_col = UintMin(max_col, pyramid->width - 1);
+
+    uint16_t *faces = pyramid->levels[0];
+    for (uint32_t row = face_min_row; row <= face_max_row; ++row) {
+        for (uint32_t col = face_min_col; col <= face_max_col; ++col) {
+            faces[row*pyramid->width + col] = UintMax(
+                UintMax(
+                    HeightPyramid_VertexHeight(pyramid, row,     col),
+                    HeightPyramid_VertexHeight(pyramid, row,     col + 1)),
+                UintMax(
+                    HeightPyramid_VertexHeight(pyramid, row + 1, col),
+                    HeightPyramid_VertexHeight(pyramid, row + 1, col + 1)));
+        }
+    }
+
+    // Propagate the change up the pyramid, halving the rectangle each level.
+    for (uint8_t level = 1; level < pyramid->num_levels; ++level) {
+        face_min_row /= 2;
+        face_min_col /= 2;
+        face_max_row /= 2;
+        face_max_col /= 2;
+
+        const uint16_t *below = pyramid->levels[level - 1];
+        uint16_t below_width = pyramid->level_widths[level - 1];
+        uint16_t below_height = pyramid->level_heights[level - 1];
+        uint16_t *cells = pyramid->levels[level];
+        uint16_t width = pyramid->level_widths[level];
+
+        for (uint32_t row = face_min_row; row <= face_max_row; ++row) {
+            for (uint32_t col = face_min_col; col <= face_max_col; ++col) {
+                uint16_t z = 0;
+                for (uint32_t i = 2*row; i < UintMin(2*row + 2, below_height);
+                     ++i)
+                {
+                    for (uint32_t j = 2*col;
+                         j < UintMin(2*col + 2, below_width); ++j)
+                    {
+                        z = UintMax(z, below[i*below_width + j]);
+                    }
+                }
+                cells[row*width + col] = z;
+            }
+        }
+    }
+}
+
+// State of a ray cast in progress.
+typedef struct {
+    const HeightPyramid *pyramid;
+    float xy_resolution;
+    float start[3];
+    float dir[3];
+        // Points on the segment are `start + t*dir`, for `t` in [0, 1].
+    float t;
+        // Parameter of the nearest hit found so far, or 1 if there is none.
+    bool hit;
+    uint16_t row;
+    uint16_t col;
+        // The face containing the nearest hit, if `hit` is set.
+} HeightPyramidRay;
+
+// Narrow `[*t0, *t1]` to the part of the ray inside the box from `min` to
+// `max`, returning false if none of it is.
+static bool HeightPyramidRay_ClipToBox(const HeightPyramidRay *ray,
+    const float min[3], const float max[3], float *t0, float *t1)
+{
+    for (uint8_t axis = 0; axis < 3; ++axis) {
+        if (ray->dir[axis] == 0) {
+            // The ray is parallel to this pair of faces of the box, so it is
+            // either always or never between them.
+            if (ray->start[axis] < min[axis] || ray->start[axis] > max[axis]) {
+                return false;
+            }
+            continue;
+        }
+
+        float near = (min[axis] - ray->start[axis])/ray->dir[axis];
+        float far = (max[axis] - ray->start[axis])/ray->dir[axis];
+        if (near > far) {
+            float tmp = near;
+            near = far;
+            far = tmp;
+        }
+        *t0 = near > *t0 ? near : *t0;
+        *t1 = far < *t1 ? far : *t1;
+        if (*t0 > *t1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Intersect the ray with the triangle `abc` using the Moller-Trumbore
+// algorithm, recording the hit if it is nearer than any found so far.
+static void HeightPyramidRay_HitTriangle(HeightPyramidRay *ray,
+    const vec3 *a, const vec3 *b, const vec3 *c, uint16_t row, uint16_t col)
+{
+    vec3 dir = { ray->dir[0], ray->dir[1], ray->dir[2] };
+    vec3 start = { ray->start[0], ray->start[1], ray->start[2] };
+
+    vec3 ab, ac;
+    vec3_Subtract(b, a, &ab);
+    vec3_Subtract(c, a, &ac);
+
+    vec3 p;
+    vec3_Cross(&dir, &ac, &p);
+    float det = vec3_Dot(&ab, &p);
+    if (det == 0) {
+        return;
+            // The ray is parallel to the triangle.
+    }
+
+    vec3 s;
+    vec3_Subtract(&start, a, &s);
+    float u = vec3_Dot(&s, &p)/det;
+    if (u < -HEIGHT_PYRAMID_EPSILON || u > 1 + HEIGHT_PYRAMID_EPSILON) {
+        return;
+    }
+
+    vec3 q;
+    vec3_Cross(&s, &ab, &q);
+    float v = vec3_Dot(&dir, &q)/det;
+    if (v < -HEIGHT_PYRAMID_EPSILON || u + v > 1 + HEIGHT_PYRAMID_EPSILON) {
+        return;
+    }
+
+    float t = vec3_Dot(&ac, &q)/det;
+    if (t < 0 || t > ray->t) {
+        return;
+    }
+
+    ray->t = t;
+    ray->hit = true;
+    ray->row = row;
+    ray->col = col;
+}
+
+// Intersect the ray with the two triangles of the face at (`row`, `col`).
+static void HeightPyramidRay_HitFace(
+    HeightPyramidRay *ray, uint16_t row, uint16_t col)
+{
+    const HeightPyramid *pyramid = ray->pyramid;
+    float xy = ray->xy_resolution;
+
+    vec3 tl = { xy*col, xy*(row + 1),
+        HeightPyramid_VertexHeight(pyramid, row + 1, col) };
+    vec3 tr = { xy*(col + 1), xy*(row + 1),
+        HeightPyramid_VertexHeight(pyramid, row + 1, col + 1) };
+    vec3 br = { xy*(col + 1), xy*row,
+        HeightPyramid_VertexHeight(pyramid, row, col + 1) };
+    vec3 bl = { xy*col, xy*row,
+        HeightPyramid_VertexHeight(pyramid, row, col) };
+
+    HeightPyramidRay_HitTriangle(ray, &tr, &tl, &bl, row, col);
+    HeightPyramidRay_HitTriangle(ray, &br, &tr, &bl, row, col);
+}
+
+// Intersect the ray with the faces under the cell at (`row`, `col`) of the
+// given level of the pyramid.
+static void HeightPyramidRay_HitCell(
+    HeightPyramidRay *ray, uint8_t level, uint32_t row, uint32_t col)
+{
+    const HeightPyramid *pyramid = ray->pyramid;
+    if (row >= pyramid->level_heights[level] ||
+        col >= pyramid->level_widths[level])
+    {
+        return;
+            // The last row or column of a level may only have one child.
+    }
+
+    // The cell covers the faces from (`row << level`, `col << level`) up to,
+    // but not including, the next cell, and is no higher than its maximum.
+    float xy = ray->xy_resolution;
+    float min[3] = { xy*(col << level), xy*(row << level), 0 };
+    float max[3] = {
+        xy*UintMin((col + 1) << level, pyramid->width),
+        xy*UintMin((row + 1) << level, pyramid->height),
+        pyramid->levels[level][row*pyramid->level_widths[level] + col]
+    };
+    float t0 = 0;
+    float t1 = ray->t;
+    if (!HeightPyramidRay_ClipToBox(ray, min, max, &t0, &t1)) {
+        return;
+    }
+
+    if (level == 0) {
+        HeightPyramidRay_HitFace(ray, row, col);
+        return;
+    }
+
+    // Visit the children nearest the start of the ray first. Any hit we find
+    // there shortens the ray, so the children behind it are clipped away
+    // without descending into them.
+    uint32_t first_row = ray->dir[1] < 0 ? 1 : 0;
+    uint32_t first_col = ray->dir[0] < 0 ? 1 : 0;
+    for (uint32_t i = 0; i < 2; ++i) {
+        for (uint32_t j = 0; j < 2; ++j) {
+            HeightPyramidRay_HitCell(ray, level - 1,
+                2*row + (first_row ^ i), 2*col + (first_col ^ j));
+        }
+    }
+}
+
+bool HeightPyramid_Raycast(const HeightPyramid *pyramid, float xy_resolution,
+    const vec3 *start, const vec3 *end, vec3 *hit, uint16_t *row, uint16_t *col)
+{
+    HeightPyramidRay ray = {
+        .pyramid = pyramid,
+        .xy_resolution = xy_resolution,
+        .start = { start->x, start->y, start->z },
+        .dir = { end->x - start->x, end->y - start->y, end->z - start->z },
+        .t = 1,
+        .hit = false,
+    };
+    HeightPyramidRay_HitCell(&ray, pyramid->num_levels - 1, 0, 0);
+    if (!ray.hit) {
+        return false;
+    }
+
+    *hit = (vec3){
+        ray.start[0] + ray.t*ray.dir[0],
+        ray.start[1] + ray.t*ray.dir[1],
+        ray.start[2] + ray.t*ray.dir[2],
+    };
+    *row = ray.row;
+    *col = ray.col;
+    return true;
+}
@@ -0,0 +1,124 @@
+#include <math.h>
+#include <stdint.h>
+
+#include "errors.h"
+#include "horizon.h"
+#include "parallel.h"
+
+#define HORIZON_VERTICES_PER_THREAD 1024
+    // Minimum number of vertices worth computing on a separate thread. Each
+    // vertex takes `HORIZON_DIRECTIONS*HORIZON_RADIUS` samples, so this is a
+    // much smaller batch than we would hand to a thread for cheaper
+    // per-vertex work.
+
+static const int8_t HORIZON_STEPS[HORIZON_DIRECTIONS][2] = {
+    { 0,  1}, { 1,  1}, { 1,  0}, { 1, -1},
+    { 0, -1}, {-1, -1}, {-1,  0}, {-1,  1},
+};
+    // Row and column offset of one step in each direction. The directions are
+    // the neighbours of a vertex in the grid, so every sample lands exactly on
+    // a vertex and we never have to interpolate.
+
+// A band of rows in an occlusion computation, see `Horizon_ComputeOcclusion`.
+typedef struct {
+    const uint16_t *heights;
+    uint16_t width;
+    uint16_t height;
+    uint16_t min_row;
+    uint16_t min_col;
+    uint16_t max_col;
+    float inv_distances[2][HORIZON_RADIUS + 1];
+        // One over the horizontal distance of the `k`th step along an axis
+        // (`[0][k]`) or a diagonal (`[1][k]`).
+    uint8_t *occlusion;
+} HorizonBand;
+
+static uint8_t Horizon_VertexOcclusion(
+    const HorizonBand *band, uint16_t row, uint16_t col)
+{
+    const int32_t width = band->width;
+    const int32_t z = band->heights[(uint32_t)row*width + col];
+
+    float sum_sin = 0;
+    for (uint8_t d = 0; d < HORIZON_DIRECTIONS; ++d) {
+        const int8_t drow = HORIZON_STEPS[d][0];
+        const int8_t dcol = HORIZON_STEPS[d][1];
+        const float *inv_distances =
+            band->inv_distances[drow != 0 && dcol != 0];
+
+        // Find the number of steps we can take before leaving the grid.
+        int32_t steps = HORIZON_RADIUS;
+        if (drow > 0 && steps > band->height - 1 - row) {
+            steps = band->height - 1 - row;
+        } else if (drow < 0 && steps > row) {
+            steps = row;
+        }
+        if (dcol > 0 && steps > band->width - 1 - col) {
+            steps = band->width - 1 - col;
+        } else if (dcol < 0 && steps > col) {
+            steps = col;
+        }
+
+        // March outwards, keeping track of the steepest slope up to the
+        // terrain. Past the edge of the grid, we assume the terrain is flat,
+        // which doesn't raise the horizon.
+        const int32_t stride = drow*width + dcol;
+        const uint16_t *sample = &band->heights[(uint32_t)row*width + col];
+        float max_slope = 0;
+        for (int32_t k = 1; k <= steps; ++k) {
+            sample += stride;
+            float slope = (*sample - z)*inv_distances[k];
+            if (slope > max_slope) {
+                max_slope = slope;
+            }
+        }
+
+        sum_sin += max_slope/sqrtf(1 + max_slope*max_slope);
+            // The sine of the angle up to the horizon.
+    }
+
+    float visibility = 1 - sum_sin/HORIZON_DIRECTIONS;
+    return (uint8_t)(255*visibility + 0.5);
+}
+
+static void Horizon_ComputeBand(uint32_t begin, uint32_t end, void *arg)
+{
+    const HorizonBand *band = (const HorizonBand *)arg;
+
+    for (uint32_t row = band->min_row + begin; row < band->min_row + end;
+         ++row)
+    {
+        for (uint16_t col = band->min_col; col <= band->max_col; ++col) {
+            band->occlusion[row*band->width + col] =
+                Horizon_VertexOcclusion(band, row, col);
+        }
+    }
+}
+
+void Horizon_ComputeOcclusion(
+    const uint16_t *heights, uint16_t width, uint16_t height,
+    float xy_resolution,
+    uint16_t min_row, uint16_t min_col, uint16_t max_row, uint16_t max_col,
+    uint8_t *occlusion)
+{
+    ASSERT(min_row <= max_row && max_row < height);
+    ASSERT(min_col <= max_col && max_col < width);
+
+    HorizonBand band = {
+        .heights = heights,
+        .width = width,
+        .height = height,
+        .min_row = min_row,
+        .min_col = min_col,
+        .max_col = max_col,
+        .occlusion = occlusion,
+    };
+    for (uint8_t k = 1; k <= HORIZON_RADIUS; ++k) {
+        band.inv_distances[0][k] = 1/(k*xy_resolution);
+        band.inv_distances[1][k] = 1/(k*xy_resolution*sqrtf(2));
+    }
+
+    uint32_t cols = max_col - min_col + 1;
+    Parallel_For(max_row - min_row + 1, 1 + HORIZON_VERTICES_PER_THREAD/cols,
+        Horizon_ComputeBand, &band);
+}
@@ -0,0 +1,165 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <GL/glew.h>
+
+#include "errors.h"
+#include "gl.h"
+#include "line_batch.h"
+#include "matrix.h"
+#include "render_queue.h"
+
+void LineBatch_Init(LineBatch *batch)
+{
+    batch->line_vertices = NULL;
+    batch->num_line_vertices = 0;
+    batch->line_vertices_capacity = 0;
+    batch->points = NULL;
+    batch->num_points = 0;
+    batch->points_capacity = 0;
+
+    batch->shaders = GL_LoadShaders(
+        "shaders/lines_vertex.glsl", "shaders/lines_fragment.glsl");
+    batch->mvp = glGetUniformLocation(batch->shaders, "mvp");
+
+    glGenVertexArrays(1, &batch->vao);
+    glBindVertexArray(batch->vao);
+    {
+        glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION);
+        glEnableVertexAttribArray(VERTEX_ATTRIB_COLOR);
+        glEnableVertexAttribArray(VERTEX_ATTRIB_DEPTH_FADE);
+            // The attributes are pointed into the stream buffer when we draw.
+    }
+    glBindVertexArray(0);
+}
+
+void LineBatch_Destroy(LineBatch *batch)
+{
+    free(batch->line_vertices);
+    free(batch->points);
+    glDeleteVertexArrays(1, &batch->vao);
+    GL_ReleaseShaders(batch->shaders);
+}
+
+void LineVertex_Init(LineVertex *vertex,
+    const vec3 *position, const vec4 *color, bool depth_fade)
+{
+    vertex->position[0] = position->x;
+    vertex->position[1] = position->y;
+    vertex->position[2] = position->z;
+
+    const float *channels = vec4_ConstBuffer(color);
+    for (uint8_t i = 0; i < 4; ++i) {
+        float c = channels[i] < 0 ? 0 : channels[i] > 1 ? 1 : channels[i];
+        vertex->color[i] = (GLubyte)(c*255 + 0.5);
+    }
+
+    vertex->depth_fade = depth_fade ? 255 : 0;
+}
+
+// Make room for `count` more vertices at the end of `*vertices`, which holds
+// `*size` vertices and has room for `*capacity`.
+static LineVertex *LineBatch_Grow(
+    LineVertex **vertices, uint32_t *size, uint32_t *capacity, uint32_t count)
+{
+    if (*size + count > *capacity) {
+        // Grow geometrically, so that after the first few frames the array is
+        // big enough for a whole frame and we stop reallocating.
+        *capacity = UintMax(2*(*capacity), *size + count);
+        *vertices = Realloc(*vertices, *capacity*sizeof(LineVertex));
+    }
+
+    LineVertex *new_vertices = &(*vertices)[*size];
+    *size += count;
+    return new_vertices;
+}
+
+LineVertex *LineBatch_AddLines(LineBatch *batch, uint32_t count)
+{
+    return LineBatch_Grow(&batch->line_vertices, &batch->num_line_vertices,
+        &batch->line_vertices_capacity, 2*count);
+}
+
+void LineBatch_AddLine(LineBatch *batch,
+    const vec3 *start, const vec3 *end, const vec4 *color)
+{
+    LineVertex *vertices = LineBatch_AddLines(batch, 1);
+    LineVertex_Init(&vertices[0], start, color, false);
+    LineVertex_Init(&vertices[1], end, color, false);
+}
+
+void LineBatch_AddPoint(LineBatch *batch, const vec3 *point, const vec4 *color)
+{
+    LineVertex *vertex = LineBatch_Grow(
+        &batch->points, &batch->num_points, &batch->points_capacity, 1);
+    LineVertex_Init(vertex, point, color, false);
+}
+
+// Stream `count` vertices to the GPU and draw them as primitives of type
+// `mode`.
+static void LineBatch_DrawVertices(LineBatch *batch,
+    GLenum mode, const LineVertex *vertices, uint32_t count)
+{
+    GLintptr offset = GL_StreamBuffer_Upload(
+        batch->stream, vertices, count*sizeof(LineVertex));
+
+    glBindBuffer(GL_ARRAY_BUFFER, batch->stream->buffer);
+    {
+        glVertexAttribPointer(VERTEX_ATTRIB_POSITION, 3, GL_FLOAT,
+            GL_FALSE, sizeof(LineVertex),
+            (const GLvoid *)(offset + offsetof(LineVertex, position)));
+        glVertexAttribPointer(VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE,
+            GL_TRUE, sizeof(LineVertex),
+            (const GLvoid *)(offset + offsetof(LineVertex, color)));
+        glVertexAttribPointer(VERTEX_ATTRIB_DEPTH_FADE, 1, GL_UNSIGNED_BYTE,
+            GL_TRUE, sizeof(LineVertex),
+            (const GLvoid *)(offset + offsetof(LineVertex, depth_fade)));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glDrawArrays(mode, 0, count);
+}
+
+// Draw the lines and points collected in the batch. This is called by the
+// render queue, which has bound our program and vertex array.
+static uint32_t LineBatch_Draw(const RenderItem *item)
+{
+    LineBatch *batch = item->object;
+
+    glUniformMatrix4fv(batch->mvp, 1, GL_TRUE, mat4_Buffer(&batch->transform));
+
+    uint32_t draw_calls = 0;
+    if (batch->num_line_vertices > 0) {
+        LineBatch_DrawVertices(batch,
+            GL_LINES, batch->line_vertices, batch->num_line_vertices);
+        ++draw_calls;
+    }
+    if (batch->num_points > 0) {
+        LineBatch_DrawVertices(batch,
+            GL_POINTS, batch->points, batch->num_points);
+        ++draw_calls;
+    }
+
+    batch->num_line_vertices = 0;
+    batch->num_points = 0;
+    return draw_calls;
+}
+
+void LineBatch_Submit(LineBatch *batch, RenderQueue *queue,
+    GL_StreamBuffer *stream, const mat4 *transform)
+{
+    if (batch->num_line_vertices + batch->num_points == 0) {
+        return;
+    }
+
+    batch->stream = stream;
+    mat4_Copy(&batch->transform, transform);
+
+    RenderItem *item = RenderQueue_Add(queue, RENDER_LAYER_SCENE_DETAIL);
+    item->program = batch->shaders;
+    item->vao = batch->vao;
+    item->draw = LineBatch_Draw;
+    item->object = batch;
+}
@@ -327,6 +327,44 @@ bool mat4_Invert(const mat4 * restrict in, mat4 * restrict out)
     return true;
 }
 
+void Frustum_FromMatrix(const mat4 *m, Frustum *out)
+{
+    // A point p is visible when its clip coordinates c = Mp satisfy
+    // -c.w <= c.x, c.y, c.z <= c.w. Each of those six inequalities is a plane
+    // in world coordinates, obtained by adding or subtracting a row of `m`
+    // from the last row.
+    for (uint8_t axis = 0; axis < 3; ++axis) {
+        for (uint8_t side = 0; side < 2; ++side) {
+            float sign = side == 0 ? 1 : -1;
+            out->planes[2*axis + side] = (vec4){
+                m->M[3][0] + sign*m->M[axis][0],
+                m->M[3][1] + sign*m->M[axis][1],
+                m->M[3][2] + sign*m->M[axis][2],
+                m->M[3][3] + sign*m->M[axis][3],
+            };
+        }
+    }
+}
+
+bool Frustum_IntersectsBox(
+    const Frustum *frustum, const vec3 *min, const vec3 *max)
+{
+    for (uint8_t i = 0; i < 6; ++i) {
+        const vec4 *plane = &frustum->planes[i];
+
+        // Test the corner of the box furthest along the normal of the plane.
+        // If even that corner is outside, the whole box is.
+        float x = plane->x >= 0 ? max->x : min->x;
+        float y = plane->y >= 0 ? max->y : min->y;
+        float z = plane->z >= 0 ? max->z : min->z;
+        if (plane->x*x + plane->y*y + plane->z*z + plane->w < 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 #ifndef NDEBUG
 const char *mat4_String(mat4 *m)
 {
@@ -0,0 +1,237 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <GL/glew.h>
+
+#include "errors.h"
+#include "gl.h"
+#include "matrix.h"
+#include "minimap.h"
+#include "render_queue.h"
+
+// Uniforms for one draw of the minimap, attached to its render item.
+typedef struct {
+    GLfloat rect[4];
+        // Left, bottom, right and top edges of the minimap, in clip
+        // coordinates.
+    GLfloat pixel_size;
+        // Size of one screen pixel, in world coordinates.
+    GLfloat footprint[8];
+    GLfloat ball[2];
+} MinimapUniforms;
+
+void Minimap_Init(Minimap *minimap, float width, float height)
+{
+    ASSERT(width > 0 && height > 0);
+
+    minimap->world_width = width;
+    minimap->world_height = height;
+
+    // Give the texture the same aspect ratio as the world, so texels are
+    // square.
+    if (width >= height) {
+        minimap->texture_width = MINIMAP_TEXTURE_SIZE;
+        minimap->texture_height =
+            fmaxf(1, roundf(MINIMAP_TEXTURE_SIZE*height/width));
+    } else {
+        minimap->texture_width =
+            fmaxf(1, roundf(MINIMAP_TEXTURE_SIZE*width/height));
+        minimap->texture_height = MINIMAP_TEXTURE_SIZE;
+    }
+
+    minimap->dirty = true;
+    minimap->dirty_min_x = 0;
+    minimap->dirty_min_y = 0;
+    minimap->dirty_max_x = minimap->texture_width - 1;
+    minimap->dirty_max_y = minimap->texture_height - 1;
+
+    glGenTextures(1, &minimap->texture);
+    glBindTexture(GL_TEXTURE_2D, minimap->texture);
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+            minimap->texture_width, minimap->texture_height, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // The minimap is a top-down view of a height field, so no two surfaces
+    // ever overlap in it, and we don't need a depth buffer.
+    GLint framebuffer;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glGenFramebuffers(1, &minimap->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, minimap->framebuffer);
+    {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, minimap->texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+            GL_FRAMEBUFFER_COMPLETE)
+        {
+            warn("minimap framebuffer is incomplete\n", 0);
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    minimap->shaders = GL_LoadShaders(
+        "shaders/minimap_vertex.glsl", "shaders/minimap_fragment.glsl");
+    minimap->shader_rect = glGetUniformLocation(minimap->shaders, "rect");
+    minimap->shader_world_size =
+        glGetUniformLocation(minimap->shaders, "world_size");
+    minimap->shader_pixel_size =
+        glGetUniformLocation(minimap->shaders, "pixel_size");
+    minimap->shader_footprint =
+        glGetUniformLocation(minimap->shaders, "footprint");
+    minimap->shader_ball = glGetUniformLocation(minimap->shaders, "ball");
+
+    glGenVertexArrays(1, &minimap->vao);
+        // The quad is generated from the vertex IDs, so the vertex array has
+        // no attributes, but core profile still requires one to be bound.
+}
+
+void Minimap_Destroy(Minimap *minimap)
+{
+    glDeleteFramebuffers(1, &minimap->framebuffer);
+    glDeleteTextures(1, &minimap->texture);
+    glDeleteVertexArrays(1, &minimap->vao);
+    GL_ReleaseShaders(minimap->shaders);
+}
+
+void Minimap_Invalidate(Minimap *minimap,
+    float min_x, float min_y, float max_x, float max_y)
+{
+    // Convert to texels, rounding outwards, and with an extra texel on every
+    // side for the texels which straddle the edge of the rectangle.
+    float scale_x = minimap->texture_width/minimap->world_width;
+    float scale_y = minimap->texture_height/minimap->world_height;
+    int32_t texel_min_x = floorf(min_x*scale_x) - 1;
+    int32_t texel_min_y = floorf(min_y*scale_y) - 1;
+    int32_t texel_max_x = ceilf(max_x*scale_x) + 1;
+    int32_t texel_max_y = ceilf(max_y*scale_y) + 1;
+
+    texel_min_x = IntMax(texel_min_x, 0);
+    texel_min_y = IntMax(texel_min_y, 0);
+    texel_max_x = IntMin(texel_max_x, minimap->texture_width - 1);
+    texel_max_y = IntMin(texel_max_y, minimap->texture_height - 1);
+    if (texel_min_x > texel_max_x || texel_min_y > texel_max_y) {
+        return;
+    }
+
+    if (minimap->dirty) {
+        minimap->dirty_min_x = IntMin(minimap->dirty_min_x, texel_min_x);
+        minimap->dirty_min_y = IntMin(minimap->dirty_min_y, texel_min_y);
+        minimap->dirty_max_x = IntMax(minimap->dirty_max_x, texel_max_x);
+        minimap->dirty_max_y = IntMax(minimap->dirty_max_y, texel_max_y);
+    } else {
+        minimap->dirty = true;
+        minimap->dirty_min_x = texel_min_x;
+        minimap->dirty_min_y = texel_min_y;
+        minimap->dirty_max_x = texel_max_x;
+        minimap->dirty_max_y = texel_max_y;
+    }
+}
+
+void Minimap_Update(Minimap *minimap, Minimap_DrawFunction draw, void *object)
+{
+    if (!minimap->dirty) {
+        return;
+    }
+
+    GLint framebuffer;
+    GLint viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, minimap->framebuffer);
+    glViewport(0, 0, minimap->texture_width, minimap->texture_height);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(minimap->dirty_min_x, minimap->dirty_min_y,
+        minimap->dirty_max_x - minimap->dirty_min_x + 1,
+        minimap->dirty_max_y - minimap->dirty_min_y + 1);
+        // Only touch the texels which are out of date.
+    {
+        glClearBufferfv(GL_COLOR, 0, vec4_ConstBuffer(&RGBA_BLACK));
+            // Unlike `glClear`, this leaves the clear color alone.
+
+        // Map the world rectangle onto the whole texture, looking straight
+        // down. Every point is given the same depth, since there is no depth
+        // buffer.
+        float sx = 2/minimap->world_width;
+        float sy = 2/minimap->world_height;
+        mat4 transform = {{
+            { sx, 0,  0, -1 },
+            { 0,  sy, 0, -1 },
+            { 0,  0,  0,  0 },
+            { 0,  0,  0,  1 },
+        }};
+        float texel_width = minimap->world_width/minimap->texture_width;
+        float texel_height = minimap->world_height/minimap->texture_height;
+        draw(object, &transform,
+            minimap->dirty_min_x*texel_width,
+            minimap->dirty_min_y*texel_height,
+            (minimap->dirty_max_x + 1)*texel_width,
+            (minimap->dirty_max_y + 1)*texel_height);
+    }
+    glDisable(GL_SCISSOR_TEST);
+    glEnable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    minimap->dirty = false;
+}
+
+// Draw the minimap quad. This is called by the render queue, which has bound
+// our program, texture and vertex array.
+static uint32_t Minimap_Draw(const RenderItem *item)
+{
+    const Minimap *minimap = item->object;
+    const MinimapUniforms *uniforms = item->data;
+
+    glUniform4fv(minimap->shader_rect, 1, uniforms->rect);
+    glUniform2f(minimap->shader_world_size,
+        minimap->world_width, minimap->world_height);
+    glUniform1f(minimap->shader_pixel_size, uniforms->pixel_size);
+    glUniform2fv(minimap->shader_footprint, 4, uniforms->footprint);
+    glUniform2fv(minimap->shader_ball, 1, uniforms->ball);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    return 1;
+}
+
+void Minimap_Submit(Minimap *minimap, RenderQueue *queue,
+    uint32_t window_width, uint32_t window_height,
+    const vec2 footprint[4], const vec2 *ball)
+{
+    // Scale the world so its longer side is `MINIMAP_SCREEN_SIZE` pixels.
+    float pixel_size = FloatMax(minimap->world_width, minimap->world_height)/
+        MINIMAP_SCREEN_SIZE;
+    float width = minimap->world_width/pixel_size;
+    float height = minimap->world_height/pixel_size;
+
+    MinimapUniforms uniforms;
+    float right = window_width - MINIMAP_SCREEN_MARGIN;
+    float top = window_height - MINIMAP_SCREEN_MARGIN;
+    uniforms.rect[0] = 2*(right - width)/window_width - 1;
+    uniforms.rect[1] = 2*(top - height)/window_height - 1;
+    uniforms.rect[2] = 2*right/window_width - 1;
+    uniforms.rect[3] = 2*top/window_height - 1;
+    uniforms.pixel_size = pixel_size;
+    for (uint8_t i = 0; i < 4; ++i) {
+        uniforms.footprint[2*i] = footprint[i].x;
+        uniforms.footprint[2*i + 1] = footprint[i].y;
+    }
+    uniforms.ball[0] = ball->x;
+    uniforms.ball[1] = ball->y;
+
+    RenderItem *item = RenderQueue_Add(queue, RENDER_LAYER_OVERLAY);
+    item->blend = false;
+    item->program = minimap->shaders;
+    item->texture = minimap->texture;
+    item->vao = minimap->vao;
+    item->draw = Minimap_Draw;
+    item->object = minimap;
+    RenderQueue_SetData(queue, item, &uniforms, sizeof(uniforms));
+}
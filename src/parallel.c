@@ -0,0 +1,143 @@
+#include "os.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "errors.h"
+#include "matrix.h"
+#include "parallel.h"
+
+#ifdef GOLF_OS_POSIX
+
+typedef struct {
+    ParallelBody body;
+    void *arg;
+    uint32_t begin;
+    uint32_t end;
+} ParallelBand;
+
+static void *ParallelBand_Run(void *arg)
+{
+    ParallelBand *band = (ParallelBand *)arg;
+    band->body(band->begin, band->end, band->arg);
+    return NULL;
+}
+
+uint32_t Parallel_NumThreads(void)
+{
+    static uint32_t num_threads = 0;
+    if (num_threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = online < 1 ? 1 : UintMin(online, PARALLEL_MAX_THREADS);
+    }
+    return num_threads;
+}
+
+void Parallel_For(uint32_t n, uint32_t grain, ParallelBody body, void *arg)
+{
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    uint32_t num_bands = UintMin(Parallel_NumThreads(), n/grain);
+    if (num_bands <= 1) {
+        body(0, n, arg);
+        return;
+    }
+
+    ParallelBand bands[PARALLEL_MAX_THREADS];
+    pthread_t threads[PARALLEL_MAX_THREADS];
+    bool started[PARALLEL_MAX_THREADS];
+
+    // Divide the iterations as evenly as possible, giving the remainder to the
+    // first few bands.
+    uint32_t begin = 0;
+    for (uint32_t i = 0; i < num_bands; ++i) {
+        uint32_t size = n/num_bands + (i < n%num_bands ? 1 : 0);
+        bands[i] = (ParallelBand){ body, arg, begin, begin + size };
+        begin += size;
+    }
+    ASSERT(begin == n);
+
+    // Spawn a thread for every band but the last, which we run ourselves
+    // rather than leaving the calling thread idle.
+    for (uint32_t i = 0; i + 1 < num_bands; ++i) {
+        started[i] = pthread_create(
+            &threads[i], NULL, ParallelBand_Run, &bands[i]) == 0;
+        if (!started[i]) {
+            warn("unable to start worker thread, running band %u inline\n", i);
+            ParallelBand_Run(&bands[i]);
+        }
+    }
+    ParallelBand_Run(&bands[num_bands - 1]);
+
+    for (uint32_t i = 0; i + 1 < num_bands; ++i) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+struct ParallelJob {
+    ParallelTask task;
+    void *arg;
+    pthread_t thread;
+    bool started;
+        // Whether `thread` is running the task, as opposed to the task having
+        // been run by `Parallel_Start`.
+    pthread_mutex_t lock;
+    bool done;
+        // Protected by `lock`.
+};
+
+static void *ParallelJob_Run(void *arg)
+{
+    ParallelJob *job = (ParallelJob *)arg;
+    job->task(job->arg);
+
+    pthread_mutex_lock(&job->lock);
+    job->done = true;
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+ParallelJob *Parallel_Start(ParallelTask task, void *arg)
+{
+    ParallelJob *job = Malloc(sizeof(ParallelJob));
+    job->task = task;
+    job->arg = arg;
+    job->done = false;
+    pthread_mutex_init(&job->lock, NULL);
+
+    job->started = pthread_create(
+        &job->thread, NULL, ParallelJob_Run, job) == 0;
+    if (!job->started) {
+        warn("unable to start background thread, running job inline\n", 0);
+        ParallelJob_Run(job);
+    }
+
+    return job;
+}
+
+bool Parallel_IsDone(ParallelJob *job)
+{
+    pthread_mutex_lock(&job->lock);
+    bool done = job->done;
+    pthread_mutex_unlock(&job->lock);
+    return done;
+}
+
+void Parallel_Join(ParallelJob *job)
+{
+    if (job->started) {
+        pthread_join(job->thread, NULL);
+    }
+    pthread_mutex_destroy(&job->lock);
+    free(job);
+}
+
+#else
+# error "unsupported operating system"
+#endif
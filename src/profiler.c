@@ -0,0 +1,307 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "clock.h"
+#include "errors.h"
+#include "profiler.h"
+
+typedef struct {
+    const char *name;
+    int8_t parent;
+        // The zone this one is nested in, or -1 if it is not nested. This is
+        // only used to lay out summaries.
+    bool gpu;
+} ProfileZoneInfo;
+
+static const ProfileZoneInfo PROFILE_ZONE_INFO[PROFILE_ZONES] = {
+    [PROFILE_FRAME]       = { "frame",       -1,              false },
+    [PROFILE_RENDER]      = { "render",      PROFILE_FRAME,   false },
+    [PROFILE_ANIMATE]     = { "animate",     PROFILE_RENDER,  false },
+    [PROFILE_PHYSICS]     = { "physics",     PROFILE_ANIMATE, false },
+    [PROFILE_UPLOADS]     = { "uploads",     PROFILE_RENDER,  false },
+    [PROFILE_QUEUE]       = { "queue",       PROFILE_FRAME,   false },
+    [PROFILE_CONSOLE]     = { "console",     -1,              false },
+    [PROFILE_EDITS]       = { "edits",       -1,              false },
+    [PROFILE_GPU_SCENE]   = { "gpu scene",   -1,              true  },
+    [PROFILE_GPU_OVERLAY] = { "gpu overlay", -1,              true  },
+    [PROFILE_GPU_MINIMAP] = { "gpu minimap", -1,              true  },
+};
+
+typedef struct {
+    uint32_t depth;
+        // Number of calls to `Profiler_Begin` not yet matched by a call to
+        // `Profiler_End`.
+    uint64_t start_us;
+        // When the outermost `Profiler_Begin` was called.
+    uint64_t frame_us;
+        // Time spent in the zone so far this frame.
+    bool ran;
+        // Whether the zone has been entered this frame. Zones which only run
+        // now and then, like console commands, only record a sample for the
+        // frames they ran in, so their statistics aren't swamped by zeros.
+
+    uint32_t history[PROFILER_HISTORY];
+    uint32_t history_next;
+    uint32_t history_size;
+        // Circular buffer of recent samples, in microseconds.
+    uint64_t histogram[PROFILER_BUCKETS];
+
+    // GPU zones only
+    GLuint queries[PROFILER_GPU_LATENCY];
+    bool pending[PROFILER_GPU_LATENCY];
+        // Whether each query has been issued and its result not yet read.
+    uint8_t next_query;
+    bool query_active;
+        // Whether the outermost `Profiler_Begin` started a query.
+} ProfileZoneState;
+
+bool profiler_enabled = false;
+static bool profiler_requested = false;
+static bool profiler_has_queries = false;
+static ProfileZoneState profiler_zones[PROFILE_ZONES];
+
+static void Profiler_Record(ProfileZoneState *state, uint64_t us)
+{
+    if (us > UINT32_MAX) {
+        us = UINT32_MAX;
+    }
+
+    state->history[state->history_next] = us;
+    state->history_next = (state->history_next + 1) % PROFILER_HISTORY;
+    if (state->history_size < PROFILER_HISTORY) {
+        ++state->history_size;
+    }
+
+    uint8_t bucket = 0;
+    while (us > 0 && bucket + 1 < PROFILER_BUCKETS) {
+        us >>= 1;
+        ++bucket;
+    }
+    ++state->histogram[bucket];
+}
+
+// Read the result of the query in `slot` of a GPU zone, if it's ready.
+static void Profiler_CollectQuery(ProfileZoneState *state, uint8_t slot)
+{
+    if (!state->pending[slot]) {
+        return;
+    }
+
+    GLuint available = 0;
+    glGetQueryObjectuiv(
+        state->queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        return;
+    }
+
+    GLuint64 ns;
+    glGetQueryObjectui64v(state->queries[slot], GL_QUERY_RESULT, &ns);
+    state->pending[slot] = false;
+    Profiler_Record(state, ns/1000);
+}
+
+void Profiler_BeginZone(ProfileZone zone)
+{
+    ASSERT(zone < PROFILE_ZONES);
+    ProfileZoneState *state = &profiler_zones[zone];
+    if (state->depth++ > 0) {
+        return;
+    }
+
+    if (!PROFILE_ZONE_INFO[zone].gpu) {
+        state->ran = true;
+        state->start_us = Clock_GetTimeUS();
+        return;
+    }
+
+    // Only one timer query can be active at a time, so GPU zones can't nest,
+    // and we can't time anything while someone else is (for example, the
+    // headless benchmark timing whole frames).
+    GLint current = 0;
+    glGetQueryiv(GL_TIME_ELAPSED, GL_CURRENT_QUERY, &current);
+    uint8_t slot = state->next_query;
+    Profiler_CollectQuery(state, slot);
+    if (current != 0 || state->pending[slot]) {
+        state->query_active = false;
+            // Drop this sample. If the query from `PROFILER_GPU_LATENCY` frames
+            // ago still isn't done, waiting for it would stall the CPU.
+        return;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, state->queries[slot]);
+    state->query_active = true;
+}
+
+void Profiler_EndZone(ProfileZone zone)
+{
+    ASSERT(zone < PROFILE_ZONES);
+    ProfileZoneState *state = &profiler_zones[zone];
+    if (state->depth == 0) {
+        return;
+            // The zone began before the profiler was turned on.
+    }
+    if (--state->depth > 0) {
+        return;
+    }
+
+    if (!PROFILE_ZONE_INFO[zone].gpu) {
+        state->frame_us += Clock_GetTimeUS() - state->start_us;
+        return;
+    }
+
+    if (state->query_active) {
+        glEndQuery(GL_TIME_ELAPSED);
+        state->pending[state->next_query] = true;
+        state->next_query = (state->next_query + 1) % PROFILER_GPU_LATENCY;
+        state->query_active = false;
+    }
+}
+
+void Profiler_Enable(bool enable)
+{
+    profiler_requested = enable;
+}
+
+bool Profiler_IsEnabled(void)
+{
+    return profiler_requested;
+}
+
+void Profiler_EndFrame(void)
+{
+    if (profiler_enabled) {
+        for (uint8_t zone = 0; zone < PROFILE_ZONES; ++zone) {
+            ProfileZoneState *state = &profiler_zones[zone];
+            if (PROFILE_ZONE_INFO[zone].gpu) {
+                for (uint8_t i = 0; i < PROFILER_GPU_LATENCY; ++i) {
+                    Profiler_CollectQuery(state, i);
+                }
+            } else if (state->ran) {
+                Profiler_Record(state, state->frame_us);
+                state->frame_us = 0;
+                state->ran = false;
+            }
+        }
+    }
+
+    if (profiler_requested != profiler_enabled) {
+        profiler_enabled = profiler_requested;
+        if (profiler_enabled) {
+            if (!profiler_has_queries) {
+                for (uint8_t zone = 0; zone < PROFILE_ZONES; ++zone) {
+                    if (PROFILE_ZONE_INFO[zone].gpu) {
+                        glGenQueries(PROFILER_GPU_LATENCY,
+                            profiler_zones[zone].queries);
+                    }
+                }
+                profiler_has_queries = true;
+            }
+            Profiler_Reset();
+        }
+    }
+}
+
+void Profiler_Reset(void)
+{
+    for (uint8_t zone = 0; zone < PROFILE_ZONES; ++zone) {
+        ProfileZoneState *state = &profiler_zones[zone];
+        state->frame_us = 0;
+        state->ran = false;
+        state->history_next = 0;
+        state->history_size = 0;
+        memset(state->histogram, 0, sizeof(state->histogram));
+        memset(state->pending, 0, sizeof(state->pending));
+            // Any queries in flight belong to frames we're discarding. We may
+            // reuse them without reading their results.
+    }
+}
+
+static int Profiler_CompareSamples(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+void Profiler_GetSummary(ProfileZone zone, ProfileSummary *summary)
+{
+    ASSERT(zone < PROFILE_ZONES);
+    const ProfileZoneState *state = &profiler_zones[zone];
+
+    summary->name = PROFILE_ZONE_INFO[zone].name;
+    summary->gpu = PROFILE_ZONE_INFO[zone].gpu;
+    summary->depth = 0;
+    for (int8_t parent = PROFILE_ZONE_INFO[zone].parent; parent >= 0;
+         parent = PROFILE_ZONE_INFO[parent].parent)
+    {
+        ++summary->depth;
+    }
+
+    summary->samples = state->history_size;
+    summary->avg_ms = 0;
+    summary->p95_ms = 0;
+    summary->max_ms = 0;
+    if (state->history_size == 0) {
+        return;
+    }
+
+    uint32_t sorted[PROFILER_HISTORY];
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < state->history_size; ++i) {
+        sorted[i] = state->history[i];
+        total += sorted[i];
+    }
+    qsort(sorted, state->history_size, sizeof(uint32_t),
+        Profiler_CompareSamples);
+
+    uint32_t p95 = (95*state->history_size + 99)/100 - 1;
+        // The smallest sample no less than 95% of the samples.
+    summary->avg_ms = (float)total/state->history_size/1000;
+    summary->p95_ms = sorted[p95]/1000.0f;
+    summary->max_ms = sorted[state->history_size - 1]/1000.0f;
+}
+
+bool Profiler_Dump(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return false;
+    }
+
+    // Samples, oldest first.
+    fprintf(file, "zone,sample,us\n");
+    for (uint8_t zone = 0; zone < PROFILE_ZONES; ++zone) {
+        const ProfileZoneState *state = &profiler_zones[zone];
+        uint32_t first = (state->history_next + PROFILER_HISTORY -
+                          state->history_size) % PROFILER_HISTORY;
+        for (uint32_t i = 0; i < state->history_size; ++i) {
+            fprintf(file, "%s,%u,%u\n", PROFILE_ZONE_INFO[zone].name, i,
+                state->history[(first + i) % PROFILER_HISTORY]);
+        }
+    }
+
+    // Histograms, with the range of each bucket.
+    fprintf(file, "\nzone,min_us,max_us,count\n");
+    for (uint8_t zone = 0; zone < PROFILE_ZONES; ++zone) {
+        const ProfileZoneState *state = &profiler_zones[zone];
+        for (uint8_t i = 0; i < PROFILER_BUCKETS; ++i) {
+            unsigned long long min = i == 0 ? 0 : 1ull << (i - 1);
+            unsigned long long max = i == 0 ? 0
+                                   : i + 1 == PROFILER_BUCKETS ? UINT32_MAX
+                                   : (1ull << i) - 1;
+            fprintf(file, "%s,%llu,%llu,%llu\n", PROFILE_ZONE_INFO[zone].name,
+                min, max, (unsigned long long)state->histogram[i]);
+        }
+    }
+
+    bool ok = !ferror(file);
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    return ok;
+}
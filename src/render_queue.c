@@ -0,0 +1,172 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "errors.h"
+#include "render_queue.h"
+
+void RenderQueue_Init(RenderQueue *queue)
+{
+    memset(queue, 0, sizeof(*queue));
+}
+
+void RenderQueue_Destroy(RenderQueue *queue)
+{
+    free(queue->items);
+    free(queue->data);
+}
+
+RenderItem *RenderQueue_Add(RenderQueue *queue, RenderLayer layer)
+{
+    ASSERT(layer < RENDER_LAYERS);
+
+    if (queue->num_items >= queue->capacity) {
+        // Grow geometrically, so that after the first few frames the queue is
+        // big enough for a whole frame and we stop reallocating.
+        queue->capacity = queue->capacity ? 2*queue->capacity : 64;
+        queue->items =
+            Realloc(queue->items, queue->capacity*sizeof(RenderItem));
+    }
+
+    RenderItem *item = &queue->items[queue->num_items];
+    memset(item, 0, sizeof(*item));
+    item->layer = layer;
+    item->blend = true;
+    item->sequence = queue->num_items++;
+    return item;
+}
+
+void RenderQueue_SetData(
+    RenderQueue *queue, RenderItem *item, const void *data, size_t size)
+{
+    if (queue->data_size + size > queue->data_capacity) {
+        queue->data_capacity = 2*queue->data_capacity;
+        if (queue->data_capacity < queue->data_size + size) {
+            queue->data_capacity = queue->data_size + size;
+        }
+        queue->data = Realloc(queue->data, queue->data_capacity);
+    }
+
+    memcpy(queue->data + queue->data_size, data, size);
+    item->data_offset = queue->data_size;
+        // We can't store a pointer yet, since the storage may move when later
+        // items add data. `RenderQueue_Execute` fills in `item->data`.
+    queue->data_size += size;
+}
+
+void RenderQueue_SetLayerFunction(RenderQueue *queue,
+    RenderQueue_LayerFunction begin_layer, void *object)
+{
+    queue->begin_layer = begin_layer;
+    queue->begin_layer_object = object;
+}
+
+// Call the layer function, if there is one, for each layer up to and including
+// `layer` which hasn't started yet. `next_layer` is the first of those.
+static void RenderQueue_BeginLayers(
+    RenderQueue *queue, uint8_t *next_layer, uint8_t layer)
+{
+    for (; *next_layer <= layer; ++*next_layer) {
+        if (queue->begin_layer != NULL) {
+            queue->begin_layer(*next_layer, queue->begin_layer_object);
+        }
+    }
+}
+
+// Order items by layer, then by state, so that items with the same state are
+// adjacent, with the most expensive state to change sorted first. Items with
+// identical state stay in the order they were submitted.
+static int RenderQueue_Compare(const void *a, const void *b)
+{
+    const RenderItem *x = a;
+    const RenderItem *y = b;
+
+#define RENDER_QUEUE_COMPARE(field) \
+    if (x->field != y->field) { \
+        return x->field < y->field ? -1 : 1; \
+    }
+
+    RENDER_QUEUE_COMPARE(layer);
+    RENDER_QUEUE_COMPARE(blend);
+    RENDER_QUEUE_COMPARE(program);
+    RENDER_QUEUE_COMPARE(texture);
+    RENDER_QUEUE_COMPARE(vao);
+    RENDER_QUEUE_COMPARE(sequence);
+
+#undef RENDER_QUEUE_COMPARE
+
+    return 0;
+}
+
+void RenderQueue_Execute(RenderQueue *queue)
+{
+    RenderQueueStats *stats = &queue->stats;
+    memset(stats, 0, sizeof(*stats));
+    stats->items = queue->num_items;
+
+    qsort(queue->items, queue->num_items, sizeof(RenderItem),
+        RenderQueue_Compare);
+
+    // The state bound by the last item. Before the first item, we don't know
+    // what is bound, so the first item always sets everything.
+    const RenderItem *prev = NULL;
+    uint8_t next_layer = 0;
+
+    glActiveTexture(GL_TEXTURE0);
+    for (uint32_t i = 0; i < queue->num_items; ++i) {
+        RenderItem *item = &queue->items[i];
+        RenderQueue_BeginLayers(queue, &next_layer, item->layer);
+
+        if (prev == NULL || item->blend != prev->blend) {
+            if (item->blend) {
+                glEnable(GL_BLEND);
+            } else {
+                glDisable(GL_BLEND);
+            }
+            ++stats->blend_changes;
+        }
+        if (prev == NULL || item->program != prev->program) {
+            glUseProgram(item->program);
+            ++stats->program_changes;
+        }
+        if (prev == NULL || item->texture != prev->texture) {
+            glBindTexture(GL_TEXTURE_2D, item->texture);
+            ++stats->texture_changes;
+        }
+        if (prev == NULL || item->vao != prev->vao) {
+            glBindVertexArray(item->vao);
+            ++stats->vao_changes;
+        }
+
+        item->data = queue->data != NULL
+                   ? queue->data + item->data_offset
+                   : NULL;
+        if (item->draw != NULL) {
+            stats->draw_calls += item->draw(item);
+        } else {
+            glDrawArrays(item->mode, 0, item->count);
+            ++stats->draw_calls;
+        }
+
+        prev = item;
+    }
+    RenderQueue_BeginLayers(queue, &next_layer, RENDER_LAYERS - 1);
+
+    // Restore the default state.
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    glEnable(GL_BLEND);
+
+    queue->num_items = 0;
+    queue->data_size = 0;
+}
+
+void RenderQueue_GetStats(const RenderQueue *queue, RenderQueueStats *stats)
+{
+    *stats = queue->stats;
+}
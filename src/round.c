@@ -35,6 +35,11 @@ void Round_Step(Round *round, uint32_t dt)
     }
 }
 
+bool Round_InMotion(const Round *round)
+{
+    return round->shot_sim != NULL;
+}
+
 void Round_GetBallPosition(const Round *round, vec3 *ball_position)
 {
     *ball_position = round->shot.x;
@@ -3,29 +3,44 @@
 
 const Material fairway = {
     .name = "fairway",
+    .id = MATERIAL_FAIRWAY,
     .color = { 0.35, 0.6, 0.2, 1.0 },
 };
 const Material green = {
     .name = "green",
+    .id = MATERIAL_GREEN,
     .color = { 0.2, 0.9, 0.25, 1.0 },
 };
 const Material tee = {
     .name = "tee",
+    .id = MATERIAL_TEE,
     .color = { 0.2, 0.4, 0.15, 1.0 },
 };
 const Material rough = {
     .name = "rough",
+    .id = MATERIAL_ROUGH,
     .color = { 0.1, 0.25, 0.1, 1.0 },
 };
 const Material sand = {
     .name = "sand",
+    .id = MATERIAL_SAND,
     .color = { 0.8, 0.8, 0.1, 1.0 },
 };
 const Material water = {
     .name = "water",
+    .id = MATERIAL_WATER,
     .color = { 0.1, 0.1, 0.7, 1.0 },
 };
 
+const Material *const materials[NUM_MATERIALS] = {
+    [MATERIAL_FAIRWAY] = &fairway,
+    [MATERIAL_GREEN]   = &green,
+    [MATERIAL_TEE]     = &tee,
+    [MATERIAL_ROUGH]   = &rough,
+    [MATERIAL_SAND]    = &sand,
+    [MATERIAL_WATER]   = &water,
+};
+
 void Terrain_Init(Terrain *terrain,
     uint16_t width, uint16_t height, uint8_t xy_resolution)
 {
@@ -182,27 +197,6 @@ void Terrain_RaiseFace(
     Terrain_RaiseFaceVertex(terrain, min, max, row, col, BOTTOM_LEFT,  delta);
 }
 
-static float Terrain_GetVertex(
-    const Terrain *terrain, uint16_t row, uint16_t col)
-{
-    ASSERT(row < Terrain_VertexHeight(terrain));
-    ASSERT(col < Terrain_VertexWidth(terrain));
-
-    if (row < Terrain_FaceHeight(terrain)) {
-        if (col < Terrain_FaceWidth(terrain)) {
-            return Terrain_GetConstFace(terrain, row, col)->vertices[BOTTOM_LEFT];
-        } else {
-            return Terrain_GetConstFace(terrain, row, col - 1)->vertices[BOTTOM_RIGHT];
-        }
-    } else {
-        if (col < Terrain_FaceWidth(terrain)) {
-            return Terrain_GetConstFace(terrain, row - 1, col)->vertices[TOP_LEFT];
-        } else {
-            return Terrain_GetConstFace(terrain, row - 1, col - 1)->vertices[TOP_RIGHT];
-        }
-    }
-}
-
 float Terrain_SampleHeight(const Terrain *terrain, float x, float y)
 {
     ASSERT(0 <= x && x < Terrain_FaceWidth(terrain)*terrain->xy_resolution);
@@ -279,9 +273,9 @@ float Terrain_SampleHeight(const Terrain *terrain, float x, float y)
         // since we choose the triangle such that it contains the point.
 
     float result =
-        Wa*Terrain_GetVertex(terrain, round(row + a.y), round(col + a.x)) +
-        Wb*Terrain_GetVertex(terrain, round(row + b.y), round(col + b.x)) +
-        Wc*Terrain_GetVertex(terrain, round(row + c.y), round(col + c.x));
+        Wa*Terrain_GetVertexHeight(terrain, round(row+a.y), round(col+a.x)) +
+        Wb*Terrain_GetVertexHeight(terrain, round(row+b.y), round(col+b.x)) +
+        Wc*Terrain_GetVertexHeight(terrain, round(row+c.y), round(col+c.x));
     return result;
 }
 
@@ -1,11 +1,22 @@
+#include <errno.h>
+#include <float.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 
 #include <GL/glew.h>
 
+#include "clock.h"
 #include "errors.h"
 #include "gl.h"
+#include "height_pyramid.h"
+#include "horizon.h"
+#include "line_batch.h"
 #include "matrix.h"
+#include "minimap.h"
+#include "parallel.h"
+#include "profiler.h"
+#include "render_queue.h"
 #include "round.h"
 #include "terrain.h"
 #include "terrain_view.h"
@@ -26,58 +37,44 @@
     // user's mouse wheel. For example, 1.1 means we zoom in 10% each time the
     // user scrolls up.
 
-typedef struct {
-    GLuint vao;
-    GLuint positions;
-    GLuint colors;
-} Axis;
+#define TERRAIN_CHUNK_SIZE 32
+    // Width and height, in faces, of the square chunks the terrain is divided
+    // into for culling. Chunks along the top and right edges of the terrain
+    // may be smaller.
 
-static void Axis_Init(Axis *axis, const vec3 *v, const vec3 *color)
-{
-    vec3 positions[2] = {0};
-    vec3 colors[2] = { *color, *color };
-    vec3_Scale(1000, v, &positions[1]);
+#define TERRAIN_LOD_LEVELS 6
+    // Number of levels of detail at which a chunk can be drawn. Level `k` only
+    // uses every `2^k`th row and column of vertices, so at the coarsest level a
+    // full chunk is a single pair of triangles.
 
-    // Create VAO
-    glGenVertexArrays(1, &axis->vao);
-    glBindVertexArray(axis->vao);
-    {
-        // Initialize position buffer
-        glGenBuffers(1, &axis->positions);
-        glBindBuffer(GL_ARRAY_BUFFER, axis->positions);
-        {
-            glBufferData(
-                GL_ARRAY_BUFFER, sizeof(positions), positions, GL_STATIC_DRAW);
-            glVertexAttribPointer(
-                VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
-            glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION);
-        }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+#define TERRAIN_LOD_FACE_PIXELS 8.0
+    // Chunks switch to a coarser level of detail once their faces would be
+    // smaller than this many pixels across on screen. Beyond that point, extra
+    // triangles add little visible detail but still cost vertex processing.
 
-        // Initialize color buffer
-        glGenBuffers(1, &axis->colors);
-        glBindBuffer(GL_ARRAY_BUFFER, axis->colors);
-        {
-            glBufferData(
-                GL_ARRAY_BUFFER, sizeof(colors), colors, GL_STATIC_DRAW);
-            glVertexAttribPointer(
-                VERTEX_ATTRIB_COLOR, 3, GL_FLOAT, GL_FALSE, 0, 0);
-            glEnableVertexAttribArray(VERTEX_ATTRIB_COLOR);
-        }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+#define TERRAIN_LOD_MORPH_START 0.75
+    // Fraction of the way through its distance range at which a chunk starts
+    // morphing towards the next coarser level of detail.
 
-    }
-    glBindVertexArray(0);
-}
+#define TERRAIN_PALETTE_SIZE 16
+    // Length of the `palette` uniform array in the terrain fragment shader,
+    // which bounds the number of materials we can render.
 
-static void Axis_Render(const Axis *axis)
-{
-    glBindVertexArray(axis->vao);
-    {
-        glDrawArrays(GL_LINES, 0, 2);
-    }
-    glBindVertexArray(0);
-}
+#define PERF_OVERLAY_PERIOD_MS 500
+    // How often the profiler overlay is refreshed. Redrawing it every frame
+    // would make the numbers too jumpy to read.
+
+#define PERF_OVERLAY_COLUMNS 37
+    // The table is 35 characters wide, and `TextField_Printf` needs room for
+    // the newline and the terminating null after each line.
+
+#define PERF_OVERLAY_ROWS (PROFILE_ZONES + 2)
+    // A header, a line per zone, and an empty line at the bottom which the
+    // cursor rests on, so that printing a full table scrolls out the old one.
+
+#define PERF_OVERLAY_MARGIN 10
+    // Pixels between the profiler overlay and the bottom right corner of the
+    // window.
 
 typedef struct {
     enum {
@@ -93,47 +90,111 @@ typedef struct {
     } data;
 } HUD;
 
+// A rectangular block of faces which is culled and drawn as a unit.
+typedef struct {
+    uint16_t min_row;
+    uint16_t min_col;
+    uint16_t max_row;
+    uint16_t max_col;
+        // Faces in the chunk, inclusive.
+    uint16_t min_z;
+    uint16_t max_z;
+        // Range of heights of the vertices in the chunk. Together with the
+        // faces, this gives us a bounding box for culling.
+    uint32_t first_index[TERRAIN_LOD_LEVELS];
+    uint32_t num_indices[TERRAIN_LOD_LEVELS];
+        // At each level of detail, the triangles of each chunk occupy a
+        // contiguous range of the terrain element buffer.
+    uint32_t first_edge_index[TERRAIN_LOD_LEVELS];
+    uint32_t num_edge_indices[TERRAIN_LOD_LEVELS];
+        // Likewise for the lines of each chunk in the mesh element buffer.
+    uint8_t lod;
+        // The level of detail at which to draw the chunk this frame, or
+        // `TERRAIN_LOD_LEVELS` if it is outside the view frustum.
+} TerrainChunk;
+
+// The inputs and outputs of a recomputation of the normals and occlusion of the
+// vertices around an edit (see `TerrainView_StartRebuild`). The job works on
+// its own copies of the data, so the render thread can keep drawing, and even
+// editing, the terrain while it runs on a background thread.
+typedef struct {
+    uint16_t *heights;
+        // Snapshot of the heights the job reads, indexed like the vertex grid.
+        // Only the rows near the edit are copied.
+    vec3 *normals;
+    uint8_t *occlusion;
+        // Back buffers the job writes its results to, indexed like the vertex
+        // grid. Only the rectangles affected by the edit are written.
+    uint16_t width;
+    uint16_t height;
+        // Dimensions of the vertex grid.
+    float xy_resolution;
+    uint16_t min_row;
+    uint16_t min_col;
+    uint16_t max_row;
+    uint16_t max_col;
+        // The vertices whose heights changed, inclusive.
+} TerrainRebuild;
+
 struct TerrainView {
     View view;
     Terrain *terrain;
     uint32_t num_vertices;
+        // Number of vertices in the terrain grid. Each vertex is shared by all
+        // of the faces incident to it.
+    uint32_t num_indices;
+        // Number of elements in the terrain index buffer, 3 per triangle, over
+        // all levels of detail.
+    uint32_t num_edge_indices;
+        // Number of elements in the mesh index buffer, 2 per edge, over all
+        // levels of detail.
+    uint16_t *heights;
+    vec3 *normals;
+    uint8_t *occlusion;
+    uint8_t *materials;
+        // CPU copies of the per-vertex data we upload to the GPU, indexed like
+        // the vertex grid. Keeping these around lets us recompute and upload
+        // only the part of the terrain affected by an edit.
+    TerrainRebuild rebuild;
+    ParallelJob *rebuild_job;
+        // The background job computing `rebuild`, or NULL if none is running.
+    bool dirty;
+    uint16_t dirty_min_row;
+    uint16_t dirty_min_col;
+    uint16_t dirty_max_row;
+    uint16_t dirty_max_col;
+        // If `dirty` is set, the vertices whose heights have changed since
+        // the last rebuild started, inclusive.
+    HeightPyramid pyramid;
+        // Maximum heights over blocks of faces, for finding the point on the
+        // terrain under the cursor (see `TerrainView_Pick`).
+    TerrainChunk *chunks;
+    uint32_t num_chunks;
+    GLsizei *chunk_counts;
+    const GLvoid **chunk_offsets;
+        // Scratch space for the `glMultiDrawElements` arguments describing the
+        // visible chunks, one entry per chunk.
     float camera_x;
     float camera_y;
     uint16_t camera_zoom;
-    vec3 mouse_position;
-        // We cache the mouse position from the last time the terrain was
-        // rendered, including the z-value from the depth buffer right after
-        // drawing the terrain. This allows us to recover 3D world-space
-        // coordinates for the corresponding point on the terrain without ray-
-        // casting.
-        //
-        // It's important that we read the z-coordinate right after we draw the
-        // terrain, because objects drawn later (such as axes, or the console)
-        // might overwrite that pixel in the depth buffer.
-        //
-        // The point stored here is represented in normalized device
-        // coordinates:
-        //  * x ranges from -1 to 1, scaled for the width of the window.
-        //  * y ranges from -1 to 1, scaled for the height of the window.
-        //  * z ranges from -1 to 1, where -1 is the near clipping plane and 1
-        //    is the far one.
-        //
-        // Note that it is possible the mouse is in a location which does not
-        // correspond to any location in the terrain. This case can be
-        // distinguished because the z-coordinate of the point will be exactly 1
-        // (since a mouse position that misses the terrain will hit the far
-        // clipping plane).
     vec3 ruler_start;
         // When the user left-clicks and drags with no special tool selected, we
         // will draw a ruler from where the first clicked to where the mouse is
         // now. This point represents the point on the terrain where they first
         // clicked.
+    vec3 ruler_end;
+        // The point the ruler currently extends to. This is only meaningful if
+        // `draw_ruler` is set.
     TextField *ruler_text;
         // While the user is still holding down the left mouse button during a
         // click-and-drag, this will be a pointer to a text field displaying the
         // length of the ruler.
         //
         // Otherwise, if no ruler is being drawn, this will be NULL.
+    TextField *perf_text;
+        // While the profiler is on, a text field showing its summary, or NULL.
+    uint64_t perf_text_time;
+        // When `perf_text` was last refreshed, in milliseconds.
     bool draw_ruler;
         // While the user is still holding down the left mouse button during a
         // click-and-drag, this will be set to indicate that `ruler_start` is
@@ -154,6 +215,15 @@ struct TerrainView {
         //
         // Right-multiply this matrix by a model matrix to map model coordinates
         // to screen coordinates.
+    Frustum frustum;
+        // The view frustum of `view_projection`, in world coordinates. This
+        // must be updated whenever `view_projection` is updated.
+    vec3 camera_position;
+        // The position of the camera in world coordinates. This must be
+        // updated whenever `view_projection` is updated.
+    float lod_ranges[TERRAIN_LOD_LEVELS];
+        // Distance from the camera, in yards, out to which each level of detail
+        // is used. These depend on the projection, and so on the window size.
     mat4 view_projection_inv;
         // Inverse of `view_projection`. Converts screen coordinates to world
         // coordinates. This matrix must be updated whenever `view_projection`
@@ -162,47 +232,70 @@ struct TerrainView {
         // Left-multiply this matrix by the inverse of a model matrix to map
         // screen coordinates to model coordinates.
 
+    // Versions of the inputs to derived state, like the matrices above, the
+    // hole routes and the hole labels. Each is bumped whenever its input
+    // changes, and each piece of derived state remembers the versions it was
+    // computed from, so `TerrainView_UpdateDerived` only recomputes what is out
+    // of date, and an idle frame does no matrix or buffer work.
+    uint32_t camera_version;
+        // Camera position and zoom, and the size of the window.
+    uint32_t heights_version;
+    uint32_t holes_version;
+        // Hole definitions, and whether we are showing them.
+    uint32_t mvp_camera_version;
+    uint32_t mvp_window_width;
+    uint32_t mvp_window_height;
+    uint32_t routes_heights_version;
+    uint32_t routes_holes_version;
+    uint32_t labels_camera_version;
+    uint32_t labels_heights_version;
+    uint32_t labels_holes_version;
+
     // Round in progress
     Round round;
-    GLuint gl_ball_vao;
-    GLuint gl_ball_buffer;
 
     // Terrain GL objects
     bool show_terrain;
     bool show_terrain_mesh;
-    GLuint gl_terrain_vao;          // Vertex array object
-    GLuint gl_terrain_positions;    // Position buffer
-    GLuint gl_terrain_normals;      // Normal buffer
-    GLuint gl_terrain_colors;       // Color buffer
-    GLuint gl_terrain_shaders;      // Shader program
-    GLuint gl_terrain_shader_mvp;   // MVP matrix
-    GLuint gl_terrain_shader_mesh;  // Mesh flag
-
-    // Axis GL objects
+    GLuint gl_terrain_vao;            // Vertex array object
+    GLuint gl_terrain_mesh_vao;       // Vertex array object for the mesh
+    GLuint gl_terrain_heights;        // Height texture
+    GLuint gl_terrain_indices;        // Element buffer
+    GLuint gl_terrain_edges;          // Mesh element buffer
+    GLuint gl_terrain_normals;        // Normal buffer
+    GLuint gl_terrain_occlusion;      // Ambient occlusion buffer
+    GLuint gl_terrain_materials;      // Material ID buffer
+    GLuint gl_terrain_shaders;        // Shader program
+    GLuint gl_terrain_shader_mvp;     // MVP matrix
+    GLuint gl_terrain_shader_mesh;    // Mesh flag
+    GLuint gl_terrain_shader_heights; // Height texture sampler
+    GLuint gl_terrain_shader_camera;  // Camera position
+    GLuint gl_terrain_shader_stride;  // Level of detail grid spacing
+    GLuint gl_terrain_shader_morph;   // Level of detail morph range
+
+    // Overview of the whole course, drawn in the corner of the window.
+    bool show_minimap;
+    Minimap minimap;
+    uint8_t minimap_lod;
+        // The level of detail whose faces are closest to one texel of the
+        // minimap.
+
+    // Lines and points: ruler, hole routes, ball and axes. All of these are
+    // small, so rather than keeping a buffer for each, we add them to a batch
+    // every frame, which draws them all at once.
+    LineBatch lines;
     bool show_axes;
-    Axis x_axis;
-    Axis y_axis;
-    Axis z_axis;
-    GLuint gl_axis_shaders;
-    GLuint gl_axis_shader_mvp;
-
-    // Lines: ruler, hole maps, etc.
-    GLuint gl_lines_shaders;
-    GLuint gl_lines_shader_mvp;
-    GLuint gl_ruler_vao;
-    GLuint gl_ruler_buffer;
+    LineVertex axes[6];
+        // The x, y and z axes, as pairs of vertices.
     bool show_holes;
-    GLuint gl_holes_vao[18];
-    GLuint gl_holes_buffers[18];
+    vec3 hole_points[18][4];
+        // Waypoints of each hole, from the tee to the pin. A hole has at most
+        // par 5, so at most 4 waypoints.
+    LineVertex hole_routes[18*3*2];
+    uint8_t num_hole_route_lines;
+        // Line segments between the waypoints of every hole, which only
+        // change when a hole is defined or the terrain under it is edited.
     TextField *hole_labels[18];
-
-#ifndef NDEBUG
-    uint32_t dts[10];
-        // Milliseconds required to render the last 10 frames. This array
-        // represents a circular buffer.
-    uint8_t dts_next;
-        // Offset into `dts` of the next sample to overwrite.
-#endif
 };
 
 static Command view_program;
@@ -322,17 +415,42 @@ static vec2 TerrainView_XYtoScreen(const TerrainView *view, vec2 xy)
     return (vec2){ width*(p.x + 1)/2, height*(p.y + 1)/2 };
 }
 
-static void TerrainView_UpdateHoleLines(TerrainView *view)
+// Place each hole's label next to its pin on screen, or hide it if we aren't
+// showing holes.
+static void TerrainView_UpdateHoleLabels(TerrainView *view)
 {
     for (uint8_t i = 0; i < 18; ++i) {
         const Hole *hole = Terrain_GetConstHole(view->terrain, i);
-        if (hole == NULL) {
+        if (hole == NULL || !view->show_holes) {
             View_Detach((View *)view->hole_labels[i]);
             continue;
         }
 
-        // Create a buffer of waypoints.
-        vec3 points[4];
+        const vec3 *pin = &view->hole_points[i][hole->par - 2];
+        vec2 hole_loc_world = { pin->x, pin->y };
+        vec2 hole_loc_screen = TerrainView_XYtoScreen(view, hole_loc_world);
+
+        TextField_SetLocation(
+            view->hole_labels[i],
+            hole_loc_screen.x + 5,
+            hole_loc_screen.y + 10
+        );
+        View_Attach((View *)view->hole_labels[i], (View *)view);
+    }
+}
+
+// Recompute the waypoints of each hole and the lines between them.
+static void TerrainView_UpdateHoleRoutes(TerrainView *view)
+{
+    view->num_hole_route_lines = 0;
+    for (uint8_t i = 0; i < 18; ++i) {
+        const Hole *hole = Terrain_GetConstHole(view->terrain, i);
+        if (hole == NULL) {
+            continue;
+        }
+
+        // Compute the waypoints.
+        vec3 *points = view->hole_points[i];
         for (uint8_t j = 0; j < hole->par - 1; ++j) {
             uint16_t row = hole->shot_points[j][0];
             uint16_t col = hole->shot_points[j][1];
@@ -348,39 +466,12 @@ static void TerrainView_UpdateHoleLines(TerrainView *view)
             points[j] = (vec3){x, y, z};
         }
 
-        // Give the buffer to OpenGL.
-        glBindVertexArray(view->gl_holes_vao[i]);
-        {
-            glBindBuffer(GL_ARRAY_BUFFER, view->gl_holes_buffers[i]);
-            {
-                glBufferData(
-                    GL_ARRAY_BUFFER,
-                    sizeof(vec3)*hole->par - 1,
-                    points,
-                    GL_DYNAMIC_DRAW
-                );
-                glVertexAttribPointer(
-                    VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
-                glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION);
-            }
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
-        }
-        glBindVertexArray(0);
-
-        // Fix the hole's label, if necessary.
-        if (view->show_holes) {
-            vec2 hole_loc_world = { points[hole->par - 2].x
-                                  , points[hole->par - 2].y };
-            vec2 hole_loc_screen = TerrainView_XYtoScreen(view, hole_loc_world);
-
-            TextField_SetLocation(
-                view->hole_labels[i],
-                hole_loc_screen.x + 5,
-                hole_loc_screen.y + 10
-            );
-            View_Attach((View *)view->hole_labels[i], (View *)view);
-        } else {
-            View_Detach((View *)view->hole_labels[i]);
+        // Connect them.
+        for (uint8_t j = 1; j < hole->par - 1; ++j) {
+            LineVertex *line =
+                &view->hole_routes[2*view->num_hole_route_lines++];
+            LineVertex_Init(&line[0], &points[j - 1], &RGBA_WHITE, false);
+            LineVertex_Init(&line[1], &points[j], &RGBA_WHITE, false);
         }
     }
 }
@@ -390,9 +481,10 @@ static void TerrainView_UpdateMVP(TerrainView *view)
     // Initialize the perspective projection.
     uint32_t window_width, window_height;
     View_GetWindowSize((View *)view, &window_width, &window_height);
+    float fov = M_PI/3;
+        // pi/3, or 60 degree, field of vision.
     mat4_Perspective(&view->projection,
-        M_PI/3,
-            // pi/3, or 60 degree, field of vision.
+        fov,
         (float)window_width/window_height,
             // Aspect ratio is determined by window size.
         10.0, 5000.0
@@ -482,15 +574,49 @@ static void TerrainView_UpdateMVP(TerrainView *view)
         // Now the z-axis angles isometrically away from the terrain. We move
         // the terrain 30yds further down the z axis, effectively zooming out
         // 30yds. Now we're in camera coordinates.
+
     mat4_ComposeInPlace(&view->projection, &view->view_projection);
         // Apply the perspective projection, so `view_projection` now maps from
         // world space to screen space.
 
+    Frustum_FromMatrix(&view->view_projection, &view->frustum);
+
+    // Level of detail `k` draws faces `2^k*xy` yards across, which span about
+    // `2^k*xy*focal_length/d` pixels when they are `d` yards from the camera.
+    // Each level is used until the faces of the next coarser level would be at
+    // least `TERRAIN_LOD_FACE_PIXELS` across, so the ranges double each level.
+    float xy = view->terrain->xy_resolution;
+    float focal_length = window_width/(2*tanf(fov/2));
+        // Distance from the eye to the screen, in pixels.
+    float range = 2*xy*focal_length/TERRAIN_LOD_FACE_PIXELS;
+    float chunk_diagonal = sqrtf(2)*TERRAIN_CHUNK_SIZE*xy;
+    if (range < 2*chunk_diagonal/(2*TERRAIN_LOD_MORPH_START - 1)) {
+        range = 2*chunk_diagonal/(2*TERRAIN_LOD_MORPH_START - 1);
+            // Neighbouring chunks only line up if their levels differ by at
+            // most one, and if the coarser chunk has not yet started morphing
+            // where the finer one finishes. Both hold as long as a chunk spans
+            // no more than `2*TERRAIN_LOD_MORPH_START - 1` of the range it
+            // finishes morphing at. We double that margin, since the diagonal
+            // ignores the height of the chunk.
+    }
+    for (uint8_t i = 0; i < TERRAIN_LOD_LEVELS; ++i) {
+        view->lod_ranges[i] = range;
+        range *= 2;
+    }
+
     // Compute the inverse.
     bool invertible = mat4_Invert(
         &view->view_projection, &view->view_projection_inv);
     ASSERT(invertible);
 
+    // The camera is at the origin of camera coordinates. Projecting that point
+    // and then mapping it back through the inverse gives us its position in
+    // world coordinates.
+    vec4 eye = {0, 0, 0, 1};
+    mat4_ApplyInPlace(&view->projection, &eye);
+    mat4_ApplyInPlace(&view->view_projection_inv, &eye);
+    view->camera_position = (vec3){eye.x/eye.w, eye.y/eye.w, eye.z/eye.w};
+
     // Send the MVP matrix to the shaders.
     glUseProgram(view->gl_terrain_shaders);
     {
@@ -498,38 +624,64 @@ static void TerrainView_UpdateMVP(TerrainView *view)
             view->gl_terrain_shader_mvp, 1, GL_TRUE,
             mat4_Buffer(&view->view_projection)
         );
+        glUniform3f(view->gl_terrain_shader_camera, view->camera_position.x,
+            view->camera_position.y, view->camera_position.z);
     }
     glUseProgram(0);
+}
 
-    glUseProgram(view->gl_axis_shaders);
-    {
-        glUniformMatrix4fv(
-            view->gl_axis_shader_mvp, 1, GL_TRUE,
-            mat4_Buffer(&view->view_projection)
-        );
+// Bring the state derived from the camera, the heights and the holes up to
+// date, recomputing only the parts whose inputs have changed since they were
+// last computed.
+static void TerrainView_UpdateDerived(TerrainView *view)
+{
+    uint32_t width, height;
+    View_GetWindowSize((View *)view, &width, &height);
+    if (width != view->mvp_window_width || height != view->mvp_window_height) {
+        view->mvp_window_width = width;
+        view->mvp_window_height = height;
+        ++view->camera_version;
+            // The projection depends on the aspect ratio of the window.
+    }
+
+    if (view->mvp_camera_version != view->camera_version) {
+        TerrainView_UpdateMVP(view);
+        view->mvp_camera_version = view->camera_version;
     }
-    glUseProgram(0);
 
-    glUseProgram(view->gl_lines_shaders);
+    if (view->routes_heights_version != view->heights_version ||
+        view->routes_holes_version != view->holes_version)
     {
-        glUniformMatrix4fv(
-            view->gl_lines_shader_mvp, 1, GL_TRUE,
-            mat4_Buffer(&view->view_projection)
-        );
+        TerrainView_UpdateHoleRoutes(view);
+            // The hole routes depend on the face heights, because we draw them
+            // at the height of the shot-points.
+        view->routes_heights_version = view->heights_version;
+        view->routes_holes_version = view->holes_version;
     }
-    glUseProgram(0);
 
-    TerrainView_UpdateHoleLines(view);
-        // The hole lines depend on the MVP, because they use it to map world
-        // coordinates to screen coordinates in order to position labels.
+    if (view->labels_camera_version != view->camera_version ||
+        view->labels_heights_version != view->heights_version ||
+        view->labels_holes_version != view->holes_version)
+    {
+        TerrainView_UpdateHoleLabels(view);
+            // The hole labels depend on the MVP, because we use it to map the
+            // pins to screen coordinates, and on the routes, which place the
+            // pins.
+        view->labels_camera_version = view->camera_version;
+        view->labels_heights_version = view->heights_version;
+        view->labels_holes_version = view->holes_version;
+    }
 }
 
-static void TerrainView_VertexNormal(
-    const TerrainView *view, uint16_t row, uint16_t col, vec3 *n)
+// Compute the normal of the vertex at (`row`, `col`) in a grid of vertex
+// heights, `width` vertices wide and `height` vertices tall, stored in
+// row-major order.
+static inline void TerrainView_GridNormal(
+    const uint16_t *heights, uint16_t width, uint16_t height,
+    uint16_t row, uint16_t col, vec3 *n)
 {
-    const Terrain *terrain = view->terrain;
-    ASSERT(row < Terrain_VertexHeight(terrain));
-    ASSERT(col < Terrain_VertexWidth(terrain));
+    ASSERT(row < height);
+    ASSERT(col < width);
 
     // The normal of a vertex incident to four faces:
     //
@@ -606,247 +758,685 @@ static void TerrainView_VertexNormal(
     // independently of the opposite vertex, and will make the face rotationally
     // symmetric, as opposed to the current faces which are biased in a
     // direction determined by their one interior edge.
-
-    // Get a reference to each face incident to the current vertex, or NULL if
-    // there is no such face (because the current vertex is up against an edge
-    // of the terrain).
-    bool at_top_edge    = row + 1 == Terrain_VertexHeight(terrain);
-    bool at_bottom_edge = row     == 0;
-    bool at_left_edge   = col     == 0;
-    bool at_right_edge  = col + 1 == Terrain_VertexWidth(terrain);
-    const Face *f1 = at_left_edge || at_top_edge ? NULL :
-                        Terrain_GetConstFace(terrain, row, col - 1);
-    const Face *f2 = at_right_edge || at_top_edge ? NULL :
-                        Terrain_GetConstFace(terrain, row, col);
-    const Face *f3 = at_right_edge || at_bottom_edge ? NULL :
-                        Terrain_GetConstFace(terrain, row - 1, col);
-    const Face *f4 = at_left_edge || at_bottom_edge ? NULL :
-                        Terrain_GetConstFace(terrain, row - 1, col - 1);
-
-    // Get the z-coordinate of the current vertex from one of the faces.
-    ASSERT(f1 || f2 || f3 || f4);
-        // In any non-empty terrain, every vertex touches at least one face.
-    float z = f1 ? f1->vertices[BOTTOM_RIGHT]
-            : f2 ? f2->vertices[BOTTOM_LEFT]
-            : f3 ? f3->vertices[TOP_LEFT]
-            :      f4->vertices[TOP_RIGHT];
+    //
+    // In practice we never compute the cross products. Each edge has XY
+    // direction +-(0, 1) or +-(1, 0), so if zU, zR, zD and zL are the heights
+    // of the neighbors at the ends of E12, E23, E34 and E41, expanding the
+    // four cross products and adding them up gives
+    //
+    //                  N1 + N2 + N3 + N4 = 2 (zL - zR, zD - zU, 2)
+    //
+    // The factor of 2 disappears when we normalize, so all a normal really
+    // costs is a few subtractions and a square root.
 
     // Find the height of the vertex at the endpoint of each of the four edges.
-    // We will need this information to compute the edges themselves. If in any
-    // case there is no such vertex, we will use the height of the current
-    // vertex. This is like surrounding the terrain with a hypothetical extra
-    // row of vertices, which are each the same height as the vertex in the
-    // terrain to which they are perpendicular.
-    const float z12 = f1 ? f1->vertices[TOP_RIGHT]
-                    : f2 ? f2->vertices[TOP_LEFT]
-                    :      z;
-    const float z23 = f2 ? f2->vertices[BOTTOM_RIGHT]
-                    : f3 ? f3->vertices[TOP_RIGHT]
-                    :      z;
-    const float z34 = f3 ? f3->vertices[BOTTOM_LEFT]
-                    : f4 ? f4->vertices[BOTTOM_RIGHT]
-                    :      z;
-    const float z41 = f4 ? f4->vertices[TOP_LEFT]
-                    : f1 ? f1->vertices[BOTTOM_LEFT]
-                    :      z;
-
-    // Compute the edge vectors. Each edge has XY direction +-(0, 1) or +-(1,
-    // 0), and the z-distance for each is obtained by subtracting the height of
-    // the vertex at the end of the edge from the height of the current vertex
-    // (z).
-    const vec3 e12 = { 0,  1, z12 - z };
-    const vec3 e23 = { 1,  0, z23 - z };
-    const vec3 e34 = { 0, -1, z34 - z };
-    const vec3 e41 = {-1,  0, z41 - z };
-
-    // Compute the normal vectors for each face.
-    vec3 n1; vec3_Cross(&e12, &e41, &n1);
-    vec3 n2; vec3_Cross(&e23, &e12, &n2);
-    vec3 n3; vec3_Cross(&e34, &e23, &n3);
-    vec3 n4; vec3_Cross(&e41, &e34, &n4);
-
-    // Add the vectors together to get the (unnormalized) normal.
-    *n = (vec3){ 0, 0, 0 };
-    vec3_AddInPlace(&n1, n);
-    vec3_AddInPlace(&n2, n);
-    vec3_AddInPlace(&n3, n);
-    vec3_AddInPlace(&n4, n);
+    // If in any case there is no such vertex, we will use the height of the
+    // current vertex. This is like surrounding the terrain with a hypothetical
+    // extra row of vertices, which are each the same height as the vertex in
+    // the terrain to which they are perpendicular.
+    const uint16_t *z = &heights[(uint32_t)row*width + col];
+    const float zu = row + 1 < height ? z[width] : *z;
+    const float zr = col + 1 < width  ? z[1]     : *z;
+    const float zd = row > 0          ? z[-width] : *z;
+    const float zl = col > 0          ? z[-1]     : *z;
+
+    *n = (vec3){ zl - zr, zd - zu, 2 };
 
     // Normalize so the normal is a unit vector.
     vec3_NormalizeInPlace(n);
 }
 
-static void TerrainView_UpdateFaceHeights(TerrainView *view)
+static void TerrainView_VertexNormal(
+    const TerrainView *view, uint16_t row, uint16_t col, vec3 *n)
 {
-    vec3 *positions = Malloc(sizeof(vec3)*view->num_vertices);
-    uint32_t i = 0; // Index of current vertex in `positions`.
+    TerrainView_GridNormal(view->heights,
+        Terrain_VertexWidth(view->terrain), Terrain_VertexHeight(view->terrain),
+        row, col, n);
+}
 
-    uint8_t w = view->terrain->xy_resolution;
-    uint8_t h = view->terrain->xy_resolution;
+// A band of rows in a normal computation, see `TerrainView_ComputeNormals`.
+typedef struct {
+    const uint16_t *heights;
+    uint16_t width;
+    uint16_t height;
+    uint16_t min_row;
+    uint16_t min_col;
+    uint16_t max_col;
+    vec3 *normals;
+} NormalBand;
+
+static void TerrainView_ComputeNormalBand(
+    uint32_t begin, uint32_t end, void *arg)
+{
+    const NormalBand *band = (const NormalBand *)arg;
 
-    // Initialize x-y vertex positions, 2 triangles for each face.
-    for (uint16_t row = 0; row < Terrain_FaceHeight(view->terrain); ++row) {
-        for (uint16_t col = 0; col < Terrain_FaceWidth(view->terrain); ++col) {
-            ASSERT(i < view->num_vertices);
+    for (uint32_t row = band->min_row + begin; row < band->min_row + end;
+         ++row)
+    {
+        for (uint16_t col = band->min_col; col <= band->max_col; ++col) {
+            TerrainView_GridNormal(band->heights, band->width, band->height,
+                row, col, &band->normals[row*band->width + col]);
+        }
+    }
+}
+
+#define NORMALS_PER_THREAD 16384
+    // Minimum number of normals worth computing on a separate thread. Edits
+    // from the HUD or the console touch far fewer vertices than this, so they
+    // never pay for starting threads; only large rebuilds are split up.
+
+// Compute the normal of every vertex in the rectangle with corners at
+// (`min_row`, `min_col`) and (`max_row`, `max_col`) inclusive, into `normals`,
+// which is indexed like `heights`. Large rectangles are split into bands of
+// rows which are computed concurrently.
+static void TerrainView_ComputeNormals(
+    const uint16_t *heights, uint16_t width, uint16_t height,
+    uint16_t min_row, uint16_t min_col, uint16_t max_row, uint16_t max_col,
+    vec3 *normals)
+{
+    ASSERT(min_row <= max_row && max_row < height);
+    ASSERT(min_col <= max_col && max_col < width);
 
-            const Face *face = Terrain_GetConstFace(view->terrain, row, col);
-            const uint16_t *z = face->vertices;
-
-
-            // We will draw a square face using two triangles, like this:
-            //
-            //        col   col+1
-            //         |      |
-            // row+1 --+------+--
-            //         | A  / |
-            //         |   /  |
-            //         |  /   |
-            //         | /  B |
-            // row   --+------+--
-            //         |      |
-            //
-
-            // Triangle A
-            positions[i++] = (vec3){ w*col,     h*(row+1), z[TOP_LEFT] };
-            positions[i++] = (vec3){ w*col,     h*row,     z[BOTTOM_LEFT] };
-            positions[i++] = (vec3){ w*(col+1), h*(row+1), z[TOP_RIGHT] };
-
-            // Triangle B
-            positions[i++] = (vec3){ w*(col+1), h*row,     z[BOTTOM_RIGHT] };
-            positions[i++] = (vec3){ w*(col+1), h*(row+1), z[TOP_RIGHT] };
-            positions[i++] = (vec3){ w*col,     h*row,     z[BOTTOM_LEFT] };
+    NormalBand band = {
+        heights, width, height, min_row, min_col, max_col, normals
+    };
+    uint32_t cols = max_col - min_col + 1;
+    Parallel_For(max_row - min_row + 1, 1 + NORMALS_PER_THREAD/cols,
+        TerrainView_ComputeNormalBand, &band);
+}
+
+// Index of the vertex at (`row`, `col`) in the terrain vertex buffers.
+static inline uint32_t TerrainView_VertexIndex(
+    const TerrainView *view, uint16_t row, uint16_t col)
+{
+    return row*Terrain_VertexWidth(view->terrain) + col;
+}
+
+// Divide the terrain into chunks of at most `TERRAIN_CHUNK_SIZE` faces square.
+static void TerrainView_InitChunks(TerrainView *view)
+{
+    const Terrain *terrain = view->terrain;
+    uint16_t chunk_rows =
+        (Terrain_FaceHeight(terrain) + TERRAIN_CHUNK_SIZE - 1)/TERRAIN_CHUNK_SIZE;
+    uint16_t chunk_cols =
+        (Terrain_FaceWidth(terrain) + TERRAIN_CHUNK_SIZE - 1)/TERRAIN_CHUNK_SIZE;
+
+    view->num_chunks = chunk_rows*chunk_cols;
+    view->chunks = Malloc(sizeof(TerrainChunk)*view->num_chunks);
+    view->chunk_counts = Malloc(sizeof(GLsizei)*view->num_chunks);
+    view->chunk_offsets = Malloc(sizeof(GLvoid *)*view->num_chunks);
+
+    for (uint16_t i = 0; i < chunk_rows; ++i) {
+        for (uint16_t j = 0; j < chunk_cols; ++j) {
+            TerrainChunk *chunk = &view->chunks[i*chunk_cols + j];
+            chunk->min_row = i*TERRAIN_CHUNK_SIZE;
+            chunk->min_col = j*TERRAIN_CHUNK_SIZE;
+            chunk->max_row = UintMin(
+                chunk->min_row + TERRAIN_CHUNK_SIZE, Terrain_FaceHeight(terrain)
+            ) - 1;
+            chunk->max_col = UintMin(
+                chunk->min_col + TERRAIN_CHUNK_SIZE, Terrain_FaceWidth(terrain)
+            ) - 1;
+            chunk->min_z = 0;
+            chunk->max_z = 0;
+                // The heights are filled in by `TerrainView_UpdateFaceHeights`.
+            chunk->lod = 0;
         }
     }
 
-    // Copy data into OpenGL's vertex buffer.
-    glBindVertexArray(view->gl_terrain_vao);
-    {
-        // Initialize vertex buffer
-        glBindBuffer(GL_ARRAY_BUFFER, view->gl_terrain_positions);
-        {
-            glBufferData(
-                GL_ARRAY_BUFFER,
-                sizeof(vec3)*view->num_vertices,
-                positions,
-                GL_DYNAMIC_DRAW
-            );
-            glVertexAttribPointer(
-                VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
-            glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION);
+    // Lay out the element buffers level by level, so that neighbouring chunks
+    // drawn at the same level of detail are also adjacent in the buffers.
+    view->num_indices = 0;
+    view->num_edge_indices = 0;
+    for (uint8_t lod = 0; lod < TERRAIN_LOD_LEVELS; ++lod) {
+        uint16_t stride = 1 << lod;
+        for (uint32_t i = 0; i < view->num_chunks; ++i) {
+            TerrainChunk *chunk = &view->chunks[i];
+            uint16_t rows = chunk->max_row - chunk->min_row + 1;
+            uint16_t cols = chunk->max_col - chunk->min_col + 1;
+            uint32_t block_rows = (rows + stride - 1)/stride;
+            uint32_t block_cols = (cols + stride - 1)/stride;
+
+            chunk->first_index[lod] = view->num_indices;
+            chunk->num_indices[lod] = 6*block_rows*block_cols;
+                // Each block of `stride` by `stride` faces (or fewer, along the
+                // edges of the terrain) is drawn as 2 triangles, so 6 indices.
+            view->num_indices += chunk->num_indices[lod];
+
+            chunk->first_edge_index[lod] = view->num_edge_indices;
+            chunk->num_edge_indices[lod] = 2*3*block_rows*block_cols;
+                // Each block owns its bottom edge, left edge and diagonal (see
+                // `TerrainView_BlockEdges`)...
+            if (chunk->max_row + 1 == Terrain_FaceHeight(terrain)) {
+                chunk->num_edge_indices[lod] += 2*block_cols;
+            }
+            if (chunk->max_col + 1 == Terrain_FaceWidth(terrain)) {
+                chunk->num_edge_indices[lod] += 2*block_rows;
+            }
+                // ...except along the top and right edges of the terrain, where
+                // there is no block above or to the right to draw the edges
+                // the blocks share with it.
+            view->num_edge_indices += chunk->num_edge_indices[lod];
         }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
-    glBindVertexArray(0);
-    free(positions);
-        // GL has copied the vertex data into GPU memory, so we can free our
-        // buffer.
-
-    // Initialize vertex normals.
-    vec3 *normals = Malloc(sizeof(vec3)*view->num_vertices);
-    i = 0;
-    for (uint16_t row = 0; row < Terrain_FaceHeight(view->terrain); ++row) {
-        for (uint16_t col = 0; col < Terrain_FaceWidth(view->terrain); ++col) {
-            ASSERT(i < view->num_vertices);
+}
 
-            // Compute normals for each of the 6 vertices corresponding to the
-            // 2 triangles for this face:
-            //
-            //        col   col+1
-            //         |      |
-            // row+1 --+------+--
-            //         | A  / |
-            //         |   /  |
-            //         |  /   |
-            //         | /  B |
-            // row   --+------+--
-            //         |      |
-            //
-
-            // Triangle A
-            TerrainView_VertexNormal(view, row + 1, col,     &normals[i++]);
-            TerrainView_VertexNormal(view, row,     col,     &normals[i++]);
-            TerrainView_VertexNormal(view, row + 1, col + 1, &normals[i++]);
-
-            // Triangle B
-            TerrainView_VertexNormal(view, row,     col + 1, &normals[i++]);
-            TerrainView_VertexNormal(view, row + 1, col + 1, &normals[i++]);
-            TerrainView_VertexNormal(view, row,     col,     &normals[i++]);
+// Write the 6 indices of the two triangles covering the block of faces from
+// (`row`, `col`) up to, but not including, (`top`, `right`) to `indices`. At
+// full detail, the block is a single face.
+static void TerrainView_BlockTriangles(const TerrainView *view,
+    uint16_t row, uint16_t col, uint16_t top, uint16_t right, uint32_t *indices)
+{
+    uint32_t tl = TerrainView_VertexIndex(view, top, col);
+    uint32_t tr = TerrainView_VertexIndex(view, top, right);
+    uint32_t br = TerrainView_VertexIndex(view, row, right);
+    uint32_t bl = TerrainView_VertexIndex(view, row, col);
+
+    // We will draw a square block using two triangles, like this:
+    //
+    //        col   right
+    //         |      |
+    // top   --+------+--
+    //         | A  / |
+    //         |   /  |
+    //         |  /   |
+    //         | /  B |
+    // row   --+------+--
+    //         |      |
+    //
+    // Both triangles end with the bottom left vertex. That is the provoking
+    // vertex, whose value is used for `flat` attributes such as the material,
+    // so the material of the face at (row, col) is stored at vertex (row, col).
+    // The top row and right column of vertices are not the bottom left corner
+    // of any face, so their materials are never used. A coarser block takes on
+    // the material of its bottom left face.
+
+    // Triangle A
+    indices[0] = tr;
+    indices[1] = tl;
+    indices[2] = bl;
+
+    // Triangle B
+    indices[3] = br;
+    indices[4] = tr;
+    indices[5] = bl;
+}
+
+// Write the indices of the edges of the block of faces from (`row`, `col`) up
+// to, but not including, (`top`, `right`) to `indices`, and return the number
+// of indices written. Each edge of the grid is shared by two blocks, so to list
+// it only once, a block owns its bottom and left edges, and its top and right
+// edges only if it is along the top or right edge of the terrain.
+static uint8_t TerrainView_BlockEdges(const TerrainView *view,
+    uint16_t row, uint16_t col, uint16_t top, uint16_t right, uint32_t *indices)
+{
+    uint32_t tl = TerrainView_VertexIndex(view, top, col);
+    uint32_t tr = TerrainView_VertexIndex(view, top, right);
+    uint32_t br = TerrainView_VertexIndex(view, row, right);
+    uint32_t bl = TerrainView_VertexIndex(view, row, col);
+
+    uint8_t i = 0;
+
+    // Bottom, left and diagonal edges, matching the triangles from
+    // `TerrainView_BlockTriangles`.
+    indices[i++] = bl;
+    indices[i++] = br;
+    indices[i++] = bl;
+    indices[i++] = tl;
+    indices[i++] = bl;
+    indices[i++] = tr;
+
+    if (top == Terrain_FaceHeight(view->terrain)) {
+        indices[i++] = tl;
+        indices[i++] = tr;
+    }
+    if (right == Terrain_FaceWidth(view->terrain)) {
+        indices[i++] = br;
+        indices[i++] = tr;
+    }
+
+    return i;
+}
+
+// Fill the element buffer with the indices of the triangles making up each
+// face, and the mesh element buffer with the indices of each edge. The
+// connectivity of the grid never changes, so this only needs to be done once,
+// when the view is created.
+//
+// The faces and edges are ordered by level of detail and then chunk by chunk,
+// so that any chunk can be drawn on its own at any level from a contiguous
+// range of either buffer (see `TerrainView_InitChunks`).
+//
+// At level `k`, a chunk is divided into blocks of `2^k` by `2^k` faces, aligned
+// to multiples of `2^k` in the terrain as a whole. The vertex shader relies on
+// this alignment to morph vertices between levels.
+static void TerrainView_InitFaceIndices(TerrainView *view)
+{
+    uint32_t *indices = Malloc(sizeof(uint32_t)*view->num_indices);
+    uint32_t i = 0; // Index of current element in `indices`.
+    uint32_t *edges = Malloc(sizeof(uint32_t)*view->num_edge_indices);
+    uint32_t e = 0; // Index of current element in `edges`.
+
+    for (uint8_t lod = 0; lod < TERRAIN_LOD_LEVELS; ++lod) {
+        uint16_t stride = 1 << lod;
+        for (uint32_t j = 0; j < view->num_chunks; ++j) {
+            const TerrainChunk *chunk = &view->chunks[j];
+            ASSERT(i == chunk->first_index[lod]);
+            ASSERT(e == chunk->first_edge_index[lod]);
+
+            for (uint16_t row = chunk->min_row; row <= chunk->max_row;
+                 row += stride)
+            {
+                uint16_t top = UintMin(row + stride, chunk->max_row + 1);
+                for (uint16_t col = chunk->min_col; col <= chunk->max_col;
+                     col += stride)
+                {
+                    uint16_t right = UintMin(col + stride, chunk->max_col + 1);
+                    ASSERT(i + 6 <= view->num_indices);
+                    TerrainView_BlockTriangles(
+                        view, row, col, top, right, &indices[i]);
+                    i += 6;
+
+                    e += TerrainView_BlockEdges(
+                        view, row, col, top, right, &edges[e]);
+                }
+            }
         }
     }
+    ASSERT(i == view->num_indices);
+    ASSERT(e == view->num_edge_indices);
 
-    // Copy data into OpenGL's vertex buffer.
     glBindVertexArray(view->gl_terrain_vao);
     {
-        // Initialize vertex buffer
-        glBindBuffer(GL_ARRAY_BUFFER, view->gl_terrain_normals);
-        {
-            glBufferData(
-                GL_ARRAY_BUFFER,
-                sizeof(vec3)*view->num_vertices,
-                normals,
-                GL_DYNAMIC_DRAW
-            );
-            glVertexAttribPointer(
-                VERTEX_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, 0, 0);
-            glEnableVertexAttribArray(VERTEX_ATTRIB_NORMAL);
-        }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, view->gl_terrain_indices);
+        glBufferData(
+            GL_ELEMENT_ARRAY_BUFFER,
+            sizeof(uint32_t)*view->num_indices,
+            indices,
+            GL_STATIC_DRAW
+        );
+            // The element buffer binding is part of the VAO state, so we leave
+            // it bound.
     }
     glBindVertexArray(0);
-    free(normals);
-        // GL has copied the vertex data into GPU memory, so we can free our
-        // buffer.
+    free(indices);
 
-    TerrainView_UpdateHoleLines(view);
-        // The hole lines depend on the face heights, because we draw them at
-        // the height of the shot-points.
+    // The mesh only needs the heights texture and its own element buffer; it
+    // doesn't use the normal or material attributes.
+    glBindVertexArray(view->gl_terrain_mesh_vao);
+    {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, view->gl_terrain_edges);
+        glBufferData(
+            GL_ELEMENT_ARRAY_BUFFER,
+            sizeof(uint32_t)*view->num_edge_indices,
+            edges,
+            GL_STATIC_DRAW
+        );
+    }
+    glBindVertexArray(0);
+    free(edges);
 }
 
-static void TerrainView_UpdateFaceColors(TerrainView *view)
+// Grow the rectangle with corners at (`*min_row`, `*min_col`) and (`*max_row`,
+// `*max_col`) by `margin` vertices on every side, without leaving a grid of
+// `width` by `height` vertices.
+static void TerrainView_ExpandRect(uint16_t width, uint16_t height,
+    uint16_t margin,
+    uint16_t *min_row, uint16_t *min_col, uint16_t *max_row, uint16_t *max_col)
 {
-    vec4 *colors = Malloc(sizeof(vec4)*view->num_vertices);
-    uint32_t i = 0; // Index of current vertex in `colors`.
+    *min_row = *min_row > margin ? *min_row - margin : 0;
+    *min_col = *min_col > margin ? *min_col - margin : 0;
+    *max_row = UintMin(*max_row + margin, height - 1);
+    *max_col = UintMin(*max_col + margin, width - 1);
+}
 
-    for (uint16_t row = 0; row < Terrain_FaceWidth(view->terrain); ++row) {
-        for (uint16_t col = 0; col < Terrain_FaceHeight(view->terrain); ++col) {
-            ASSERT(i < view->num_vertices);
+// The rectangle of vertices whose normals depend on the edited vertices in
+// `rebuild`. The normal of a vertex depends on the heights of its four
+// neighbors, so this extends one vertex past the edit.
+static void TerrainRebuild_NormalRect(const TerrainRebuild *rebuild,
+    uint16_t *min_row, uint16_t *min_col, uint16_t *max_row, uint16_t *max_col)
+{
+    *min_row = rebuild->min_row;
+    *min_col = rebuild->min_col;
+    *max_row = rebuild->max_row;
+    *max_col = rebuild->max_col;
+    TerrainView_ExpandRect(rebuild->width, rebuild->height, 1,
+        min_row, min_col, max_row, max_col);
+}
 
-            const Face *face = Terrain_GetConstFace(view->terrain, row, col);
+// The rectangle of vertices whose occlusion depends on the edited vertices in
+// `rebuild`, which extends `HORIZON_RADIUS` vertices past the edit.
+static void TerrainRebuild_OcclusionRect(const TerrainRebuild *rebuild,
+    uint16_t *min_row, uint16_t *min_col, uint16_t *max_row, uint16_t *max_col)
+{
+    *min_row = rebuild->min_row;
+    *min_col = rebuild->min_col;
+    *max_row = rebuild->max_row;
+    *max_col = rebuild->max_col;
+    TerrainView_ExpandRect(rebuild->width, rebuild->height, HORIZON_RADIUS,
+        min_row, min_col, max_row, max_col);
+}
 
-            // Each face is composed of two triangles, which means it has 6
-            // vertices. So the next 6 points in the vertex buffer correspond to
-            // this face. We will make them all the color of the face.
-            for (uint8_t j = 0; j < 6; ++j) {
-                colors[i++] = face->material->color;
+// Compute the normals and occlusion around an edit into the back buffers. This
+// only touches the data in the `TerrainRebuild`, so it is safe to run on a
+// background thread.
+static void TerrainRebuild_Run(void *arg)
+{
+    TerrainRebuild *rebuild = (TerrainRebuild *)arg;
+    uint16_t min_row, min_col, max_row, max_col;
+
+    TerrainRebuild_NormalRect(rebuild, &min_row, &min_col, &max_row, &max_col);
+    TerrainView_ComputeNormals(rebuild->heights,
+        rebuild->width, rebuild->height,
+        min_row, min_col, max_row, max_col, rebuild->normals);
+
+    TerrainRebuild_OcclusionRect(
+        rebuild, &min_row, &min_col, &max_row, &max_col);
+    Horizon_ComputeOcclusion(rebuild->heights,
+        rebuild->width, rebuild->height, rebuild->xy_resolution,
+        min_row, min_col, max_row, max_col, rebuild->occlusion);
+}
+
+// Copy the rectangle with corners at (`min_row`, `min_col`) and (`max_row`,
+// `max_col`) from the back buffer `src` to the front buffer `dst`, both of
+// which hold elements of `size` bytes indexed like the vertex grid. Then upload
+// the rows containing the rectangle to `buffer`. Rows are contiguous in the
+// buffer, so this is a single upload.
+static void TerrainView_SwapRect(TerrainView *view, GLuint buffer,
+    size_t size, void *dst, const void *src,
+    uint16_t min_row, uint16_t min_col, uint16_t max_row, uint16_t max_col)
+{
+    for (uint16_t row = min_row; row <= max_row; ++row) {
+        size_t offset = size*TerrainView_VertexIndex(view, row, min_col);
+        memcpy((char *)dst + offset, (const char *)src + offset,
+            size*(max_col - min_col + 1));
+    }
+
+    uint32_t first = TerrainView_VertexIndex(view, min_row, 0);
+    uint32_t count =
+        (max_row - min_row + 1)*Terrain_VertexWidth(view->terrain);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    {
+        glBufferSubData(GL_ARRAY_BUFFER,
+            size*first, size*count, (const char *)dst + size*first);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Mark the part of the minimap shaded by the vertices in the rectangle with
+// corners at (`min_row`, `min_col`) and (`max_row`, `max_col`) as out of date.
+// That is every face incident to one of the vertices.
+static void TerrainView_InvalidateMinimap(TerrainView *view,
+    uint16_t min_row, uint16_t min_col, uint16_t max_row, uint16_t max_col)
+{
+    float xy = view->terrain->xy_resolution;
+    Minimap_Invalidate(&view->minimap,
+        xy*((float)min_col - 1), xy*((float)min_row - 1),
+        xy*((float)max_col + 1), xy*((float)max_row + 1));
+}
+
+// Swap the results of a finished rebuild into the front buffers and upload
+// them.
+static void TerrainView_FinishRebuild(TerrainView *view)
+{
+    const TerrainRebuild *rebuild = &view->rebuild;
+    uint16_t min_row, min_col, max_row, max_col;
+
+    TerrainRebuild_NormalRect(rebuild, &min_row, &min_col, &max_row, &max_col);
+    TerrainView_SwapRect(view, view->gl_terrain_normals,
+        sizeof(vec3), view->normals, rebuild->normals,
+        min_row, min_col, max_row, max_col);
+
+    TerrainRebuild_OcclusionRect(
+        rebuild, &min_row, &min_col, &max_row, &max_col);
+    TerrainView_SwapRect(view, view->gl_terrain_occlusion,
+        sizeof(uint8_t), view->occlusion, rebuild->occlusion,
+        min_row, min_col, max_row, max_col);
+    TerrainView_InvalidateMinimap(view, min_row, min_col, max_row, max_col);
+        // The occlusion rectangle contains the normal rectangle.
+}
+
+// Start recomputing the normals and occlusion around the vertices which have
+// changed since the last rebuild started. If `wait` is set, we do the work
+// right away, on this thread, and swap in the results before returning.
+// Otherwise it runs on a background thread, and `TerrainView_UpdateRebuild`
+// swaps in the results once it's done.
+static void TerrainView_StartRebuild(TerrainView *view, bool wait)
+{
+    ASSERT(view->rebuild_job == NULL);
+    ASSERT(view->dirty);
+
+    TerrainRebuild *rebuild = &view->rebuild;
+    rebuild->min_row = view->dirty_min_row;
+    rebuild->min_col = view->dirty_min_col;
+    rebuild->max_row = view->dirty_max_row;
+    rebuild->max_col = view->dirty_max_col;
+    view->dirty = false;
+
+    // Take a snapshot of the heights the job will read. The occlusion of a
+    // vertex up to `HORIZON_RADIUS` away from the edit depends on heights up
+    // to `HORIZON_RADIUS` further away still.
+    uint16_t min_row = rebuild->min_row;
+    uint16_t min_col = rebuild->min_col;
+    uint16_t max_row = rebuild->max_row;
+    uint16_t max_col = rebuild->max_col;
+    TerrainView_ExpandRect(rebuild->width, rebuild->height, 2*HORIZON_RADIUS,
+        &min_row, &min_col, &max_row, &max_col);
+    uint32_t first = TerrainView_VertexIndex(view, min_row, 0);
+    uint32_t count = (max_row - min_row + 1)*rebuild->width;
+    memcpy(&rebuild->heights[first], &view->heights[first],
+        sizeof(uint16_t)*count);
+
+    if (wait) {
+        TerrainRebuild_Run(rebuild);
+        TerrainView_FinishRebuild(view);
+    } else {
+        view->rebuild_job = Parallel_Start(TerrainRebuild_Run, rebuild);
+    }
+}
+
+// Swap in the results of the background rebuild if it has finished, and start
+// another if the heights have changed since it started. If `wait` is set,
+// block until the normals and occlusion reflect every edit so far.
+static void TerrainView_UpdateRebuild(TerrainView *view, bool wait)
+{
+    if (view->rebuild_job != NULL) {
+        if (!wait && !Parallel_IsDone(view->rebuild_job)) {
+            return;
+        }
+        Parallel_Join(view->rebuild_job);
+        view->rebuild_job = NULL;
+        TerrainView_FinishRebuild(view);
+    }
+
+    if (view->dirty) {
+        TerrainView_StartRebuild(view, wait);
+    }
+}
+
+// Recompute the height range of every chunk containing a vertex in the
+// rectangle with corners at (`min_row`, `min_col`) and (`max_row`, `max_col`)
+// inclusive, in vertex coordinates.
+static void TerrainView_UpdateChunkBounds(TerrainView *view,
+    uint16_t min_row, uint16_t min_col, uint16_t max_row, uint16_t max_col)
+{
+    uint16_t width = Terrain_VertexWidth(view->terrain);
+
+    for (uint32_t i = 0; i < view->num_chunks; ++i) {
+        TerrainChunk *chunk = &view->chunks[i];
+
+        // A chunk of faces includes the vertices one past its last row and
+        // column of faces.
+        if (max_row < chunk->min_row || chunk->max_row + 1 < min_row ||
+            max_col < chunk->min_col || chunk->max_col + 1 < min_col)
+        {
+            continue;
+        }
+
+        chunk->min_z = UINT16_MAX;
+        chunk->max_z = 0;
+        for (uint16_t row = chunk->min_row; row <= chunk->max_row + 1; ++row) {
+            const uint16_t *z = &view->heights[(uint32_t)row*width];
+            for (uint16_t col = chunk->min_col; col <= chunk->max_col + 1;
+                 ++col)
+            {
+                chunk->min_z = UintMin(chunk->min_z, z[col]);
+                chunk->max_z = UintMax(chunk->max_z, z[col]);
             }
         }
     }
+}
 
-    // Copy data into OpenGL's vertex buffer.
-    glBindVertexArray(view->gl_terrain_vao);
+// Update the heights of the vertices in the rectangle with corners at
+// (`min_row`, `min_col`) and (`max_row`, `max_col`) inclusive, as well as the
+// normals which depend on them. The rectangle is given in vertex coordinates,
+// and it is empty if `min_row > max_row` or `min_col > max_col`.
+//
+// Only the affected part of the CPU copies is recomputed, and only the rows
+// touched by the edit are uploaded to the GPU, so the cost of an edit is
+// proportional to the size of the edit rather than the size of the course.
+//
+// The heights, and everything derived from them cheaply, are updated right
+// away. The normals and occlusion are rebuilt by a background job, and catch
+// up a frame or so later, unless `wait` is set, in which case they are up to
+// date when this returns.
+static void TerrainView_UpdateFaceHeights(TerrainView *view,
+    uint16_t min_row, uint16_t min_col, uint16_t max_row, uint16_t max_col,
+    bool wait)
+{
+    const Terrain *terrain = view->terrain;
+    if (min_row > max_row || min_col > max_col) {
+        return;
+    }
+    ASSERT(max_row < Terrain_VertexHeight(terrain));
+    ASSERT(max_col < Terrain_VertexWidth(terrain));
+    Profiler_Begin(PROFILE_EDITS);
+
+    // Update vertex heights. We only upload the z-coordinate of each vertex;
+    // the vertex shader reconstructs x and y from the index of the vertex in
+    // the grid, which is laid out just like the height texture.
+    for (uint16_t row = min_row; row <= max_row; ++row) {
+        for (uint16_t col = min_col; col <= max_col; ++col) {
+            uint32_t i = TerrainView_VertexIndex(view, row, col);
+            ASSERT(i < view->num_vertices);
+
+            view->heights[i] = Terrain_GetVertexHeight(terrain, row, col);
+        }
+    }
+    TerrainView_UpdateChunkBounds(view, min_row, min_col, max_row, max_col);
+    HeightPyramid_Update(&view->pyramid, min_row, min_col, max_row, max_col);
+
+    // Copy the changed texels into the height texture. The unpack parameters
+    // let GL pick the sub-rectangle straight out of our copy of the grid.
+    glBindTexture(GL_TEXTURE_2D, view->gl_terrain_heights);
     {
-        glBindBuffer(GL_ARRAY_BUFFER, view->gl_terrain_colors);
-        {
-            glBufferData(
-                GL_ARRAY_BUFFER,
-                sizeof(vec4)*view->num_vertices,
-                colors,
-                GL_DYNAMIC_DRAW
-            );
-            glVertexAttribPointer(
-                VERTEX_ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, 0, 0);
-            glEnableVertexAttribArray(VERTEX_ATTRIB_COLOR);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+            // Rows of 16-bit texels are only 4-byte aligned when the vertex
+            // width is even.
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, Terrain_VertexWidth(terrain));
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, min_row);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, min_col);
+        glTexSubImage2D(
+            GL_TEXTURE_2D, 0,
+            min_col, min_row, max_col - min_col + 1, max_row - min_row + 1,
+            GL_RED_INTEGER, GL_UNSIGNED_SHORT, view->heights
+        );
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Recompute the normals and occlusion in the background.
+    if (view->dirty) {
+        view->dirty_min_row = UintMin(view->dirty_min_row, min_row);
+        view->dirty_min_col = UintMin(view->dirty_min_col, min_col);
+        view->dirty_max_row = UintMax(view->dirty_max_row, max_row);
+        view->dirty_max_col = UintMax(view->dirty_max_col, max_col);
+    } else {
+        view->dirty = true;
+        view->dirty_min_row = min_row;
+        view->dirty_min_col = min_col;
+        view->dirty_max_row = max_row;
+        view->dirty_max_col = max_col;
+    }
+    TerrainView_UpdateRebuild(view, wait);
+
+    ++view->heights_version;
+    Profiler_End(PROFILE_EDITS);
+}
+
+// Update the materials of the faces in the rectangle with corners at
+// (`min_row`, `min_col`) and (`max_row`, `max_col`) inclusive. The rectangle is
+// given in face coordinates, and it is empty if `min_row > max_row` or
+// `min_col > max_col`.
+static void TerrainView_UpdateFaceMaterials(TerrainView *view,
+    uint16_t min_row, uint16_t min_col, uint16_t max_row, uint16_t max_col)
+{
+    const Terrain *terrain = view->terrain;
+    if (min_row > max_row || min_col > max_col) {
+        return;
+    }
+    ASSERT(max_row < Terrain_FaceHeight(terrain));
+    ASSERT(max_col < Terrain_FaceWidth(terrain));
+    Profiler_Begin(PROFILE_EDITS);
+
+    for (uint16_t row = min_row; row <= max_row; ++row) {
+        for (uint16_t col = min_col; col <= max_col; ++col) {
+            uint32_t i = TerrainView_VertexIndex(view, row, col);
+            ASSERT(i < view->num_vertices);
+
+            // The material of each face is stored in its bottom left vertex
+            // (see `TerrainView_InitFaceIndices`). We only store the ID; the
+            // fragment shader looks up the color in a palette.
+            const Face *face = Terrain_GetConstFace(terrain, row, col);
+            view->materials[i] = face->material->id;
         }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
-    glBindVertexArray(0);
-    free(colors);
+
+    // Copy the changed rows into OpenGL's vertex buffer.
+    uint32_t first = TerrainView_VertexIndex(view, min_row, 0);
+    uint32_t count = (max_row - min_row + 1)*Terrain_VertexWidth(terrain);
+    glBindBuffer(GL_ARRAY_BUFFER, view->gl_terrain_materials);
+    {
+        glBufferSubData(
+            GL_ARRAY_BUFFER,
+            sizeof(uint8_t)*first,
+            sizeof(uint8_t)*count,
+            &view->materials[first]
+        );
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    TerrainView_InvalidateMinimap(view, min_row, min_col, max_row, max_col);
+    Profiler_End(PROFILE_EDITS);
+}
+
+// Update the heights and normals of every vertex in the terrain.
+static void TerrainView_UpdateAllHeights(TerrainView *view)
+{
+    TerrainView_UpdateFaceHeights(view, 0, 0,
+        Terrain_VertexHeight(view->terrain) - 1,
+        Terrain_VertexWidth(view->terrain) - 1, true);
+}
+
+// Update the material of every face in the terrain.
+static void TerrainView_UpdateAllMaterials(TerrainView *view)
+{
+    TerrainView_UpdateFaceMaterials(view, 0, 0,
+        Terrain_FaceHeight(view->terrain) - 1,
+        Terrain_FaceWidth(view->terrain) - 1);
 }
 
 // Move the camera north and east by the given deltas. `north` and `east` may
 // be negative, to allow moving south and west, respectively.
 static void TerrainView_MoveCamera(TerrainView *view, float north, float east)
 {
+    if (north == 0 && east == 0) {
+        return;
+    }
+
     // We are given deltas in the north and east directions, but we need to
     // modify the camera's x and y coordinates, so we first convert to XY
     // deltas.
@@ -857,8 +1447,47 @@ static void TerrainView_MoveCamera(TerrainView *view, float north, float east)
     view->camera_y += xy.y;
 
     // We've changed the camera position, which is one of the inputs to the MVP
-    // matrix, so we have to update the matrix.
-    TerrainView_UpdateMVP(view);
+    // matrix, so the matrix is out of date.
+    ++view->camera_version;
+}
+
+// Find the point on the terrain under the cursor, and the face containing it.
+// Return false if the cursor is not over the terrain.
+static bool TerrainView_Pick(
+    TerrainView *view, vec3 *p, uint16_t *row, uint16_t *col)
+{
+    TerrainView_UpdateDerived(view);
+        // The camera may have moved since the last frame.
+
+    int32_t x, y;
+    uint32_t width, height;
+    View_GetWindowSize((View *)view, &width, &height);
+    View_GetCursorPos((View *)view, &x, &y);
+
+    float ndc_x = 2*((float)x + 0.5)/width - 1;
+        // We offset `x` by 0.5, because the integer point (x, y) is the
+        // location of the bottom left corner of the pixel, but we really want
+        // the point at the center of the pixel. Then we divide by width to
+        // normalize to [0, 1], and then 2x - 1 stretches that range to [-1, 1].
+    float ndc_y = 2*((float)y + 0.5)/height - 1;
+        // Same normalization as for `x`.
+
+    // The cursor covers a line of points in normalized device coordinates,
+    // from the near clipping plane (z = -1) to the far one (z = 1). Applying
+    // the inverse of the view-projection transformation to its ends gives us
+    // the segment of world space the user could be pointing at.
+    vec4 near = { ndc_x, ndc_y, -1, 1 };
+    vec4 far = { ndc_x, ndc_y, 1, 1 };
+    mat4_ApplyInPlace(&view->view_projection_inv, &near);
+    mat4_ApplyInPlace(&view->view_projection_inv, &far);
+
+    // The matrix transformation above leaves us in homogeneous coordinates. To
+    // get back to Cartesian coordinates, we divide by `w`.
+    vec3 start = { near.x/near.w, near.y/near.w, near.z/near.w };
+    vec3 end = { far.x/far.w, far.y/far.w, far.z/far.w };
+
+    return HeightPyramid_Raycast(&view->pyramid,
+        view->terrain->xy_resolution, &start, &end, p, row, col);
 }
 
 static void TerrainView_HandleClick(
@@ -869,6 +1498,13 @@ static void TerrainView_HandleClick(
 
     TerrainView *view = (TerrainView *)view_base;
 
+    vec3 p = {-1, -1, -1};
+    uint16_t face_row = 0;
+    uint16_t face_col = 0;
+    bool on_terrain = TerrainView_Pick(view, &p, &face_row, &face_col);
+        // If the click hits the terrain, `p` is the point it hits in world
+        // space, and (`face_row`, `face_col`) is the face containing it.
+
     trace("handling %s %s at {%.2f, %.2f, %.2f}\n",
         button == MOUSE_BUTTON_LEFT   ? "left"   :
         button == MOUSE_BUTTON_RIGHT  ? "right"  :
@@ -878,60 +1514,10 @@ static void TerrainView_HandleClick(
         action == MOUSE_DRAG    ? "drag"  :
         action == MOUSE_RELEASE ? "release" :
                                   "unknown",
-        view->mouse_position.x, view->mouse_position.y, view->mouse_position.z
+        p.x, p.y, p.z
     );
 
-    vec4 p;
-        // We will set `p` to the coordinates of the click in world space if the
-        // click hits the terrain, or a sentinel {-1, -1, -1, 1} if not.
-    if (view->mouse_position.z != 1) {
-        // Convert from normalized device coordinates to world coordinates by
-        // applying the inverse of the view-projection transformation.
-        p = (vec4){ view->mouse_position.x
-                  , view->mouse_position.y
-                  , view->mouse_position.z
-                  , 1 };
-        mat4_ApplyInPlace(&view->view_projection_inv, &p);
-
-        // The matrix transformation above leaves us in homogeneous coordinates.
-        // To get back to Cartesian coordinates, we divide by `w`.
-        vec4_ScaleInPlace(1/p.w, &p);
-        trace("{%.2f, %.2f, %.2f} in screen space is "
-              "{%.2f, %.2f, %.2f} in world space\n",
-            view->mouse_position.x,
-            view->mouse_position.y,
-            view->mouse_position.z,
-            p.x, p.y, p.z);
-
-        // If we think we hit the terrain, we better have a point that
-        // corresponds to some face.
-        if (!(0 <= p.x && p.x <
-                Terrain_FaceWidth(view->terrain)*view->terrain->xy_resolution)
-            // X is out of range.
-        ||
-            !(0 <= p.y && p.y <
-                Terrain_FaceHeight(view->terrain)*view->terrain->xy_resolution))
-            // Y is out of range.
-        {
-            // We got a click with a non-1 depth value, but after the inverse
-            // transformation it falls outside the perimeter of the terrain.
-            // This can happen due to small numeric instabilities in the
-            // coordinate transform when the click is actually inside the
-            // terrain, but very near the edge.
-            //
-            // We could try to correct for this by nudging such problem points
-            // back towards the edge of the terrain. However, the simpler
-            // solution is to just drop the click when this happens, and in
-            // practice it seems that these events are usually so close to the
-            // edge of the terrain that the user won't notice anything odd when
-            // they drop.
-            p = (vec4){-1, -1, -1, 1};
-        }
-    } else {
-        p = (vec4){-1, -1, -1, 1};
-    }
-
-    if (p.x < 0 && action != MOUSE_RELEASE) {
+    if (!on_terrain && action != MOUSE_RELEASE) {
         return;
             // Don't initiate any events (MOUSE_PRESS or MOUSE_DRAG) for clicks
             // that missed the terrain. We will keep going if action is
@@ -950,8 +1536,8 @@ static void TerrainView_HandleClick(
             }
 
             // Find the coordinates of the face _containing_ the cursor.
-            uint16_t row = floor(p.y/view->terrain->xy_resolution);
-            uint16_t col = floor(p.x/view->terrain->xy_resolution);
+            uint16_t row = face_row;
+            uint16_t col = face_col;
 
             // Raise one unit on a left click, lower one unit on a right click.
             if (button == MOUSE_BUTTON_LEFT) {
@@ -959,7 +1545,8 @@ static void TerrainView_HandleClick(
             } else if (button == MOUSE_BUTTON_RIGHT) {
                 Terrain_RaiseFace(view->terrain, row, col, -1);
             }
-            TerrainView_UpdateFaceHeights(view);
+            TerrainView_UpdateFaceHeights(
+                view, row, col, row + 1, col + 1, false);
 
             break;
         }
@@ -979,7 +1566,7 @@ static void TerrainView_HandleClick(
             } else if (button == MOUSE_BUTTON_RIGHT) {
                 Terrain_RaiseVertex(view->terrain, row, col, -1);
             }
-            TerrainView_UpdateFaceHeights(view);
+            TerrainView_UpdateFaceHeights(view, row, col, row, col, false);
 
             break;
         }
@@ -990,8 +1577,8 @@ static void TerrainView_HandleClick(
             }
 
             // Find the face _containing_ the cursor.
-            uint16_t row = floor(p.y/view->terrain->xy_resolution);
-            uint16_t col = floor(p.x/view->terrain->xy_resolution);
+            uint16_t row = face_row;
+            uint16_t col = face_col;
 
             if (button == MOUSE_BUTTON_LEFT) {
                 // The material to set is stored in the HUD's data field.
@@ -1001,7 +1588,7 @@ static void TerrainView_HandleClick(
                 // Reset the face to rough.
                 Terrain_GetFace(view->terrain, row, col)->material = &rough;
             }
-            TerrainView_UpdateFaceColors(view);
+            TerrainView_UpdateFaceMaterials(view, row, col, row, col);
 
             break;
         }
@@ -1037,42 +1624,16 @@ static void TerrainView_HandleClick(
                     }
 
                     // Draw a line from view->ruler_start to `p`.
-                    vec3 ruler_end = {p.x, p.y, p.z + 1.0};
+                    view->ruler_end = (vec3){p.x, p.y, p.z + 1.0};
                         // Offset by one vertically so the ruler is
                         // drawn in front of the terrain.
-
-                    glBindVertexArray(view->gl_ruler_vao);
-                    {
-                        glBindBuffer(GL_ARRAY_BUFFER, view->gl_ruler_buffer);
-                        {
-                            vec3 points[] = {view->ruler_start, ruler_end};
-                            glBufferData(
-                                GL_ARRAY_BUFFER,
-                                sizeof(points),
-                                points,
-                                GL_DYNAMIC_DRAW
-                            );
-                            glVertexAttribPointer(
-                                VERTEX_ATTRIB_POSITION,
-                                3,
-                                GL_FLOAT,
-                                GL_FALSE,
-                                0,
-                                0
-                            );
-                            glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION);
-                        }
-                        glBindBuffer(GL_ARRAY_BUFFER, 0);
-                    }
-                    glBindVertexArray(0);
-
                     view->draw_ruler = true;
                         // Ensure that the line actually gets drawn next frame.
 
                     // Update the text field with the new length of the ruler.
                     ASSERT(view->ruler_text != NULL);
                     vec3 ruler;
-                    vec3_Subtract(&ruler_end, &view->ruler_start, &ruler);
+                    vec3_Subtract(&view->ruler_end, &view->ruler_start, &ruler);
                     TextField_Printf(view->ruler_text,
                         "%d     ", (int)round(vec3_Norm(&ruler)));
                             // Print the new length (rounded to the nearest
@@ -1128,39 +1689,22 @@ static void TerrainView_HandleScroll(View *view_base, int32_t x, int32_t y)
     } else if (y < 0) {
         view->camera_zoom *= -CAMERA_ZOOM_RATIO*y;
     }
-    TerrainView_UpdateMVP(view);
+    ++view->camera_version;
 }
 
 static void TerrainView_Animate(TerrainView *view, uint32_t dt)
 {
-#ifndef NDEBUG
-    ////////////////////////////////////////////////////////////////////////////
-    // Update the frame-rate buffer so we can compute a running average.
-    //
-    view->dts[view->dts_next++] = dt;
-    if (view->dts_next >= sizeof(view->dts)/sizeof(view->dts[0])) {
-        view->dts_next = 0;
-    }
-#endif
-
     ////////////////////////////////////////////////////////////////////////////
     // Update the round in progress
     //
+    Profiler_Begin(PROFILE_PHYSICS);
     Round_Step(&view->round, dt);
-    glBindVertexArray(view->gl_ball_vao);
-    {
-        glBindBuffer(GL_ARRAY_BUFFER, view->gl_ball_buffer);
-        {
-            vec3 p;
-            Round_GetBallPosition(&view->round, &p);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(p), &p, GL_DYNAMIC_DRAW);
-            glVertexAttribPointer(
-                VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
-            glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION);
-        }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    Profiler_End(PROFILE_PHYSICS);
+    if (Round_InMotion(&view->round)) {
+        View_KeepAwake((View *)view);
+            // Keep the frame rate up so the ball flies smoothly, even if the
+            // user is sitting back and watching.
     }
-    glBindVertexArray(0);
 
     ////////////////////////////////////////////////////////////////////////////
     // Animate camera movement based on cursor position.
@@ -1188,142 +1732,386 @@ static void TerrainView_Animate(TerrainView *view, uint32_t dt)
         east = delta;
     }
 
-    if (y >= (int32_t)height - 1) {
-        // Top edge.
-        north = delta;
-    } else if (y <= 0) {
-        // (View_GetCursorPos gives you the position relative to the bottom
-        // left, so y == 0 is the top edge and y == height is the bottom edge).
-        north = -delta;
+    if (y >= (int32_t)height - 1) {
+        // Top edge.
+        north = delta;
+    } else if (y <= 0) {
+        // (View_GetCursorPos gives you the position relative to the bottom
+        // left, so y == 0 is the top edge and y == height is the bottom edge).
+        north = -delta;
+    }
+
+    // Compute the coordinates of the camera so we can check if this movement is
+    // taking us outside the viewable terrain area so we can clip it.
+    vec2 camera = TerrainView_XYtoEN((vec2){view->camera_x, view->camera_y});
+
+    // Clip the northerly delta so that the camera doesn't slide so far north or
+    // south that we lose sight of the terrain and get lost.
+    vec2 north_corner = TerrainView_XYtoEN((vec2){
+        Terrain_FaceWidth(view->terrain)*view->terrain->xy_resolution,
+        Terrain_FaceHeight(view->terrain)*view->terrain->xy_resolution
+    });
+    if (camera.y + north > north_corner.y) {
+        // The north delta would take us north of the northernmost corner of the
+        // terrain, so set it to take us exactly there instead.
+        north = north_corner.y - camera.y;
+    } else if (camera.y + north < 0) {
+        // The north delta would take us south of the southernmost corner of the
+        // terrain, so set it to take us exactly there instead.
+        north = -camera.y;
+    }
+
+    // Clip the easterly delta in the same way.
+    vec2 east_corner = TerrainView_XYtoEN((vec2){
+        Terrain_FaceWidth(view->terrain)*view->terrain->xy_resolution, 0});
+    vec2 west_corner = TerrainView_XYtoEN((vec2){
+        0, Terrain_FaceHeight(view->terrain)*view->terrain->xy_resolution});
+    if (camera.x + east > east_corner.x) {
+        east = east_corner.x - camera.x;
+    } else if (camera.x + east < west_corner.x) {
+        east = west_corner.x - camera.x;
+    }
+
+    if (north != 0 || east != 0) {
+        View_KeepAwake((View *)view);
+            // The cursor resting on the edge of the window pans the camera
+            // without generating any input events.
+    }
+
+    TerrainView_MoveCamera(view, north, east);
+}
+
+// Choose the level of detail at which to draw each chunk this frame, based on
+// its distance from the camera, and cull the chunks which lie outside the view
+// frustum.
+static void TerrainView_SelectChunks(TerrainView *view)
+{
+    float xy = view->terrain->xy_resolution;
+    const vec3 *eye = &view->camera_position;
+
+    for (uint32_t i = 0; i < view->num_chunks; ++i) {
+        TerrainChunk *chunk = &view->chunks[i];
+        vec3 min = { xy*chunk->min_col, xy*chunk->min_row, chunk->min_z };
+        vec3 max = {
+            xy*(chunk->max_col + 1), xy*(chunk->max_row + 1), chunk->max_z
+        };
+        if (!Frustum_IntersectsBox(&view->frustum, &min, &max)) {
+            chunk->lod = TERRAIN_LOD_LEVELS;
+            continue;
+        }
+
+        vec3 offset = {
+            fmaxf(fmaxf(min.x - eye->x, eye->x - max.x), 0),
+            fmaxf(fmaxf(min.y - eye->y, eye->y - max.y), 0),
+            fmaxf(fmaxf(min.z - eye->z, eye->z - max.z), 0),
+        };
+        float distance = vec3_Norm(&offset);
+            // Distance from the camera to the nearest point of the chunk. This
+            // is a lower bound on the distance the vertex shader computes for
+            // any vertex in the chunk, so no vertex is ever closer than the
+            // range of the level it is drawn at.
+
+        chunk->lod = 0;
+        while (chunk->lod + 1 < TERRAIN_LOD_LEVELS &&
+               distance >= view->lod_ranges[chunk->lod])
+        {
+            ++chunk->lod;
+        }
+    }
+}
+
+// Draw the chunks selected by `TerrainView_SelectChunks`, with one draw call
+// per level of detail. If `mode` is `GL_TRIANGLES`, we draw the faces, and the
+// terrain VAO must be bound. If it is `GL_LINES`, we draw the edges of the
+// mesh, and the mesh VAO must be bound. Either way, the terrain shaders must be
+// bound. If `morph` is not set, vertices are drawn on their own grid, however
+// far they are from the camera.
+static uint32_t TerrainView_DrawChunks(
+    TerrainView *view, GLenum mode, bool morph)
+{
+    ASSERT(mode == GL_TRIANGLES || mode == GL_LINES);
+    bool mesh = mode == GL_LINES;
+
+    uint32_t draw_calls = 0;
+    for (uint8_t lod = 0; lod < TERRAIN_LOD_LEVELS; ++lod) {
+        GLsizei num_draws = 0;
+        for (uint32_t i = 0; i < view->num_chunks; ++i) {
+            const TerrainChunk *chunk = &view->chunks[i];
+            if (chunk->lod != lod) {
+                continue;
+            }
+
+            // Merge this chunk into the previous draw if they are adjacent in
+            // the element buffer, which is common for runs of chunks in the
+            // same row.
+            uint32_t first = mesh ? chunk->first_edge_index[lod]
+                                  : chunk->first_index[lod];
+            uint32_t count = mesh ? chunk->num_edge_indices[lod]
+                                  : chunk->num_indices[lod];
+            const GLvoid *offset = (const GLvoid *)(sizeof(uint32_t)*first);
+            if (num_draws > 0 &&
+                (const char *)view->chunk_offsets[num_draws - 1] +
+                    sizeof(uint32_t)*view->chunk_counts[num_draws - 1] ==
+                (const char *)offset)
+            {
+                view->chunk_counts[num_draws - 1] += count;
+            } else {
+                view->chunk_counts[num_draws] = count;
+                view->chunk_offsets[num_draws] = offset;
+                ++num_draws;
+            }
+        }
+        if (num_draws == 0) {
+            continue;
+        }
+
+        glUniform1i(view->gl_terrain_shader_stride, 1 << lod);
+        if (morph && lod + 1 < TERRAIN_LOD_LEVELS) {
+            glUniform2f(view->gl_terrain_shader_morph,
+                TERRAIN_LOD_MORPH_START*view->lod_ranges[lod],
+                view->lod_ranges[lod]);
+                // By the end of its range, every vertex at this level has
+                // morphed onto the next level, so it lines up exactly with any
+                // neighbouring chunk drawn at that level.
+        } else {
+            glUniform2f(view->gl_terrain_shader_morph, FLT_MAX/2, FLT_MAX);
+                // There is no coarser level to morph towards, or we aren't
+                // morphing.
+        }
+        glMultiDrawElements(mode, view->chunk_counts, GL_UNSIGNED_INT,
+            view->chunk_offsets, num_draws);
+        ++draw_calls;
+    }
+
+    return draw_calls;
+}
+
+// Draw function for the terrain surface (`GL_TRIANGLES`) and mesh (`GL_LINES`).
+static uint32_t TerrainView_DrawTerrain(const RenderItem *item)
+{
+    TerrainView *view = item->object;
+    glUniform1ui(view->gl_terrain_shader_mesh, item->mode == GL_LINES);
+    glUniform1i(view->gl_terrain_shader_heights, 0);
+    return TerrainView_DrawChunks(view, item->mode, true);
+}
+
+// Draw the faces of the terrain within a rectangle of the world into the
+// minimap (see `Minimap_Update`).
+static void TerrainView_DrawMinimap(void *object, const mat4 *transform,
+    float min_x, float min_y, float max_x, float max_y)
+{
+    TerrainView *view = object;
+    float xy = view->terrain->xy_resolution;
+
+    // Draw the chunks overlapping the rectangle at the level of detail which
+    // best matches the resolution of the minimap. This runs before
+    // `TerrainView_SelectChunks`, which chooses the levels for the scene.
+    for (uint32_t i = 0; i < view->num_chunks; ++i) {
+        TerrainChunk *chunk = &view->chunks[i];
+        bool overlaps = xy*chunk->min_col < max_x &&
+                        xy*(chunk->max_col + 1) > min_x &&
+                        xy*chunk->min_row < max_y &&
+                        xy*(chunk->max_row + 1) > min_y;
+        chunk->lod = overlaps ? view->minimap_lod : TERRAIN_LOD_LEVELS;
+    }
+
+    mat4 mvp;
+    mat4_Copy(&mvp, transform);
+
+    glUseProgram(view->gl_terrain_shaders);
+    glBindTexture(GL_TEXTURE_2D, view->gl_terrain_heights);
+    glBindVertexArray(view->gl_terrain_vao);
+    {
+        glUniformMatrix4fv(
+            view->gl_terrain_shader_mvp, 1, GL_TRUE, mat4_Buffer(&mvp));
+        glUniform1ui(view->gl_terrain_shader_mesh, 0);
+        glUniform1i(view->gl_terrain_shader_heights, 0);
+        TerrainView_DrawChunks(view, GL_TRIANGLES, false);
+
+        glUniformMatrix4fv(view->gl_terrain_shader_mvp, 1, GL_TRUE,
+            mat4_Buffer(&view->view_projection));
+            // The scene's MVP is only uploaded when the camera moves, so put it
+            // back.
+    }
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+}
+
+// Find the corners of the part of the terrain visible to the camera, projected
+// onto the XY plane. We intersect the rays through the corners of the window
+// with a level plane at the height of the terrain the camera is looking at,
+// which is a good enough approximation for an overview.
+static void TerrainView_GetFootprint(const TerrainView *view, vec2 corners[4])
+{
+    const Terrain *terrain = view->terrain;
+    float xy = terrain->xy_resolution;
+    float ground = Terrain_SampleHeight(terrain,
+        FloatClamp(view->camera_x, 0, xy*Terrain_FaceWidth(terrain) - xy/2),
+        FloatClamp(view->camera_y, 0, xy*Terrain_FaceHeight(terrain) - xy/2));
+
+    static const float ndc[4][2] = { {-1, -1}, {1, -1}, {1, 1}, {-1, 1} };
+    for (uint8_t i = 0; i < 4; ++i) {
+        vec4 near = { ndc[i][0], ndc[i][1], -1, 1 };
+        vec4 far = { ndc[i][0], ndc[i][1], 1, 1 };
+        mat4_ApplyInPlace(&view->view_projection_inv, &near);
+        mat4_ApplyInPlace(&view->view_projection_inv, &far);
+        vec4_ScaleInPlace(1/near.w, &near);
+        vec4_ScaleInPlace(1/far.w, &far);
+
+        float t = 1;
+        if (near.z != far.z) {
+            t = FloatClamp((near.z - ground)/(near.z - far.z), 0, 1);
+                // If the ray doesn't reach the ground before the far plane,
+                // stop at the far plane.
+        }
+        corners[i] = (vec2){
+            near.x + t*(far.x - near.x), near.y + t*(far.y - near.y)
+        };
+    }
+}
+
+// Print a table summarizing every profiler zone, one line per zone.
+static void TerrainView_PrintProfile(TextField *text)
+{
+    TextField_Printf(text, "%-14s %6s %6s %6s\n", "zone (ms)",
+        "avg", "p95", "max");
+    for (uint8_t zone = 0; zone < PROFILE_ZONES; ++zone) {
+        ProfileSummary summary;
+        Profiler_GetSummary(zone, &summary);
+        TextField_Printf(text, "%*s%-*s %6.2f %6.2f %6.2f\n",
+            2*summary.depth, "", 14 - 2*summary.depth, summary.name,
+            summary.avg_ms, summary.p95_ms, summary.max_ms);
     }
+}
 
-    // Compute the coordinates of the camera so we can check if this movement is
-    // taking us outside the viewable terrain area so we can clip it.
-    vec2 camera = TerrainView_XYtoEN((vec2){view->camera_x, view->camera_y});
+static void TerrainView_OpenPerfText(TerrainView *view)
+{
+    if (view->perf_text != NULL) {
+        return;
+    }
 
-    // Clip the northerly delta so that the camera doesn't slide so far north or
-    // south that we lose sight of the terrain and get lost.
-    vec2 north_corner = TerrainView_XYtoEN((vec2){
-        Terrain_FaceWidth(view->terrain)*view->terrain->xy_resolution,
-        Terrain_FaceHeight(view->terrain)*view->terrain->xy_resolution
-    });
-    if (camera.y + north > north_corner.y) {
-        // The north delta would take us north of the northernmost corner of the
-        // terrain, so set it to take us exactly there instead.
-        north = north_corner.y - camera.y;
-    } else if (camera.y + north < 0) {
-        // The north delta would take us south of the southernmost corner of the
-        // terrain, so set it to take us exactly there instead.
-        north = -camera.y;
+    view->perf_text = TextField_New(
+        sizeof(TextField), View_GetManager((View *)view),
+        (View *)view,                       // parent
+        0, 0,                               // placed when refreshed
+        PERF_OVERLAY_COLUMNS, PERF_OVERLAY_ROWS,
+        15                                  // font size
+    );
+    view->perf_text_time = 0;
+        // Fill it in on the next frame.
+}
+
+static void TerrainView_ClosePerfText(TerrainView *view)
+{
+    if (view->perf_text != NULL) {
+        View_Close((View *)view->perf_text);
+        view->perf_text = NULL;
     }
+}
 
-    // Clip the easterly delta in the same way.
-    vec2 east_corner = TerrainView_XYtoEN((vec2){
-        Terrain_FaceWidth(view->terrain)*view->terrain->xy_resolution, 0});
-    vec2 west_corner = TerrainView_XYtoEN((vec2){
-        0, Terrain_FaceHeight(view->terrain)*view->terrain->xy_resolution});
-    if (camera.x + east > east_corner.x) {
-        east = east_corner.x - camera.x;
-    } else if (camera.x + east < west_corner.x) {
-        east = west_corner.x - camera.x;
+// Refresh the profiler overlay, if it's due.
+static void TerrainView_UpdatePerfText(TerrainView *view)
+{
+    uint64_t now = Clock_GetTimeMS();
+    if (now - view->perf_text_time < PERF_OVERLAY_PERIOD_MS) {
+        return;
     }
+    view->perf_text_time = now;
 
-    TerrainView_MoveCamera(view, north, east);
+    // Keep the overlay in the bottom right corner, in case the window has
+    // been resized.
+    TextField *text = view->perf_text;
+    uint32_t width, height;
+    View_GetWindowSize((View *)view, &width, &height);
+    uint16_t text_width =
+        text->width*(uint8_t)(TEXT_BATCH_FONT_ASPECT*text->font_size);
+    uint16_t text_height = text->height*text->font_size;
+    TextField_SetLocation(text,
+        IntMax((int32_t)width - text_width - PERF_OVERLAY_MARGIN, 0),
+        text_height + PERF_OVERLAY_MARGIN);
+
+    TerrainView_PrintProfile(text);
+        // The table fills all but the last row, so printing it scrolls the
+        // previous one out of the field.
 }
 
 static void TerrainView_Render(View *view_base, uint32_t dt)
 {
     TerrainView *view = (TerrainView *)view_base;
 
+    Profiler_Begin(PROFILE_UPLOADS);
+    TerrainView_UpdateRebuild(view, false);
+        // Pick up the normals and occlusion from the last edit, if they're
+        // ready.
+    Profiler_End(PROFILE_UPLOADS);
+    Profiler_Begin(PROFILE_ANIMATE);
     TerrainView_Animate(view, dt);
+    Profiler_End(PROFILE_ANIMATE);
+    TerrainView_UpdateDerived(view);
+    if (view->show_minimap) {
+        Profiler_Begin(PROFILE_GPU_MINIMAP);
+        Minimap_Update(&view->minimap, TerrainView_DrawMinimap, view);
+        Profiler_End(PROFILE_GPU_MINIMAP);
+    }
+    if (view->perf_text != NULL) {
+        TerrainView_UpdatePerfText(view);
+    }
+    TerrainView_SelectChunks(view);
+
+    RenderQueue *queue = View_GetRenderQueue(view_base);
 
     if (view->show_terrain) {
         // Draw terrain
-        glUseProgram(view->gl_terrain_shaders);
-        glUniform1ui(view->gl_terrain_shader_mesh, 0);
-
-        glBindVertexArray(view->gl_terrain_vao);
-        {
-            glDrawArrays(GL_TRIANGLES, 0, view->num_vertices);
-        }
-        glBindVertexArray(0);
+        RenderItem *item = RenderQueue_Add(queue, RENDER_LAYER_SCENE);
+        item->program = view->gl_terrain_shaders;
+        item->texture = view->gl_terrain_heights;
+        item->vao = view->gl_terrain_vao;
+        item->draw = TerrainView_DrawTerrain;
+        item->object = view;
+        item->mode = GL_TRIANGLES;
     }
 
-    // Cache the position of the mouse, including the z-coordinate from the
-    // depth buffer. We have to do this immediately after drawing the terrain,
-    // while the depth buffer values are guaranteed to correspond to the terrain
-    // and not some other model.
-    int32_t x, y;
-    uint32_t width, height;
-    GLfloat z;
-    View_GetWindowSize((View *)view, &width, &height);
-    View_GetCursorPos((View *)view, &x, &y);
-    glReadPixels(x, y, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &z);
-    view->mouse_position = (vec3){
-        2*((float)x + 0.5)/width - 1,
-            // We offset `x` by 0.5, because the integer point (x, y) is the
-            // location of the bottom left corner of the pixel, but we really
-            // want the point at the center of the pixel. Then we divide by
-            // width to normalize to [0, 1], and then 2x + 1 stretches that
-            // range to [-1, 1].
-        2*((float)y + 0.5)/height - 1,
-            // Same normalization as for `x`.
-        2*z - 1
-            // `z` is already normalized to [0, 1], so we don't have to adjust
-            // for the size of the window or anything. We just take 2z - 1 to
-            // scale this range to [-1, 1].
-    };
-
     if (view->show_terrain_mesh) {
-        // Draw terrain mesh
-        glUseProgram(view->gl_terrain_shaders);
-        glUniform1ui(view->gl_terrain_shader_mesh, 1);
-        glBindVertexArray(view->gl_terrain_vao);
-        {
-            glDrawArrays(GL_LINES, 0, view->num_vertices);
-        }
-        glBindVertexArray(0);
-    }
-
-    if (view->show_holes) {
-        glUseProgram(view->gl_lines_shaders);
-        for (uint8_t i = 0; i < 18; ++i) {
-            const Hole *hole = Terrain_GetConstHole(view->terrain, i);
-            if (hole == NULL) {
-                continue;
-            }
-
-            glBindVertexArray(view->gl_holes_vao[i]);
-            {
-                glDrawArrays(GL_LINE_STRIP, 0, hole->par - 1);
-            }
-            glBindVertexArray(0);
-        }
+        // Draw terrain mesh. This goes on top of the terrain, which needs to
+        // be in the depth buffer first.
+        RenderItem *item = RenderQueue_Add(queue, RENDER_LAYER_SCENE_DETAIL);
+        item->program = view->gl_terrain_shaders;
+        item->texture = view->gl_terrain_heights;
+        item->vao = view->gl_terrain_mesh_vao;
+        item->draw = TerrainView_DrawTerrain;
+        item->object = view;
+        item->mode = GL_LINES;
+    }
+
+    // Draw lines and points.
+    LineBatch *lines = &view->lines;
+    if (view->show_holes && view->num_hole_route_lines > 0) {
+        LineVertex *routes =
+            LineBatch_AddLines(lines, view->num_hole_route_lines);
+        memcpy(routes, view->hole_routes,
+            2*view->num_hole_route_lines*sizeof(LineVertex));
     }
-
     if (view->draw_ruler) {
-        // Draw ruler
-        glUseProgram(view->gl_lines_shaders);
-        glBindVertexArray(view->gl_ruler_vao);
-        {
-            glDrawArrays(GL_LINES, 0, 2);
-        }
-        glBindVertexArray(0);
-    }
-
-    glUseProgram(view->gl_lines_shaders);
-    glBindVertexArray(view->gl_ball_vao);
-    {
-        glDrawArrays(GL_POINTS, 0, 1);
+        LineBatch_AddLine(
+            lines, &view->ruler_start, &view->ruler_end, &RGBA_WHITE);
     }
-    glBindVertexArray(0);
-
     if (view->show_axes) {
-        // Draw axes
-        glUseProgram(view->gl_axis_shaders);
-        Axis_Render(&view->x_axis);
-        Axis_Render(&view->y_axis);
-        Axis_Render(&view->z_axis);
+        memcpy(LineBatch_AddLines(lines, 3), view->axes, sizeof(view->axes));
+    }
+    vec3 ball;
+    Round_GetBallPosition(&view->round, &ball);
+    LineBatch_AddPoint(lines, &ball, &RGBA_WHITE);
+    LineBatch_Submit(lines, queue,
+        View_GetStreamBuffer(view_base), &view->view_projection);
+
+    if (view->show_minimap) {
+        uint32_t width, height;
+        View_GetWindowSize(view_base, &width, &height);
+        vec2 footprint[4];
+        TerrainView_GetFootprint(view, footprint);
+        Minimap_Submit(&view->minimap, queue, width, height,
+            footprint, &(vec2){ ball.x, ball.y });
     }
 }
 
@@ -1331,6 +2119,25 @@ static void TerrainView_Destroy(View *view_base)
 {
     TerrainView *view = (TerrainView *)view_base;
 
+    if (view->rebuild_job != NULL) {
+        Parallel_Join(view->rebuild_job);
+    }
+    free(view->rebuild.heights);
+    free(view->rebuild.normals);
+    free(view->rebuild.occlusion);
+    free(view->heights);
+    HeightPyramid_Destroy(&view->pyramid);
+    free(view->normals);
+    free(view->occlusion);
+    free(view->materials);
+    free(view->chunks);
+    free(view->chunk_counts);
+    free(view->chunk_offsets);
+
+    GL_ReleaseShaders(view->gl_terrain_shaders);
+    LineBatch_Destroy(&view->lines);
+    Minimap_Destroy(&view->minimap);
+
     // Close detached labels (which aren't children, and hence won't be
     // automatically closed).
     for (uint8_t i = 0; i < 18; ++i) {
@@ -1355,13 +2162,27 @@ TerrainView *TerrainView_New(ViewManager *manager, Terrain *terrain)
     view->show_terrain_mesh = false;
     view->show_axes = false;
     view->show_holes = false;
+    view->show_minimap = false;
     view->camera_x = 0;
     view->camera_y = 0;
     view->camera_zoom = 300;
-    view->mouse_position = (vec3){ 0, 0, 1 };
+    view->camera_version = 1;
+    view->heights_version = 1;
+    view->holes_version = 1;
+    view->mvp_camera_version = 0;
+    view->mvp_window_width = 0;
+    view->mvp_window_height = 0;
+    view->routes_heights_version = 0;
+    view->routes_holes_version = 0;
+    view->labels_camera_version = 0;
+    view->labels_heights_version = 0;
+    view->labels_holes_version = 0;
+        // Everything derived starts out of date.
     view->hud.selection = HUD_NONE;
     view->ruler_start = (vec3){0, 0, 0};
     view->ruler_text = NULL;
+    view->perf_text = NULL;
+    view->perf_text_time = 0;
     view->draw_ruler = false;
 
     for (uint8_t i = 0; i < 18; ++i) {
@@ -1373,40 +2194,145 @@ TerrainView *TerrainView_New(ViewManager *manager, Terrain *terrain)
         TextField_Flush(view->hole_labels[i]);
     }
 
-#ifndef NDEBUG
-    memset(view->dts, 0, sizeof(view->dts));
-    view->dts_next = 0;
-#endif
-
     ////////////////////////////////////////////////////////////////////////////
     // Initialize terrain data
     //
 
     // Create vertex data
-    view->num_vertices = 6*Terrain_NumFaces(terrain);
-        // Each square face consists of 2 triangles, so 6 vertices.
+    view->num_vertices = Terrain_NumVertices(terrain);
     glGenVertexArrays(1, &view->gl_terrain_vao);
-    glGenBuffers(1, &view->gl_terrain_positions);
+    glGenBuffers(1, &view->gl_terrain_indices);
+    glGenVertexArrays(1, &view->gl_terrain_mesh_vao);
+    glGenBuffers(1, &view->gl_terrain_edges);
+    TerrainView_InitChunks(view);
+    TerrainView_InitFaceIndices(view);
+    glGenTextures(1, &view->gl_terrain_heights);
+    glBindTexture(GL_TEXTURE_2D, view->gl_terrain_heights);
+    {
+        glTexImage2D(
+            GL_TEXTURE_2D, 0, GL_R16UI,
+            Terrain_VertexWidth(terrain), Terrain_VertexHeight(terrain),
+            0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, NULL
+        );
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            // Integer textures can't be filtered, and we only ever fetch exact
+            // texels anyways.
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
     glGenBuffers(1, &view->gl_terrain_normals);
-    TerrainView_UpdateFaceHeights(view);
+    glGenBuffers(1, &view->gl_terrain_occlusion);
+    glBindVertexArray(view->gl_terrain_vao);
+    {
+        // Allocate the normal buffer. The contents are filled in below.
+        glBindBuffer(GL_ARRAY_BUFFER, view->gl_terrain_normals);
+        {
+            glBufferData(
+                GL_ARRAY_BUFFER,
+                sizeof(vec3)*view->num_vertices,
+                NULL,
+                GL_DYNAMIC_DRAW
+            );
+            glVertexAttribPointer(
+                VERTEX_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, 0, 0);
+            glEnableVertexAttribArray(VERTEX_ATTRIB_NORMAL);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // Likewise the ambient occlusion buffer.
+        glBindBuffer(GL_ARRAY_BUFFER, view->gl_terrain_occlusion);
+        {
+            glBufferData(
+                GL_ARRAY_BUFFER,
+                sizeof(uint8_t)*view->num_vertices,
+                NULL,
+                GL_DYNAMIC_DRAW
+            );
+            glVertexAttribPointer(
+                VERTEX_ATTRIB_OCCLUSION, 1, GL_UNSIGNED_BYTE, GL_TRUE, 0, 0);
+                // Normalize, so the shader sees the visible fraction of the
+                // sky from 0 to 1.
+            glEnableVertexAttribArray(VERTEX_ATTRIB_OCCLUSION);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glBindVertexArray(0);
+    view->heights = Malloc(sizeof(uint16_t)*view->num_vertices);
+    view->normals = Malloc(sizeof(vec3)*view->num_vertices);
+    view->occlusion = Malloc(sizeof(uint8_t)*view->num_vertices);
+    view->rebuild.heights = Malloc(sizeof(uint16_t)*view->num_vertices);
+    view->rebuild.normals = Malloc(sizeof(vec3)*view->num_vertices);
+    view->rebuild.occlusion = Malloc(sizeof(uint8_t)*view->num_vertices);
+    view->rebuild.width = Terrain_VertexWidth(terrain);
+    view->rebuild.height = Terrain_VertexHeight(terrain);
+    view->rebuild.xy_resolution = terrain->xy_resolution;
+    view->rebuild_job = NULL;
+    view->dirty = false;
+
+    // The minimap is invalidated as the normals and materials are uploaded, so
+    // it needs to exist first.
+    Minimap_Init(&view->minimap,
+        Terrain_FaceWidth(terrain)*terrain->xy_resolution,
+        Terrain_FaceHeight(terrain)*terrain->xy_resolution);
+    view->minimap_lod = 0;
+    while (view->minimap_lod + 1 < TERRAIN_LOD_LEVELS &&
+           (2u << view->minimap_lod)*view->minimap.texture_width <=
+               Terrain_FaceWidth(terrain))
+    {
+        ++view->minimap_lod;
+    }
+        // Go up a level as long as its faces are still no larger than a
+        // texel.
 
-    // Initialize color data
-    glGenBuffers(1, &view->gl_terrain_colors);
-    TerrainView_UpdateFaceColors(view);
+    HeightPyramid_Init(&view->pyramid, view->heights,
+        Terrain_FaceWidth(terrain), Terrain_FaceHeight(terrain));
+    TerrainView_UpdateAllHeights(view);
 
-    // Initialize lines
-    glGenVertexArrays(1, &view->gl_ruler_vao);
-    glGenBuffers(1, &view->gl_ruler_buffer);
-    glGenVertexArrays(18, view->gl_holes_vao);
-    glGenBuffers(18, view->gl_holes_buffers);
+    // Initialize material data
+    glGenBuffers(1, &view->gl_terrain_materials);
+    glBindVertexArray(view->gl_terrain_vao);
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, view->gl_terrain_materials);
+        {
+            glBufferData(
+                GL_ARRAY_BUFFER,
+                sizeof(uint8_t)*view->num_vertices,
+                NULL,
+                GL_DYNAMIC_DRAW
+            );
+            glVertexAttribIPointer(
+                VERTEX_ATTRIB_MATERIAL, 1, GL_UNSIGNED_BYTE, 0, 0);
+                // Use the integer version of the attribute pointer, so the
+                // shader sees the material ID itself rather than a float.
+            glEnableVertexAttribArray(VERTEX_ATTRIB_MATERIAL);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glBindVertexArray(0);
+    view->materials = Malloc(sizeof(uint8_t)*view->num_vertices);
+    memset(view->materials, 0, sizeof(uint8_t)*view->num_vertices);
+        // The top row and right column of vertices don't start a face, so
+        // their materials are never used, but we zero them so we never upload
+        // uninitialized memory.
+    TerrainView_UpdateAllMaterials(view);
 
     ////////////////////////////////////////////////////////////////////////////
-    // Initialize axis data
+    // Initialize lines and axis data
     //
 
-    Axis_Init(&view->x_axis, &x3, &RGB_RED);
-    Axis_Init(&view->y_axis, &y3, &RGB_GREEN);
-    Axis_Init(&view->z_axis, &z3, &RGB_BLUE);
+    LineBatch_Init(&view->lines);
+
+    const vec3 *axis_directions[3] = { &x3, &y3, &z3 };
+    const vec3 *axis_colors[3] = { &RGB_RED, &RGB_GREEN, &RGB_BLUE };
+    for (uint8_t i = 0; i < 3; ++i) {
+        vec3 end;
+        vec3_Scale(1000, axis_directions[i], &end);
+        const vec3 *rgb = axis_colors[i];
+        vec4 color = { rgb->x, rgb->y, rgb->z, 1 };
+        LineVertex_Init(&view->axes[2*i], &zero3, &color, true);
+        LineVertex_Init(&view->axes[2*i + 1], &end, &color, true);
+    }
 
     ////////////////////////////////////////////////////////////////////////////
     // Load shader programs
@@ -1419,6 +2345,14 @@ TerrainView *TerrainView_New(ViewManager *manager, Terrain *terrain)
         view->gl_terrain_shaders, "mvp");
     view->gl_terrain_shader_mesh = glGetUniformLocation(
         view->gl_terrain_shaders, "mesh");
+    view->gl_terrain_shader_heights = glGetUniformLocation(
+        view->gl_terrain_shaders, "heights");
+    view->gl_terrain_shader_camera = glGetUniformLocation(
+        view->gl_terrain_shaders, "camera_position");
+    view->gl_terrain_shader_stride = glGetUniformLocation(
+        view->gl_terrain_shaders, "lod_stride");
+    view->gl_terrain_shader_morph = glGetUniformLocation(
+        view->gl_terrain_shaders, "morph_range");
 
     // The light values are global constants that never change.
     glUseProgram(view->gl_terrain_shaders);
@@ -1433,36 +2367,34 @@ TerrainView *TerrainView_New(ViewManager *manager, Terrain *terrain)
         GLuint light_color = glGetUniformLocation(
             view->gl_terrain_shaders, "light_color");
         glUniform4f(light_color, 1, 1, 0.85, 1);
-    }
-    glUseProgram(0);
 
-    // Axis shader
-    view->gl_axis_shaders = GL_LoadShaders(
-        "shaders/axis_vertex.glsl", "shaders/axis_fragment.glsl");
-    view->gl_axis_shader_mvp = glGetUniformLocation(
-        view->gl_axis_shaders, "mvp");
+        // The palette of material colors, indexed by material ID. Since the
+        // terrain only stores IDs, recoloring a material would only mean
+        // uploading this uniform again.
+        ASSERT(NUM_MATERIALS <= TERRAIN_PALETTE_SIZE);
+        vec4 palette[NUM_MATERIALS];
+        for (uint8_t i = 0; i < NUM_MATERIALS; ++i) {
+            palette[i] = materials[i]->color;
+        }
+        GLuint palette_location = glGetUniformLocation(
+            view->gl_terrain_shaders, "palette");
+        glUniform4fv(palette_location, NUM_MATERIALS, (GLfloat *)palette);
 
-    // Lines shader
-    view->gl_lines_shaders = GL_LoadShaders(
-        "shaders/lines_vertex.glsl", "shaders/lines_fragment.glsl");
-    view->gl_lines_shader_mvp = glGetUniformLocation(
-        view->gl_lines_shaders, "mvp");
+        // The dimensions of the terrain never change either.
+        GLuint xy_resolution = glGetUniformLocation(
+            view->gl_terrain_shaders, "xy_resolution");
+        glUniform1f(xy_resolution, terrain->xy_resolution);
+    }
+    glUseProgram(0);
 
     ////////////////////////////////////////////////////////////////////////////
     // Initialize view matrices
     //
-    TerrainView_UpdateMVP(view);
-
-    ////////////////////////////////////////////////////////////////////////////
-    // Initialize holes
-    //
-    TerrainView_UpdateHoleLines(view);
+    TerrainView_UpdateDerived(view);
 
     ////////////////////////////////////////////////////////////////////////////
     // Initialize round
     //
-    glGenVertexArrays(1, &view->gl_ball_vao);
-    glGenBuffers(1, &view->gl_ball_buffer);
     Round_Start(&view->round, view->terrain);
 
     ////////////////////////////////////////////////////////////////////////////
@@ -1540,11 +2472,21 @@ DECLARE_RUNNABLE(show_routing, "routing", "enable rendering of routing map")
     (void)argv;
 
     view->show_holes = true;
-    TerrainView_UpdateHoleLines(view);
+    ++view->holes_version;
+}
+
+DECLARE_RUNNABLE(show_minimap, "minimap", "enable rendering of the minimap")
+{
+    (void)console;
+    (void)argc;
+    (void)argv;
+
+    view->show_minimap = true;
 }
 
 DECLARE_SUB_COMMANDS(show, "show", "enable rendering of scene entities",
-    &show_axes, &show_terrain, &show_terrain_mesh, &show_routing);
+    &show_axes, &show_terrain, &show_terrain_mesh, &show_routing,
+    &show_minimap);
 
 ////////////////////////////////////////////////////////////////////////////////
 // Hide
@@ -1585,11 +2527,21 @@ DECLARE_RUNNABLE(hide_routing, "routing", "disable rendering of routing map")
     (void)argv;
 
     view->show_holes = false;
-    TerrainView_UpdateHoleLines(view);
+    ++view->holes_version;
+}
+
+DECLARE_RUNNABLE(hide_minimap, "minimap", "disable rendering of the minimap")
+{
+    (void)console;
+    (void)argc;
+    (void)argv;
+
+    view->show_minimap = false;
 }
 
 DECLARE_SUB_COMMANDS(hide, "hide", "disable rendering of scene entities",
-    &hide_axes, &hide_terrain, &hide_terrain_mesh, &hide_routing);
+    &hide_axes, &hide_terrain, &hide_terrain_mesh, &hide_routing,
+    &hide_minimap);
 
 ////////////////////////////////////////////////////////////////////////////////
 // Window
@@ -1614,23 +2566,90 @@ DECLARE_RUNNABLE(window_info, "info", "print information about the the window")
     TextField_Printf((TextField *)console,
         "Cursor y: %d\n", (int)floor(cursor_y));
 
-#ifndef NDEBUG
-    // Print a running average of the frame rate
-    float   avg_ms = 0;
-    uint8_t n      = sizeof(view->dts)/sizeof(view->dts[0]);
+    // Print frame pacing statistics
+    ViewFrameStats stats;
+    ViewManager_GetFrameStats(((View *)view)->manager, &stats);
+    TextField_Printf((TextField *)console, "Frames rendered: %llu\n",
+        (unsigned long long)stats.frames);
+    TextField_Printf((TextField *)console, "Frames missed: %llu\n",
+        (unsigned long long)stats.missed);
+    TextField_Printf((TextField *)console, "Background frames: %llu\n",
+        (unsigned long long)stats.background);
+}
+
+DECLARE_RUNNABLE(window_fps, "fps",
+    "<rate> limit the frame rate (0 for no limit)")
+{
+    if (argc != 1) {
+        TextField_PutLine(
+            (TextField *)console, "command 'window fps' takes one argument");
+        return;
+    }
+
+    int rate = atoi(argv[0]);
+    if (rate < 0) {
+        TextField_PutLine((TextField *)console, "rate must not be negative");
+        return;
+    }
+
+    ViewManager_SetFrameRate(((View *)view)->manager, rate);
+}
+
+DECLARE_RUNNABLE(window_vsync, "vsync", "<on|off> synchronize with the display")
+{
+    if (argc != 1) {
+        TextField_PutLine(
+            (TextField *)console, "command 'window vsync' takes one argument");
+        return;
+    }
 
-    for (uint8_t i = 0; i < n; ++i) {
-        avg_ms += view->dts[i];
+    if (strcmp("on", argv[0]) == 0) {
+        ViewManager_SetVSync(((View *)view)->manager, true);
+    } else if (strcmp("off", argv[0]) == 0) {
+        ViewManager_SetVSync(((View *)view)->manager, false);
+    } else {
+        TextField_PutLine((TextField *)console, "expected 'on' or 'off'");
     }
-    avg_ms = avg_ms / n;
+}
+
+DECLARE_RUNNABLE(window_resources, "resources",
+    "print the number of GL programs and textures loaded")
+{
+    (void)view;
+    (void)argc;
+    (void)argv;
+
+    uint32_t programs, textures;
+    GL_GetResourceCounts(&programs, &textures);
+    TextField_Printf((TextField *)console, "Programs: %u\n", programs);
+    TextField_Printf((TextField *)console, "Textures: %u\n", textures);
+}
 
-    float rate = 1000.0 / avg_ms;
-    TextField_Printf((TextField *)console, "Frame rate: %.1f\n", rate);
-#endif
+DECLARE_RUNNABLE(window_draws, "draws",
+    "print the draw calls and state changes in the last frame")
+{
+    (void)argc;
+    (void)argv;
+
+    RenderQueueStats stats;
+    RenderQueue_GetStats(View_GetRenderQueue((View *)view), &stats);
+    TextField_Printf((TextField *)console, "Items:           %u\n",
+        stats.items);
+    TextField_Printf((TextField *)console, "Draw calls:      %u\n",
+        stats.draw_calls);
+    TextField_Printf((TextField *)console, "Program changes: %u\n",
+        stats.program_changes);
+    TextField_Printf((TextField *)console, "Texture changes: %u\n",
+        stats.texture_changes);
+    TextField_Printf((TextField *)console, "VAO changes:     %u\n",
+        stats.vao_changes);
+    TextField_Printf((TextField *)console, "Blend changes:   %u\n",
+        stats.blend_changes);
 }
 
 DECLARE_SUB_COMMANDS(window, "window", "print information about the window",
-    &window_info);
+    &window_info, &window_resources, &window_fps, &window_vsync,
+    &window_draws);
 
 ////////////////////////////////////////////////////////////////////////////////
 // Camera
@@ -1659,7 +2678,7 @@ DECLARE_RUNNABLE(camera_zoom, "zoom", "adjust the zoom by a delta")
 
     int delta = atoi(argv[0]);
     view->camera_zoom -= delta;
-    TerrainView_UpdateMVP(view);
+    ++view->camera_version;
 }
 
 DECLARE_RUNNABLE(camera_info, "info",
@@ -1695,21 +2714,12 @@ DECLARE_SUB_COMMANDS(camera, "camera", "inspect and manipulate the camera",
 
 static const Material *ParseMaterial(const char *name)
 {
-    if (strcasecmp("fairway", name) == 0) {
-        return &fairway;
-    } else if (strcasecmp("green", name) == 0) {
-        return &green;
-    } else if (strcasecmp("tee", name) == 0) {
-        return &tee;
-    } else if (strcasecmp("rough", name) == 0) {
-        return &rough;
-    } else if (strcasecmp("sand", name) == 0) {
-        return &sand;
-    } else if (strcasecmp("water", name) == 0) {
-        return &water;
-    } else {
-        return NULL;
+    for (uint8_t i = 0; i < NUM_MATERIALS; ++i) {
+        if (strcasecmp(materials[i]->name, name) == 0) {
+            return materials[i];
+        }
     }
+    return NULL;
 }
 
 DECLARE_RUNNABLE(terrain_set, "set",
@@ -1739,7 +2749,7 @@ DECLARE_RUNNABLE(terrain_set, "set",
     }
 
     Terrain_GetFace(view->terrain, row, col)->material = material;
-    TerrainView_UpdateFaceColors(view);
+    TerrainView_UpdateFaceMaterials(view, row, col, row, col);
 }
 
 DECLARE_RUNNABLE(terrain_bulk_set, "bulk-set",
@@ -1785,7 +2795,8 @@ DECLARE_RUNNABLE(terrain_bulk_set, "bulk-set",
         }
     }
 
-    TerrainView_UpdateFaceColors(view);
+    TerrainView_UpdateFaceMaterials(
+        view, start_row, start_col, end_row, end_col);
 }
 
 DECLARE_RUNNABLE(terrain_raise_face, "raise-face",
@@ -1810,7 +2821,9 @@ DECLARE_RUNNABLE(terrain_raise_face, "raise-face",
 
     int delta = atoi(argv[2]);
     Terrain_RaiseFace(view->terrain, row, col, delta);
-    TerrainView_UpdateFaceHeights(view);
+    TerrainView_UpdateFaceHeights(view, row, col, row + 1, col + 1, true);
+        // Console commands wait for the normals, so that scripted edits
+        // render the same way every time.
 }
 
 DECLARE_RUNNABLE(terrain_bulk_raise_face, "bulk-raise-face",
@@ -1852,7 +2865,8 @@ DECLARE_RUNNABLE(terrain_bulk_raise_face, "bulk-raise-face",
         }
     }
 
-    TerrainView_UpdateFaceHeights(view);
+    TerrainView_UpdateFaceHeights(
+        view, start_row, start_col, end_row + 1, end_col + 1, true);
 }
 
 DECLARE_RUNNABLE(terrain_raise_vertex, "raise-vertex",
@@ -1877,7 +2891,7 @@ DECLARE_RUNNABLE(terrain_raise_vertex, "raise-vertex",
 
     int delta = atoi(argv[2]);
     Terrain_RaiseVertex(view->terrain, row, col, delta);
-    TerrainView_UpdateFaceHeights(view);
+    TerrainView_UpdateFaceHeights(view, row, col, row, col, true);
 }
 
 DECLARE_RUNNABLE(terrain_bulk_raise_vertex, "bulk-raise-vertex",
@@ -1919,7 +2933,8 @@ DECLARE_RUNNABLE(terrain_bulk_raise_vertex, "bulk-raise-vertex",
         }
     }
 
-    TerrainView_UpdateFaceHeights(view);
+    TerrainView_UpdateFaceHeights(
+        view, start_row, start_col, end_row, end_col, true);
 }
 
 DECLARE_RUNNABLE(terrain_define_hole, "define-hole",
@@ -1962,7 +2977,7 @@ DECLARE_RUNNABLE(terrain_define_hole, "define-hole",
     }
 
     Terrain_DefineHole(view->terrain, hole - 1, par, shot_points);
-    TerrainView_UpdateHoleLines(view);
+    ++view->holes_version;
 }
 
 DECLARE_RUNNABLE(terrain_info_normal, "normal",
@@ -2052,6 +3067,100 @@ DECLARE_RUNNABLE(terrain_info_routing, "routing",
     }
 }
 
+#define BENCHMARK_MIN_US 100000
+    // Minimum time to spend on each measurement in `terrain benchmark`, so
+    // that rebuilds of small terrains are repeated enough times to be timed
+    // accurately.
+
+// Rebuild the CPU-side mesh data (heights and normals) for every vertex of
+// `terrain`, the way `TerrainView_UpdateAllHeights` does, and return the mean
+// time per rebuild in microseconds.
+static uint64_t TerrainView_BenchmarkRebuild(
+    const Terrain *terrain, uint16_t *heights, vec3 *normals, bool parallel)
+{
+    uint16_t width  = Terrain_VertexWidth(terrain);
+    uint16_t height = Terrain_VertexHeight(terrain);
+
+    uint64_t start = Clock_GetTimeUS();
+    uint64_t elapsed;
+    uint32_t iterations = 0;
+    do {
+        for (uint16_t row = 0; row < height; ++row) {
+            for (uint16_t col = 0; col < width; ++col) {
+                heights[(uint32_t)row*width + col] =
+                    Terrain_GetVertexHeight(terrain, row, col);
+            }
+        }
+
+        if (parallel) {
+            TerrainView_ComputeNormals(heights, width, height,
+                0, 0, height - 1, width - 1, normals);
+        } else {
+            NormalBand band = {
+                heights, width, height, 0, 0, width - 1, normals
+            };
+            TerrainView_ComputeNormalBand(0, height, &band);
+        }
+
+        ++iterations;
+        elapsed = Clock_GetTimeUS() - start;
+    } while (elapsed < BENCHMARK_MIN_US);
+
+    return elapsed/iterations;
+}
+
+DECLARE_RUNNABLE(terrain_benchmark, "benchmark",
+    "time mesh rebuilds for terrains up to <size> faces square")
+{
+    if (argc > 1) {
+        TextField_PutLine((TextField *)console,
+            "command 'terrain benchmark' takes at most one argument");
+        return;
+    }
+
+    int max_size = argc == 1 ? atoi(argv[0]) : 1024;
+    if (max_size < 64 || max_size > 4096) {
+        TextField_PutLine((TextField *)console,
+            "size must be between 64 and 4096");
+        return;
+    }
+
+    TextField_Printf((TextField *)console,
+        "Mesh rebuild time (heights and normals), %u threads\n",
+        Parallel_NumThreads());
+    TextField_PutLine((TextField *)console,
+        "  Size | Serial (ms) | Parallel (ms)");
+    TextField_PutLine((TextField *)console,
+        "-------|-------------|---------------");
+
+    for (int size = 64; size <= max_size; size *= 2) {
+        Terrain terrain;
+        Terrain_Init(&terrain, size, size, view->terrain->xy_resolution);
+
+        // Give the terrain some relief, so we aren't just timing a flat plane.
+        for (int row = 0; row <= size; ++row) {
+            for (int col = 0; col <= size; ++col) {
+                Terrain_RaiseVertex(&terrain, row, col, (row*7 + col*13) % 32);
+            }
+        }
+
+        uint16_t *heights = Malloc(
+            sizeof(uint16_t)*Terrain_NumVertices(&terrain));
+        vec3 *normals = Malloc(sizeof(vec3)*Terrain_NumVertices(&terrain));
+
+        uint64_t serial = TerrainView_BenchmarkRebuild(
+            &terrain, heights, normals, false);
+        uint64_t parallel = TerrainView_BenchmarkRebuild(
+            &terrain, heights, normals, true);
+        TextField_Printf((TextField *)console, " %5d | %11.2f | %13.2f\n",
+            size, serial/1000.0, parallel/1000.0);
+
+        free(normals);
+        free(heights);
+        Terrain_Destroy(&terrain);
+    }
+}
+
 DECLARE_SUB_COMMANDS(terrain_info, "info",
     "get information about various aspects of the terrain",
     &terrain_info_normal, &terrain_info_height, &terrain_info_routing);
@@ -2060,7 +3169,7 @@ DECLARE_SUB_COMMANDS(terrain, "terrain", "inspect and manipulate the terrain",
     &terrain_set, &terrain_bulk_set,
     &terrain_raise_face, &terrain_bulk_raise_face,
     &terrain_raise_vertex, &terrain_bulk_raise_vertex,
-    &terrain_define_hole, &terrain_info);
+    &terrain_define_hole, &terrain_benchmark, &terrain_info);
 
 ////////////////////////////////////////////////////////////////////////////////
 // Round
@@ -2204,6 +3313,81 @@ DECLARE_RUNNABLE(hud_select, "select", "select a tool from the HUD menu")
 DECLARE_SUB_COMMANDS(hud, "hud", "inspect and modify the state of the HUD menu",
     &hud_info, &hud_select);
 
-DECLARE_PROGRAM(&show, &hide, &window, &camera, &terrain, &round_comm, &hud);
+////////////////////////////////////////////////////////////////////////////////
+// Profiler
+//
+
+DECLARE_RUNNABLE(perf_on, "on",
+    "start profiling, and show a summary in the corner of the window")
+{
+    (void)console;
+    (void)argv;
+    (void)argc;
+
+    Profiler_Enable(true);
+    TerrainView_OpenPerfText(view);
+}
+
+DECLARE_RUNNABLE(perf_off, "off", "stop profiling and hide the summary")
+{
+    (void)console;
+    (void)argv;
+    (void)argc;
+
+    Profiler_Enable(false);
+    TerrainView_ClosePerfText(view);
+}
+
+DECLARE_RUNNABLE(perf_show, "show",
+    "print the time spent in each zone over the last frames")
+{
+    (void)view;
+    (void)argv;
+    (void)argc;
+
+    if (!Profiler_IsEnabled()) {
+        TextField_PutLine((TextField *)console,
+            "profiler is off, use 'perf on' to start it");
+        return;
+    }
+
+    ProfileSummary frame;
+    Profiler_GetSummary(PROFILE_FRAME, &frame);
+    TextField_Printf((TextField *)console, "Frames: %u\n", frame.samples);
+    TerrainView_PrintProfile((TextField *)console);
+}
+
+DECLARE_RUNNABLE(perf_reset, "reset", "discard the samples collected so far")
+{
+    (void)console;
+    (void)view;
+    (void)argv;
+    (void)argc;
+
+    Profiler_Reset();
+}
+
+DECLARE_RUNNABLE(perf_dump, "dump",
+    "write recent samples and histograms for each zone to <file> as CSV")
+{
+    (void)view;
+
+    if (argc != 1) {
+        TextField_PutLine((TextField *)console,
+            "command 'perf dump' takes exactly one argument");
+        return;
+    }
+
+    if (!Profiler_Dump(argv[0])) {
+        TextField_Printf((TextField *)console,
+            "unable to write %s: %s\n", argv[0], strerror(errno));
+    }
+}
+
+DECLARE_SUB_COMMANDS(perf, "perf", "measure where the time in each frame goes",
+    &perf_on, &perf_off, &perf_show, &perf_reset, &perf_dump);
+
+DECLARE_PROGRAM(&show, &hide, &window, &camera, &terrain, &round_comm, &hud,
+    &perf);
 
 #undef PROGRAM_INFO
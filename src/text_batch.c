@@ -0,0 +1,395 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include "errors.h"
+#include "gl.h"
+#include "matrix.h"
+#include "render_queue.h"
+#include "text_batch.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Monofur bitmap font parameters
+//
+// The font bitmap is layed out like:
+//
+//      abcdefghijklmnopqrstuvwxyz
+//      ABCDEFGHIJKLMNOPQRSTUVWXYZ
+//      0123456789.:,;(*!?}^)#${%^&-+@
+//
+// In ASCII, that's:
+//
+//      0x61 - 0x7A
+//      0x41 - 0x5A
+//      0x30 - 0x39 ...
+//
+// where '...' (the punctuation characters) are scattered through the alphabet.
+//
+// Because the letters and numbers are laid out nicely with respect to their
+// ASCII encodings, and because the font is monospace, we only need to know the
+// coordinates of the first character in each of the three ranges of contiguous
+// ASCII encodings (lower-case, upper-case, and numbers) to compute the
+// coordinates of any character in that range.
+//
+// Because the punctuation marks are not laid out nicely, we will need to hard-
+// code the coordinates of any punction marks we care about being able to
+// render.
+//
+// All coordinates and sizes of characters in the font will be represented in
+// texture-space:
+//
+//    (0, 1)           (1, 1)
+//          .---------.
+//          |         |
+//          |         |
+//          |         |
+//          .---------.
+//    (0, 0)           (1, 0)
+//
+// All coordinates will refer to the lower-left corner of the character they
+// represent, so that the bounding box of the character with coordinates (u, v)
+// is { (u, v + FONT_HEIGHT),   (u + FONT_WIDTH, v + FONT_HEIGHT),
+//      (u, v),                 (u + FONT_WIDTH, v) }.
+//
+
+// Size in pixels of a single character in the font bitmap.
+static const float FONT_WIDTH = 0.0175;
+static const float FONT_HEIGHT = 0.037;
+
+// Texture-space coordinates for 'a'.
+#define FONT_LOWER_A ((vec2) { 0.02, 0.955 })
+
+// Texture-space coordinates for 'A'.
+#define FONT_UPPER_A ((vec2) { FONT_LOWER_A.x, FONT_LOWER_A.y - FONT_HEIGHT})
+
+// Texture-space coordinates for '0'.
+#define FONT_0 ((vec2) { FONT_UPPER_A.x, FONT_UPPER_A.y - FONT_HEIGHT})
+
+// Texure-space coordinates for ' '
+#define FONT_SPACE ((vec2) { 0, 0 })
+
+// Texture-space coordinates for the start of the punctuation characters.
+#define FONT_PUNCTUATION ((vec2) { FONT_0.x + 10*FONT_WIDTH, FONT_0.y })
+
+// Punctuation characters as they appear in the font bitmap.
+static const char *FONT_PUNCTUATION_CHARS = ".:,;(*!?}^)#${%^&-+@";
+
+// Distance in texels from the edges of the characters at which the font's
+// distance field saturates. We only antialias within a pixel or so of an edge,
+// so a few texels is plenty, even for text drawn smaller than the bitmap. The
+// field is built for this spread at build time, so src/CMakeLists.txt has to
+// agree with it.
+#define FONT_DISTANCE_SPREAD 4
+
+// Coordinates of every character, indexed by its encoding, and whether it is
+// missing from the font and drawn as a question mark instead. These are filled
+// in the first time we look up a character.
+static vec2 font_glyph_uvs[256];
+static bool font_glyph_missing[256];
+static bool font_glyphs_ready = false;
+
+// Find the coordinates of `c` in the font bitmap. Returns false, and the
+// coordinates of a question mark, if the font doesn't have `c`.
+static bool TextBatch_FindGlyph(char c, vec2 *v)
+{
+    if ('a' <= c && c <= 'z') {
+        v->x = FONT_LOWER_A.x + (FONT_WIDTH*(c - 'a'));
+        v->y = FONT_LOWER_A.y;
+    } else if ('A' <= c && c <= 'Z') {
+        v->x = FONT_UPPER_A.x + (FONT_WIDTH*(c - 'A'));
+        v->y = FONT_UPPER_A.y;
+    } else if ('0' <= c && c <= '9') {
+        v->x = FONT_0.x + (FONT_WIDTH*(c - '0'));
+        v->y = FONT_0.y;
+    } else if (c == ' ' || c == '\0') {
+        *v = FONT_SPACE;
+            // `TextField_Printf` leaves a null after the text it prints, which
+            // should look like the rest of the empty line.
+    } else if (c == '\'') {
+        // The font doesn't have an apostrophe, but it's a pretty important
+        // character, so we hack it by using a comma shifted up.
+        char *p = strchr(FONT_PUNCTUATION_CHARS, ',');
+        ASSERT(p != NULL);
+
+        uintptr_t index = p - FONT_PUNCTUATION_CHARS;
+        v->x = FONT_PUNCTUATION.x + (FONT_WIDTH*index);
+        v->y = FONT_PUNCTUATION.y - (FONT_HEIGHT/2);
+    } else {
+        char *p = strchr(FONT_PUNCTUATION_CHARS, c);
+        bool found = p != NULL;
+        if (!found) {
+            p = strchr(FONT_PUNCTUATION_CHARS, '?');
+                // Can't print this character, print a question mark instead.
+        }
+        ASSERT(p != NULL);
+
+        uintptr_t index = p - FONT_PUNCTUATION_CHARS;
+        v->x = FONT_PUNCTUATION.x + (FONT_WIDTH*index);
+        v->y = FONT_PUNCTUATION.y;
+        return found;
+    }
+
+    return true;
+}
+
+void TextBatch_FontCoords(char c, vec2 *v)
+{
+    if (!font_glyphs_ready) {
+        // Searching the punctuation is too slow to do for every cell of every
+        // text field whenever it's flushed, so we do it once per character.
+        for (uint16_t i = 0; i < 256; ++i) {
+            font_glyph_missing[i] =
+                !TextBatch_FindGlyph((char)i, &font_glyph_uvs[i]);
+        }
+        font_glyphs_ready = true;
+    }
+
+    uint8_t i = (uint8_t)c;
+    if (font_glyph_missing[i]) {
+        warn("Tried to render unprintable character %#x\n", (int)c);
+    }
+    *v = font_glyph_uvs[i];
+}
+
+void TextBatch_Init(TextBatch *batch)
+{
+    batch->glyphs = NULL;
+    batch->num_glyphs = 0;
+    batch->capacity = 0;
+    batch->runs = NULL;
+    batch->num_runs = 0;
+    batch->num_prev_runs = 0;
+    batch->runs_capacity = 0;
+    batch->upload_begin = 0;
+    batch->upload_end = 0;
+    batch->buffer_capacity = 0;
+
+    batch->shaders = GL_LoadShaders(
+        "shaders/text_vertex.glsl", "shaders/text_fragment.glsl");
+    batch->font_texture =
+        GL_LoadDistanceField("textures/monofur.bmp", FONT_DISTANCE_SPREAD);
+    batch->font_sampler = glGetUniformLocation(batch->shaders, "font");
+    batch->mvp = glGetUniformLocation(batch->shaders, "mvp");
+    batch->shader_font_glyph_size =
+        glGetUniformLocation(batch->shaders, "font_glyph_size");
+
+    // Every glyph is an instance of the same quadrilateral, whose corners the
+    // vertex shader derives from `gl_VertexID`, so the only attributes are per-
+    // instance. They all come from the glyph buffer, which is allocated when
+    // we first draw; reallocating its storage doesn't disturb the pointers.
+    glGenBuffers(1, &batch->buffer);
+    glGenVertexArrays(1, &batch->vao);
+    glBindVertexArray(batch->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, batch->buffer);
+    {
+        glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION);
+        glEnableVertexAttribArray(VERTEX_ATTRIB_TEXTURE_UV);
+        glEnableVertexAttribArray(VERTEX_ATTRIB_GLYPH_SIZE);
+        glEnableVertexAttribArray(VERTEX_ATTRIB_COLOR);
+        glEnableVertexAttribArray(VERTEX_ATTRIB_BG_COLOR);
+        glVertexAttribDivisor(VERTEX_ATTRIB_POSITION, 1);
+        glVertexAttribDivisor(VERTEX_ATTRIB_TEXTURE_UV, 1);
+        glVertexAttribDivisor(VERTEX_ATTRIB_GLYPH_SIZE, 1);
+        glVertexAttribDivisor(VERTEX_ATTRIB_COLOR, 1);
+        glVertexAttribDivisor(VERTEX_ATTRIB_BG_COLOR, 1);
+
+        glVertexAttribPointer(VERTEX_ATTRIB_POSITION, 2, GL_FLOAT,
+            GL_FALSE, sizeof(TextGlyph),
+            (const GLvoid *)offsetof(TextGlyph, position));
+        glVertexAttribPointer(VERTEX_ATTRIB_TEXTURE_UV, 2, GL_FLOAT,
+            GL_FALSE, sizeof(TextGlyph),
+            (const GLvoid *)offsetof(TextGlyph, uv));
+        glVertexAttribPointer(VERTEX_ATTRIB_GLYPH_SIZE, 2,
+            GL_UNSIGNED_SHORT, GL_FALSE, sizeof(TextGlyph),
+            (const GLvoid *)offsetof(TextGlyph, size));
+        glVertexAttribPointer(VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE,
+            GL_TRUE, sizeof(TextGlyph),
+            (const GLvoid *)offsetof(TextGlyph, fg_color));
+        glVertexAttribPointer(VERTEX_ATTRIB_BG_COLOR, 4, GL_UNSIGNED_BYTE,
+            GL_TRUE, sizeof(TextGlyph),
+            (const GLvoid *)offsetof(TextGlyph, bg_color));
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TextBatch_Destroy(TextBatch *batch)
+{
+    free(batch->glyphs);
+    free(batch->runs);
+    glDeleteVertexArrays(1, &batch->vao);
+    glDeleteBuffers(1, &batch->buffer);
+    GL_ReleaseTexture(batch->font_texture);
+    GL_ReleaseShaders(batch->shaders);
+}
+
+// Record that `[begin, end)` of the batch's glyphs has to be uploaded.
+static void TextBatch_MarkUpload(TextBatch *batch, uint32_t begin, uint32_t end)
+{
+    if (batch->upload_begin == batch->upload_end) {
+        batch->upload_begin = begin;
+        batch->upload_end = end;
+    } else {
+        batch->upload_begin = UintMin(batch->upload_begin, begin);
+        batch->upload_end = UintMax(batch->upload_end, end);
+    }
+}
+
+void TextBatch_Add(TextBatch *batch, const void *owner,
+    const TextGlyph *glyphs, uint32_t count,
+    uint32_t changed_begin, uint32_t changed_end)
+{
+    ASSERT(changed_begin <= changed_end && changed_end <= count);
+
+    uint32_t first = batch->num_glyphs;
+    if (first + count > batch->capacity) {
+        // Grow geometrically, so that after the first few frames the array is
+        // big enough for all the text on the screen and we stop reallocating.
+        batch->capacity = UintMax(2*batch->capacity, first + count);
+        batch->glyphs =
+            Realloc(batch->glyphs, batch->capacity*sizeof(TextGlyph));
+    }
+    if (batch->num_runs == batch->runs_capacity) {
+        batch->runs_capacity = UintMax(2*batch->runs_capacity, 16);
+        batch->runs =
+            Realloc(batch->runs, batch->runs_capacity*sizeof(TextBatchRun));
+    }
+
+    // If the run this replaces was the same text field in the same place, the
+    // glyphs it left behind are still current apart from the ones which have
+    // changed. Otherwise, they belong to something else.
+    TextBatchRun *run = &batch->runs[batch->num_runs];
+    bool same = batch->num_runs < batch->num_prev_runs &&
+        run->owner == owner && run->first == first && run->count == count;
+    if (!same) {
+        changed_begin = 0;
+        changed_end = count;
+    }
+    run->owner = owner;
+    run->first = first;
+    run->count = count;
+    ++batch->num_runs;
+
+    if (changed_begin < changed_end) {
+        memcpy(&batch->glyphs[first + changed_begin], &glyphs[changed_begin],
+            (changed_end - changed_begin)*sizeof(TextGlyph));
+        TextBatch_MarkUpload(
+            batch, first + changed_begin, first + changed_end);
+    }
+    batch->num_glyphs += count;
+}
+
+// Start collecting the next frame's glyphs. The runs of this frame are kept to
+// compare with those of the next.
+static void TextBatch_EndFrame(TextBatch *batch)
+{
+    batch->num_prev_runs = batch->num_runs;
+    batch->num_runs = 0;
+    batch->num_glyphs = 0;
+}
+
+// Draw the glyphs collected in the batch. This is called by the render queue,
+// which has bound our program, font texture and vertex array.
+static uint32_t TextBatch_Draw(const RenderItem *item)
+{
+    TextBatch *batch = item->object;
+
+    glBindBuffer(GL_ARRAY_BUFFER, batch->buffer);
+    if (batch->num_glyphs > batch->buffer_capacity) {
+        // Reallocating the buffer loses its contents, so everything we draw
+        // has to be uploaded again.
+        batch->buffer_capacity = batch->capacity;
+        glBufferData(GL_ARRAY_BUFFER,
+            batch->buffer_capacity*sizeof(TextGlyph), NULL, GL_DYNAMIC_DRAW);
+        TextBatch_MarkUpload(batch, 0, batch->num_glyphs);
+    }
+    if (batch->upload_begin < batch->upload_end) {
+        glBufferSubData(GL_ARRAY_BUFFER,
+            batch->upload_begin*sizeof(TextGlyph),
+            (batch->upload_end - batch->upload_begin)*sizeof(TextGlyph),
+            &batch->glyphs[batch->upload_begin]);
+        batch->upload_begin = batch->upload_end = 0;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUniformMatrix3fv(
+        batch->mvp, 1, GL_TRUE, mat3_ConstBuffer(&batch->transform));
+    glUniform2f(batch->shader_font_glyph_size, FONT_WIDTH, FONT_HEIGHT);
+    glUniform1i(batch->font_sampler, 0);
+
+    glDisable(GL_DEPTH_TEST);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, batch->num_glyphs);
+    glEnable(GL_DEPTH_TEST);
+        // Every glyph has the same depth, so with the depth test a cell would
+        // hide any cell of a field added after it, instead of being blended
+        // under it.
+
+    TextBatch_EndFrame(batch);
+    return 1;
+}
+
+void TextBatch_Submit(TextBatch *batch, RenderQueue *queue,
+    uint32_t window_width, uint32_t window_height)
+{
+    if (batch->num_glyphs == 0) {
+        TextBatch_EndFrame(batch);
+        return;
+    }
+
+    // Initialize the transformation matrix. We need to go from window
+    // coordinates:
+    //
+    //                     window width (px)
+    //                  <------------------->
+    //                y
+    //                  ^--------------------    ^
+    //                  |                   |    |
+    //                  |                   |    |
+    //                  |                   |    | window height (px)
+    //                  |                   |    |
+    //                  |                   |    |
+    //                  o------------------->    V
+    //                                       x
+    //
+    // To view coordinates:
+    //
+    //                      -1          1
+    //                  <--------| |-------->
+    //                           y
+    //                  ----------^----------    ^
+    //                  |         |         |    | 1
+    //                  |         |         |    _
+    //                  |         o--------->    _
+    //                  |                   | x  |
+    //                  |                   |    | -1
+    //                  ---------------------    V
+    //
+    // This transformation requires first scaling by (2/width, 2/height) to
+    // normalize x- and y-coordinates to the range [0, 2], and then translating
+    // by (-1, -1) to move the origin to (-1, -1), where it will be rendered in
+    // the bottom left corner of the screen, like we want.
+    mat3 *transform = &batch->transform;
+    mat3_Copy(transform, &I3);
+        // Initialize to the identity so we can layer transformations on.
+    mat3 m;
+    vec2 v;
+    v = (vec2) { 2.0/window_width, 2.0/window_height };
+    mat3_Scale(&m, &v);
+    mat3_ComposeInPlace(&m, transform);
+        // Scale by (2/width, 2/height).
+    v = (vec2) { -1, -1 };
+    mat3_Translation(&m, &v);
+    mat3_ComposeInPlace(&m, transform);
+        // Translate by (-1, -1).
+
+    RenderItem *item = RenderQueue_Add(queue, RENDER_LAYER_OVERLAY);
+    item->program = batch->shaders;
+    item->texture = batch->font_texture;
+    item->vao = batch->vao;
+    item->draw = TextBatch_Draw;
+    item->object = batch;
+}
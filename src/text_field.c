@@ -1,6 +1,8 @@
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -9,211 +11,154 @@
 #include "gl.h"
 #include "matrix.h"
 #include "text.h"
+#include "text_batch.h"
 
-////////////////////////////////////////////////////////////////////////////////
-// Monofur bitmap font parameters
-//
-// The font bitmap is layed out like:
-//
-//      abcdefghijklmnopqrstuvwxyz
-//      ABCDEFGHIJKLMNOPQRSTUVWXYZ
-//      0123456789.:,;(*!?}^)#${%^&-+@
-//
-// In ASCII, that's:
-//
-//      0x61 - 0x7A
-//      0x41 - 0x5A
-//      0x30 - 0x39 ...
-//
-// where '...' (the punctuation characters) are scattered through the alphabet.
-//
-// Because the letters and numbers are laid out nicely with respect to their
-// ASCII encodings, and because the font is monospace, we only need to know the
-// coordinates of the first character in each of the three ranges of contiguous
-// ASCII encodings (lower-case, upper-case, and numbers) to compute the
-// coordinates of any character in that range.
-//
-// Because the punctuation marks are not laid out nicely, we will need to hard-
-// code the coordinates of any punction marks we care about being able to
-// render.
-//
-// All coordinates and sizes of characters in the font will be represented in
-// texture-space:
-//
-//    (0, 1)           (1, 1)
-//          .---------.
-//          |         |
-//          |         |
-//          |         |
-//          .---------.
-//    (0, 0)           (1, 0)
-//
-// All coordinates will refer to the lower-left corner of the character they
-// represent, so that the bounding box of the character with coordinates (u, v)
-// is { (u, v + FONT_HEIGHT),   (u + FONT_WIDTH, v + FONT_HEIGHT),
-//      (u, v),                 (u + FONT_WIDTH, v) }.
-//
-
-// Size in pixels of a single character in the font bitmap.
-static const float FONT_WIDTH = 0.0175;
-static const float FONT_HEIGHT = 0.037;
-
-// Texture-space coordinates for 'a'.
-#define FONT_LOWER_A ((vec2) { 0.02, 0.955 })
-
-// Texture-space coordinates for 'A'.
-#define FONT_UPPER_A ((vec2) { FONT_LOWER_A.x, FONT_LOWER_A.y - FONT_HEIGHT})
-
-// Texture-space coordinates for '0'.
-#define FONT_0 ((vec2) { FONT_UPPER_A.x, FONT_UPPER_A.y - FONT_HEIGHT})
-
-// Texure-space coordinates for ' '
-#define FONT_SPACE ((vec2) { 0, 0 })
-
-// Texture-space coordinates for the start of the punctuation characters.
-#define FONT_PUNCTUATION ((vec2) { FONT_0.x + 10*FONT_WIDTH, FONT_0.y })
-
-// Punctuation characters as they appear in the font bitmap.
-static const char *FONT_PUNCTUATION_CHARS = ".:,;(*!?}^)#${%^&-+@";
-
-// Texture-space coordinates for any ASCII character.
-static void Font_Coords(char c, vec2 *v)
+// Get a pointer to the character at `(row, col)` in the output buffer.
+static char *TextField_CharAt(TextField *text_field, uint8_t row, uint8_t col)
 {
-    if ('a' <= c && c <= 'z') {
-        v->x = FONT_LOWER_A.x + (FONT_WIDTH*(c - 'a'));
-        v->y = FONT_LOWER_A.y;
-    } else if ('A' <= c && c <= 'Z') {
-        v->x = FONT_UPPER_A.x + (FONT_WIDTH*(c - 'A'));
-        v->y = FONT_UPPER_A.y;
-    } else if ('0' <= c && c <= '9') {
-        v->x = FONT_0.x + (FONT_WIDTH*(c - '0'));
-        v->y = FONT_0.y;
-    } else if (c == ' ') {
-        *v = FONT_SPACE;
-    } else if (c == '\'') {
-        // The font doesn't have an apostrophe, but it's a pretty important
-        // character, so we hack it by using a comma shifted up.
-        char *p = strchr(FONT_PUNCTUATION_CHARS, ',');
-        ASSERT(p != NULL);
-
-        uintptr_t index = p - FONT_PUNCTUATION_CHARS;
-        v->x = FONT_PUNCTUATION.x + (FONT_WIDTH*index);
-        v->y = FONT_PUNCTUATION.y - (FONT_HEIGHT/2);
-    } else {
-        char *p = strchr(FONT_PUNCTUATION_CHARS, c);
-        if (p == NULL) {
-            warn("Tried to render unprintable character %#x\n", (int)c);
-            p = strchr(FONT_PUNCTUATION_CHARS, '?');
-                // Can't print this character, print a question mark instead.
-        }
-        ASSERT(p != NULL);
+    return &text_field->buffer[text_field->width*row + col];
+}
 
-        uintptr_t index = p - FONT_PUNCTUATION_CHARS;
-        v->x = FONT_PUNCTUATION.x + (FONT_WIDTH*index);
-        v->y = FONT_PUNCTUATION.y;
+// Convert a color from floating point RGBA to the format used in `TextGlyph`.
+static void TextField_PackColor(const vec4 *color, GLubyte packed[4])
+{
+    const float *channels = vec4_ConstBuffer(color);
+    for (uint8_t i = 0; i < 4; ++i) {
+        float c = channels[i] < 0 ? 0 : channels[i] > 1 ? 1 : channels[i];
+        packed[i] = (GLubyte)(c*255 + 0.5);
     }
 }
 
-#define FONT_ASPECT 0.6
-
-// Get a pointer to the character at `(row, col)` in the output buffer.
-static char *TextField_CharAt(TextField *text_field, uint8_t row, uint8_t col)
+// Record that the glyphs in `[begin, end)` have been rewritten.
+static void TextField_MarkChanged(
+    TextField *text_field, uint16_t begin, uint16_t end)
 {
-    return &text_field->buffer[text_field->width*row + col];
+    if (text_field->changed_begin == text_field->changed_end) {
+        text_field->changed_begin = begin;
+        text_field->changed_end = end;
+    } else {
+        if (begin < text_field->changed_begin) {
+            text_field->changed_begin = begin;
+        }
+        if (end > text_field->changed_end) {
+            text_field->changed_end = end;
+        }
+    }
 }
 
-static void TextField_UpdateVertices(TextField *text_field)
+// Bring the font coordinates of the glyphs up to date with the characters in
+// the buffer.
+static void TextField_UpdateUVs(TextField *text_field)
 {
-    glBindVertexArray(text_field->vao);
-    {
-        glBindBuffer(GL_ARRAY_BUFFER, text_field->vertex_positions);
-        {
-            uint8_t char_height = text_field->font_size;
-            uint8_t char_width = FONT_ASPECT*char_height;
-
-            uint32_t num_vertices = 6*text_field->width*text_field->height;
-                // Each character slot is a quadrilateral, or two triangles, so
-                // requires 6 vertices.
-
-            vec2 *positions = Malloc(num_vertices*sizeof(vec2));
-
-            // Initialize positions
-            uint16_t i = 0;
-                // Offset of the current vertex in `positions`.
-            for (uint8_t row = 0; row < text_field->height; ++row) {
-                for (uint8_t col = 0; col < text_field->width; ++col) {
-                    // Coordinates of the top-left corner of this character.
-                    uint16_t x = text_field->x + col*char_width;
-                    uint16_t y = text_field->y - row*char_height;
-
-                    // Set up coordinates for the following two triangles:
-                    //
-                    //               (x, y)        (x + char_width, y)
-                    //                     A-----,B
-                    //                     | 1  / |
-                    //                     |  ,`  |
-                    //                     | /  2 |
-                    //                     C------D
-                    // (x, y - char_height)        (x + char_width, y - char_height)
-
-                    // Triangle 1: top left, ABC
-                    positions[i++] = (vec2){ x,             y };
-                    positions[i++] = (vec2){ x+char_width,  y };
-                    positions[i++] = (vec2){ x,             y-char_height };
-
-                    // Triangle 2: bottom right, DBC
-                    positions[i++] = (vec2){ x+char_width, y-char_height };
-                    positions[i++] = (vec2){ x+char_width, y };
-                    positions[i++] = (vec2){ x,            y-char_height };
-                }
-            }
+    const uint8_t width = text_field->width;
+    const uint8_t height = text_field->height;
+
+    // Rows which have only scrolled keep their coordinates; we just move them
+    // along with the characters. The glyphs stay where they are on the screen.
+    uint8_t scrolled = text_field->scrolled_rows;
+    if (scrolled > 0 && scrolled < height) {
+        for (uint16_t i = 0; i < (height - scrolled)*width; ++i) {
+            memcpy(text_field->glyphs[i].uv,
+                   text_field->glyphs[i + scrolled*width].uv,
+                   sizeof(text_field->glyphs[i].uv));
+        }
+        TextField_MarkChanged(text_field, 0, (height - scrolled)*width);
+    }
+    text_field->scrolled_rows = 0;
 
-            glBufferData(
-                GL_ARRAY_BUFFER,
-                num_vertices*sizeof(vec2),
-                positions,
-                GL_STATIC_DRAW
-            );
-            glVertexAttribPointer(
-                VERTEX_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, 0);
-            glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION);
-
-            free(positions);
+    for (uint8_t row = 0; row < height; ++row) {
+        if (!text_field->dirty_rows[row]) {
+            continue;
         }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        for (uint8_t col = 0; col < width; ++col) {
+            vec2 uv;
+            TextBatch_FontCoords(*TextField_CharAt(text_field, row, col), &uv);
+            text_field->glyphs[row*width + col].uv[0] = uv.x;
+            text_field->glyphs[row*width + col].uv[1] = uv.y;
+        }
+        text_field->dirty_rows[row] = false;
+        TextField_MarkChanged(text_field, row*width, (row + 1)*width);
     }
-    glBindVertexArray(0);
+
+    text_field->flush_pending = false;
+}
+
+// Rewrite the location, size and colors of the glyph for cell `i`.
+static void TextField_StyleGlyph(TextField *text_field, uint16_t i,
+    const GLubyte fg_color[4], const GLubyte bg_color[4])
+{
+    uint8_t char_height = text_field->font_size;
+    uint8_t char_width = TEXT_BATCH_FONT_ASPECT*char_height;
+    uint8_t row = i/text_field->width;
+    uint8_t col = i%text_field->width;
+
+    // Coordinates of the top-left corner of this character.
+    uint16_t x = text_field->x + col*char_width;
+    uint16_t y = text_field->y - row*char_height;
+
+    TextGlyph *glyph = &text_field->glyphs[i];
+    glyph->position[0] = x;
+    glyph->position[1] = y;
+    glyph->size[0] = char_width;
+    glyph->size[1] = char_height;
+
+    // The cursor is drawn by swapping the foreground and background colors of
+    // the cell it is in.
+    bool cursor = i == text_field->cursor_cell;
+    memcpy(glyph->fg_color, cursor ? bg_color : fg_color, 4);
+    memcpy(glyph->bg_color, cursor ? fg_color : bg_color, 4);
+
+    TextField_MarkChanged(text_field, i, i + 1);
 }
 
 static void TextField_Render(View *view_base, uint32_t dt)
 {
     (void)dt;
     TextField *text_field = (TextField *)view_base;
+    uint16_t num_cells = text_field->width*text_field->height;
 
-    // Load the font texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, text_field->font_texture);
-    glUniform1i(text_field->font_sampler, 0);
-
-    glUseProgram(text_field->shaders);
-    glUniformMatrix3fv(
-        text_field->mvp, 1, GL_TRUE, mat3_ConstBuffer(&text_field->transform));
-    glUniform4fv(
-        text_field->shader_fg_color, 1, vec4_ConstBuffer(&text_field->fg_color));
-    glUniform4fv(
-        text_field->shader_bg_color, 1, vec4_ConstBuffer(&text_field->bg_color));
+    if (text_field->flush_pending) {
+        TextField_UpdateUVs(text_field);
+    }
 
-    glBindVertexArray(text_field->vao);
+    if (text_field->restyle ||
+        text_field->cursor_cell != text_field->glyph_cursor_cell)
     {
-        glDrawArrays(GL_TRIANGLES, 0, 6*text_field->width*text_field->height);
+        GLubyte fg_color[4], bg_color[4];
+        TextField_PackColor(&text_field->fg_color, fg_color);
+        TextField_PackColor(&text_field->bg_color, bg_color);
+
+        if (text_field->restyle) {
+            for (uint16_t i = 0; i < num_cells; ++i) {
+                TextField_StyleGlyph(text_field, i, fg_color, bg_color);
+            }
+            text_field->restyle = false;
+        } else {
+            // Only the cells the cursor has left and entered have changed.
+            if (text_field->glyph_cursor_cell < num_cells) {
+                TextField_StyleGlyph(text_field,
+                    text_field->glyph_cursor_cell, fg_color, bg_color);
+            }
+            if (text_field->cursor_cell < num_cells) {
+                TextField_StyleGlyph(
+                    text_field, text_field->cursor_cell, fg_color, bg_color);
+            }
+        }
+        text_field->glyph_cursor_cell = text_field->cursor_cell;
     }
-    glBindVertexArray(0);
+
+    TextBatch_Add(View_GetTextBatch(view_base), text_field,
+        text_field->glyphs, num_cells,
+        text_field->changed_begin, text_field->changed_end);
+    text_field->changed_begin = text_field->changed_end = 0;
 }
 
 static void TextField_Destroy(View *view_base)
 {
     TextField *text_field = (TextField *)view_base;
     free(text_field->buffer);
+    free(text_field->glyphs);
+    free(text_field->dirty_rows);
 }
 
 TextField *TextField_New(
@@ -238,63 +183,6 @@ TextField *TextField_New(
     text_field->cursor_y = 0;
     text_field->show_cursor = false;
 
-    // Initialize the transformation matrix. We need to go from window
-    // coordinates:
-    //
-    //                     window width (px)
-    //                  <------------------->
-    //                y
-    //                  ^--------------------    ^
-    //                  |                   |    |
-    //                  |                   |    |
-    //                  |                   |    | window height (px)
-    //                  |                   |    |
-    //                  |                   |    |
-    //                  o------------------->    V
-    //                                       x
-    //
-    // To view coordinates:
-    //
-    //                      -1          1
-    //                  <--------| |-------->
-    //                           y
-    //                  ----------^----------    ^
-    //                  |         |         |    | 1
-    //                  |         |         |    _
-    //                  |         o--------->    _
-    //                  |                   | x  |
-    //                  |                   |    | -1
-    //                  ---------------------    V
-    //
-    // This transformation requires first scaling by (2/width, 2/height) to
-    // normalize x- and y-coordinates to the range [0, 2], and then translating
-    // by (-1, -1) to move the origin to (-1, -1), where it will be rendered in
-    // the bottom left corner of the screen, like we want.
-    uint32_t window_width, window_height;
-    View_GetWindowSize((View *)text_field, &window_width, &window_height);
-    mat3_Copy(&text_field->transform, &I3);
-        // Initialize to the identity so we can layer transformations on.
-    mat3 m;
-    vec2 v;
-    v = (vec2) { 2.0/window_width, 2.0/window_height };
-    mat3_Scale(&m, &v);
-    mat3_ComposeInPlace(&m, &text_field->transform);
-        // Scale by (2/width, 2/height).
-    v = (vec2) { -1, -1 };
-    mat3_Translation(&m, &v);
-    mat3_ComposeInPlace(&m, &text_field->transform);
-        // Translate by (-1, -1).
-    trace("Console transform:\n%s", mat3_String(&text_field->transform));
-
-    // Initialize GL fields.
-    text_field->shaders = GL_LoadShaders(
-        "shaders/text_vertex.glsl", "shaders/text_fragment.glsl");
-    text_field->font_texture = GL_LoadTexture("textures/monofur.bmp");
-    text_field->font_sampler = glGetUniformLocation(text_field->shaders, "font");
-    text_field->mvp = glGetUniformLocation(text_field->shaders, "mvp");
-    text_field->shader_fg_color = glGetUniformLocation(text_field->shaders, "fg_color");
-    text_field->shader_bg_color = glGetUniformLocation(text_field->shaders, "bg_color");
-
     // By default, set the foreground color to white and the background to a
     // dark gray color.
     vec4 color = { 1, 1, 1, 1};
@@ -302,24 +190,24 @@ TextField *TextField_New(
     color = (vec4) { 0, 0, 0, 0.4 };
     TextField_SetBackgroundColor(text_field, &color);
 
-    // Create vertex buffers.
-    glGenVertexArrays(1, &text_field->vao);
-    glGenBuffers(1, &text_field->vertex_positions);
-    glGenBuffers(1, &text_field->vertex_uv);
-    glGenBuffers(1, &text_field->vertex_cursor);
-
-    // Initialize the vertex position buffer.
-    TextField_UpdateVertices(text_field);
-
     // Create empty output buffer.
     text_field->buffer = Malloc(text_field->width*text_field->height);
     memset(text_field->buffer, ' ', text_field->width*text_field->height);
+    text_field->glyphs = Malloc(
+        text_field->width*text_field->height*sizeof(TextGlyph));
+    text_field->dirty_rows = Malloc(text_field->height*sizeof(bool));
+    memset(text_field->dirty_rows, true, text_field->height*sizeof(bool));
+    text_field->scrolled_rows = 0;
+    text_field->restyle = true;
+    text_field->glyph_cursor_cell = UINT16_MAX;
+    text_field->changed_begin = text_field->changed_end = 0;
+        // None of the glyphs have been computed yet.
 
     // All of our resources are allocated, set up a destroy function to release
     // them when the view is closed.
     View_SetDestroyCallback((View *)text_field, TextField_Destroy);
 
-    // Initialize character vertex data.
+    // Initialize the flushed characters.
     TextField_Flush(text_field);
 
     return text_field;
@@ -327,19 +215,23 @@ TextField *TextField_New(
 
 void TextField_SetLocation(TextField *text_field, uint16_t x, uint16_t y)
 {
-    text_field->x = x;
-    text_field->y = y;
-    TextField_UpdateVertices(text_field);
+    if (x != text_field->x || y != text_field->y) {
+        text_field->x = x;
+        text_field->y = y;
+        text_field->restyle = true;
+    }
 }
 
 void TextField_SetForegroundColor(TextField *text_field, const vec4 *color)
 {
     text_field->fg_color = *color;
+    text_field->restyle = true;
 }
 
 void TextField_SetBackgroundColor(TextField *text_field, const vec4 *color)
 {
     text_field->bg_color = *color;
+    text_field->restyle = true;
 }
 
 static void TextField_Scroll(TextField *text_field)
@@ -361,6 +253,15 @@ static void TextField_Scroll(TextField *text_field)
         memset(TextField_CharAt(text_field, text_field->height - 1, 0),
                ' ', text_field->width);
 
+        // Rows which changed before the scroll are still out of date after
+        // it, and the empty row is new.
+        memmove(text_field->dirty_rows, text_field->dirty_rows + 1,
+                (text_field->height - 1)*sizeof(bool));
+        text_field->dirty_rows[text_field->height - 1] = true;
+        if (text_field->scrolled_rows < text_field->height) {
+            ++text_field->scrolled_rows;
+        }
+
         // All the lines have moved up one row, so we move the cursor up.
         --text_field->cursor_y;
     }
@@ -382,6 +283,7 @@ void TextField_PutChar(TextField *text_field, char c)
 
     *TextField_CharAt(
         text_field, text_field->cursor_y, text_field->cursor_x++) = c;
+    text_field->dirty_rows[text_field->cursor_y] = true;
 }
 
 void TextField_PutString(TextField *text_field, const char *string)
@@ -402,6 +304,7 @@ void TextField_Printf(TextField *text_field, const char *fmt, ...)
     va_list args;
     va_start(args, fmt);
 
+    text_field->dirty_rows[text_field->cursor_y] = true;
     int length = vsnprintf(
         TextField_CharAt(
             text_field, text_field->cursor_y, text_field->cursor_x),
@@ -465,123 +368,14 @@ uint8_t TextField_GetWidth(const TextField *text_field)
 
 void TextField_Flush(TextField *text_field)
 {
-    uint32_t num_vertices = 6*text_field->width*text_field->height;
-        // Each character slot is a quadrilateral, or two triangles, so requires
-        // 6 vertices.
-
-    glBindVertexArray(text_field->vao);
-    {
-        // Create the texture coordinate buffer.
-        glBindBuffer(GL_ARRAY_BUFFER, text_field->vertex_uv);
-        {
-            vec2 *uv = Malloc(num_vertices*sizeof(vec2));
-            vec2 char_coords;
-
-            uint16_t i = 0;
-                // Offset of the current vertex in `uv`.
-            for (uint8_t row = 0; row < text_field->height; ++row) {
-                for (uint8_t col = 0; col < text_field->width; ++col) {
-                    Font_Coords(
-                        *TextField_CharAt(text_field, row, col), &char_coords);
-
-                    // When we initialized the vertex buffer, we set up the
-                    // vertex positions for a quadrilateral like this one:
-                    //
-                    //               (x, y)        (x + char_width, y)
-                    //                     A-----,B
-                    //                     | 1  / |
-                    //                     |  ,`  |
-                    //                     | /  2 |
-                    //                     C------D
-                    // (x, y - char_height)        (x + char_width, y - char_height)
-                    //
-                    // Now we have to initialize uv texture coordinates which
-                    // correspond to these two triangles. Remember that
-                    // char_coords represents the _bottom_ left corner of the
-                    // character in texture space, so we will be adding to
-                    // char_coords.y, not subtracting.
-
-                    // Triangle 1: top left, ABC
-                    uv[i++] = (vec2){ char_coords.x,            char_coords.y+FONT_HEIGHT };
-                    uv[i++] = (vec2){ char_coords.x+FONT_WIDTH, char_coords.y+FONT_HEIGHT };
-                    uv[i++] = (vec2){ char_coords.x,            char_coords.y };
-
-                    // Triangle 2: bottom right, DBC
-                    uv[i++] = (vec2){ char_coords.x+FONT_WIDTH, char_coords.y };
-                    uv[i++] = (vec2){ char_coords.x+FONT_WIDTH, char_coords.y+FONT_HEIGHT };
-                    uv[i++] = (vec2){ char_coords.x,            char_coords.y };
-                }
-            }
+    text_field->flush_pending = true;
+        // The characters are looked up when the field is rendered, but the
+        // cursor has to be recorded now, since it may move again before then.
 
-            glBufferData(
-                GL_ARRAY_BUFFER,
-                num_vertices*sizeof(vec2),
-                uv,
-                GL_STATIC_DRAW
-            );
-            glVertexAttribPointer(
-                VERTEX_ATTRIB_TEXTURE_UV, 2, GL_FLOAT, GL_FALSE, 0, 0);
-            glEnableVertexAttribArray(VERTEX_ATTRIB_TEXTURE_UV);
-
-            free(uv);
-        }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // Create the cursor toggle buffer.
-        glBindBuffer(GL_ARRAY_BUFFER, text_field->vertex_cursor);
-        {
-            GLuint *cursors = Malloc(num_vertices*sizeof(GLuint));
-
-            uint16_t i = 0;
-                // Offset of the current vertex in `cursors`.
-            for (uint8_t row = 0; row < text_field->height; ++row) {
-                for (uint8_t col = 0; col < text_field->width; ++col) {
-                    // Initialize cursors for the following quadrilateral:
-                    //
-                    //               (x, y)        (x + char_width, y)
-                    //                     A-----,B
-                    //                     | 1  / |
-                    //                     |  ,`  |
-                    //                     | /  2 |
-                    //                     C------D
-                    // (x, y - char_height)        (x + char_width, y - char_height)
-                    //
-                    // All four vertices in the quadrilateral will have the same
-                    // value, since the cursor always occupies a whole cell.
-                    // Most quads will have a value of `false`. A quadrilateral
-                    // _is_ a cursor if and only if `text_field->show_cursor` is
-                    // set and `x == text_field->cursor_x` and
-                    // `y == text_field->cursor_y`.
-                    bool cursor = text_field->show_cursor &&
-                                  col == text_field->cursor_x &&
-                                  row == text_field->cursor_y;
-
-                    // Triangle 1: top left, ABC
-                    cursors[i++] = cursor;
-                    cursors[i++] = cursor;
-                    cursors[i++] = cursor;
-
-                    // Triangle 2: bottom right, DBC
-                    cursors[i++] = cursor;
-                    cursors[i++] = cursor;
-                    cursors[i++] = cursor;
-                }
-            }
-
-            glBufferData(
-                GL_ARRAY_BUFFER,
-                num_vertices*sizeof(GLuint),
-                cursors,
-                GL_STATIC_DRAW
-            );
-            glVertexAttribIPointer(
-                VERTEX_ATTRIB_CURSOR, 1, GL_UNSIGNED_INT, 0, 0);
-            glEnableVertexAttribArray(VERTEX_ATTRIB_CURSOR);
-
-            free(cursors);
-        }
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (text_field->show_cursor) {
+        text_field->cursor_cell =
+            text_field->cursor_y*text_field->width + text_field->cursor_x;
+    } else {
+        text_field->cursor_cell = UINT16_MAX;
     }
-    glBindVertexArray(0);
 }
-
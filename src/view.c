@@ -1,10 +1,29 @@
+#include <string.h>
+
+#include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 #include "errors.h"
 #include "clock.h"
+#include "profiler.h"
 #include "text.h"
 #include "view.h"
 
+#define VIEW_STREAM_BUFFER_SIZE (1024*1024)
+    // Bytes of per-frame geometry which can be in flight at once, across all
+    // views. Text keeps its own buffer (see `TextBatch`), so this is mostly
+    // lines, and is far more than a few frames of them need.
+
+#define VIEW_DEFAULT_FRAME_RATE 60
+#define VIEW_BACKGROUND_FRAME_RATE 10
+    // Frames per second while the window is unfocused or idle.
+#define VIEW_IDLE_TIMEOUT_US 10000000
+    // Time without input after which the window is considered idle.
+#define VIEW_SPIN_US 1000
+    // How long before a frame deadline we stop sleeping and start polling the
+    // clock. Sleeps regularly overshoot by tens or hundreds of microseconds, so
+    // sleeping right up to the deadline would make frames late.
+
 ////////////////////////////////////////////////////////////////////////////////
 // Traversing views
 //
@@ -129,6 +148,7 @@ static void ViewManager_KeyCallback(
     // The manager for this window is stored in the window user pointer.
     ViewManager *manager = glfwGetWindowUserPointer(window);
     ASSERT(manager != NULL);
+    manager->last_activity = Clock_GetTimeUS();
 
     View *view = manager->focused;
 
@@ -188,6 +208,7 @@ static void ViewManager_CharCallback(GLFWwindow *window, uint32_t codepoint)
     // Get the manager from the window's user data.
     ViewManager *manager = glfwGetWindowUserPointer(window);
     ASSERT(manager != NULL);
+    manager->last_activity = Clock_GetTimeUS();
 
     // Find a view above the focused one with a handler for this event.
     View *view = manager->focused;
@@ -217,6 +238,7 @@ static void ViewManager_MouseButtonCallback(
     // Get the manager from the window's user data.
     ViewManager *manager = glfwGetWindowUserPointer(window);
     ASSERT(manager != NULL);
+    manager->last_activity = Clock_GetTimeUS();
 
     // Find a view above the focused one with a handler for this event.
     View *view = manager->focused;
@@ -242,6 +264,13 @@ static void ViewManager_CursorPositionCallback(
     (void)x;
     (void)y;
 
+    // Get the manager from the window's user data.
+    ViewManager *manager = glfwGetWindowUserPointer(window);
+    ASSERT(manager != NULL);
+    manager->last_activity = Clock_GetTimeUS();
+        // Even if this is not a drag, moving the mouse means the user is
+        // active, so we shouldn't drop to the idle frame rate.
+
     // Figure out which mouse buttons are pressed.
     bool left   = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT)   == GLFW_PRESS;
     bool right  = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT)  == GLFW_PRESS;
@@ -252,10 +281,6 @@ static void ViewManager_CursorPositionCallback(
         return;
     }
 
-    // Get the manager from the window's user data.
-    ViewManager *manager = glfwGetWindowUserPointer(window);
-    ASSERT(manager != NULL);
-
     // Find a view above the focused one with a handler for this event.
     View *view = manager->focused;
     while (view != NULL) {
@@ -300,6 +325,7 @@ static void ViewManager_ScrollCallback(GLFWwindow *window, double x, double y)
     // Get the manager from the window's user data.
     ViewManager *manager = glfwGetWindowUserPointer(window);
     ASSERT(manager != NULL);
+    manager->last_activity = Clock_GetTimeUS();
 
     // Find a view above the focused one with a handler for this event.
     View *view = manager->focused;
@@ -314,16 +340,24 @@ static void ViewManager_ScrollCallback(GLFWwindow *window, double x, double y)
     }
 }
 
+// Switch GPU zones as the render queue moves from the scene to the overlay.
+static void ViewManager_BeginLayer(RenderLayer layer, void *object)
+{
+    (void)object;
+    if (layer == RENDER_LAYER_OVERLAY) {
+        Profiler_End(PROFILE_GPU_SCENE);
+        Profiler_Begin(PROFILE_GPU_OVERLAY);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // ViewManager API
 //
 
 void ViewManager_Init(ViewManager *manager, GLFWwindow *window)
 {
+    ViewManager_InitHeadless(manager, 0, 0);
     manager->window = window;
-    manager->roots = NULL;
-    manager->focused = NULL;
-    manager->last_time = Clock_GetTimeMS();
 
     // Set up all the window callbacks.
     glfwSetWindowUserPointer(window, manager);
@@ -334,6 +368,59 @@ void ViewManager_Init(ViewManager *manager, GLFWwindow *window)
     glfwSetScrollCallback(window, ViewManager_ScrollCallback);
 }
 
+void ViewManager_InitHeadless(
+    ViewManager *manager, uint32_t width, uint32_t height)
+{
+    manager->window = NULL;
+    manager->width = width;
+    manager->height = height;
+    manager->fixed_dt = 0;
+    manager->frame_rate = VIEW_DEFAULT_FRAME_RATE;
+    manager->vsync = false;
+    manager->frame_deadline = Clock_GetTimeUS();
+    manager->last_activity = manager->frame_deadline;
+    memset(&manager->stats, 0, sizeof(manager->stats));
+    manager->roots = NULL;
+    manager->focused = NULL;
+    manager->last_time = Clock_GetTimeMS();
+    manager->stream.buffer = 0;
+        // The stream buffer is created lazily; see `View_GetStreamBuffer`.
+    RenderQueue_Init(&manager->queue);
+    RenderQueue_SetLayerFunction(
+        &manager->queue, ViewManager_BeginLayer, NULL);
+    manager->text.shaders = 0;
+        // Likewise the text batch; see `View_GetTextBatch`.
+}
+
+void ViewManager_SetFrameRate(ViewManager *manager, uint32_t fps)
+{
+    manager->frame_rate = fps;
+}
+
+void ViewManager_SetVSync(ViewManager *manager, bool vsync)
+{
+    manager->vsync = vsync;
+    if (manager->window != NULL) {
+        glfwSwapInterval(vsync ? 1 : 0);
+            // This applies to the current context, which belongs to our
+            // window, since we have been rendering to it.
+    }
+}
+
+void ViewManager_GetFrameStats(
+    const ViewManager *manager, ViewFrameStats *stats)
+{
+    *stats = manager->stats;
+}
+
+void ViewManager_SetFixedTimeStep(ViewManager *manager, uint32_t dt)
+{
+    manager->fixed_dt = dt;
+    manager->last_time = Clock_GetTimeMS();
+        // A fixed time step lets the frame clock drift away from the real one,
+        // so resynchronize them whenever the time step changes.
+}
+
 void ViewManager_Destroy(ViewManager *manager)
 {
     View *view = manager->roots;
@@ -350,6 +437,14 @@ void ViewManager_Destroy(ViewManager *manager)
         View_Close(view);
         view = next;
     }
+
+    if (manager->text.shaders != 0) {
+        TextBatch_Destroy(&manager->text);
+    }
+    if (manager->stream.buffer != 0) {
+        GL_StreamBuffer_Destroy(&manager->stream);
+    }
+    RenderQueue_Destroy(&manager->queue);
 }
 
 void View_UseProgram(View *view, const Command *program, void *state)
@@ -372,22 +467,83 @@ void View_UseProgram(View *view, const Command *program, void *state)
         // becomes focused, when the user enters the console shortcut.
 }
 
+// Decide whether the user is paying attention to the window. If not, we only
+// render at the background frame rate.
+static bool ViewManager_InBackground(const ViewManager *manager, uint64_t now)
+{
+    if (manager->window == NULL) {
+        // Without a window there is no user, so they can't be idle.
+        return false;
+    }
+
+    return now - manager->last_activity > VIEW_IDLE_TIMEOUT_US ||
+        !glfwGetWindowAttrib(manager->window, GLFW_FOCUSED) ||
+        glfwGetWindowAttrib(manager->window, GLFW_ICONIFIED);
+}
+
+// Wait until it is time to start the next frame.
+static void ViewManager_WaitForFrame(ViewManager *manager)
+{
+    uint64_t now = Clock_GetTimeUS();
+
+    uint32_t rate = manager->vsync ? 0 : manager->frame_rate;
+        // With vsync, swapping buffers does the waiting for us.
+    if (ViewManager_InBackground(manager, now) &&
+        (rate == 0 || rate > VIEW_BACKGROUND_FRAME_RATE))
+    {
+        rate = VIEW_BACKGROUND_FRAME_RATE;
+        ++manager->stats.background;
+    }
+
+    if (rate == 0) {
+        manager->frame_deadline = now;
+        return;
+    }
+
+    uint64_t period = 1000000/rate;
+    uint64_t deadline = manager->frame_deadline + period;
+        // We schedule each frame relative to when the last one was supposed to
+        // start, not when it actually did, so that small delays in waking up
+        // don't accumulate into a lower frame rate.
+
+    if (now >= deadline + period) {
+        // We're so late that we've missed at least one whole frame. Give up on
+        // those frames and start a new schedule from now.
+        manager->stats.missed += (now - deadline)/period;
+        deadline = now;
+    }
+
+    if (deadline > now + VIEW_SPIN_US) {
+        Clock_SleepUS(deadline - now - VIEW_SPIN_US);
+    }
+    while (Clock_GetTimeUS() < deadline) {
+        // Spin for the last little bit.
+    }
+
+    manager->frame_deadline = deadline;
+}
+
 void ViewManager_Render(ViewManager *manager)
 {
+    if (manager->fixed_dt == 0) {
+        ViewManager_WaitForFrame(manager);
+    }
+
     uint64_t curr_time = Clock_GetTimeMS();
-    ASSERT(curr_time >= manager->last_time);
 
-    if(curr_time - manager->last_time < 10) {
-        // We're running more than 100 frames per second, which is pointless.
-        // Throttle back a little bit.
-        Clock_SleepMS(10);
-        curr_time = Clock_GetTimeMS();
+    if (manager->fixed_dt != 0) {
+        // Pretend exactly one time step has passed, however long it has
+        // really been.
+        curr_time = manager->last_time + manager->fixed_dt;
     }
+    ASSERT(curr_time >= manager->last_time);
 
     if (manager->focused == NULL) {
         return;
     }
 
+    Profiler_Begin(PROFILE_FRAME);
+    Profiler_Begin(PROFILE_RENDER);
     ViewTraversal t = View_Traversal(View_Root(manager->focused));
     View *view;
     while ((view = View_Traverse(&t)) != NULL) {
@@ -396,7 +552,31 @@ void ViewManager_Render(ViewManager *manager)
         }
     }
 
-    glfwSwapBuffers(manager->window);
+    if (manager->text.shaders != 0) {
+        uint32_t width, height;
+        View_GetWindowSize(manager->focused, &width, &height);
+        TextBatch_Submit(&manager->text, &manager->queue, width, height);
+    }
+    Profiler_End(PROFILE_RENDER);
+
+    Profiler_Begin(PROFILE_QUEUE);
+    Profiler_Begin(PROFILE_GPU_SCENE);
+    RenderQueue_Execute(&manager->queue);
+        // Ends `PROFILE_GPU_SCENE` and begins `PROFILE_GPU_OVERLAY` on the
+        // way; see `ViewManager_BeginLayer`.
+    Profiler_End(PROFILE_GPU_OVERLAY);
+    Profiler_End(PROFILE_QUEUE);
+
+    if (manager->stream.buffer != 0) {
+        GL_StreamBuffer_EndFrame(&manager->stream);
+    }
+
+    if (manager->window != NULL) {
+        glfwSwapBuffers(manager->window);
+    }
+    Profiler_End(PROFILE_FRAME);
+    Profiler_EndFrame();
+    ++manager->stats.frames;
     manager->last_time = curr_time;
 }
 
@@ -445,8 +625,42 @@ void View_Focus(View *view)
     view->manager->focused = view;
 }
 
+GL_StreamBuffer *View_GetStreamBuffer(View *view)
+{
+    GL_StreamBuffer *stream = &view->manager->stream;
+    if (stream->buffer == 0) {
+        GL_StreamBuffer_Init(stream, VIEW_STREAM_BUFFER_SIZE);
+    }
+    return stream;
+}
+
+RenderQueue *View_GetRenderQueue(View *view)
+{
+    return &view->manager->queue;
+}
+
+TextBatch *View_GetTextBatch(View *view)
+{
+    TextBatch *batch = &view->manager->text;
+    if (batch->shaders == 0) {
+        TextBatch_Init(batch);
+    }
+    return batch;
+}
+
+void View_KeepAwake(View *view)
+{
+    view->manager->last_activity = Clock_GetTimeUS();
+}
+
 void View_GetWindowSize(const View *view, uint32_t *width, uint32_t *height)
 {
+    if (view->manager->window == NULL) {
+        *width = view->manager->width;
+        *height = view->manager->height;
+        return;
+    }
+
     int iwidth, iheight;
     glfwGetWindowSize(view->manager->window, &iwidth, &iheight);
 
@@ -462,6 +676,14 @@ void View_GetCursorPos(const View *view, int32_t *x, int32_t *y)
     uint32_t width, height;
     View_GetWindowSize(view, &width, &height);
 
+    if (view->manager->window == NULL) {
+        // Without a mouse, leave the cursor in the middle of the window, where
+        // it won't cause the camera to pan.
+        *x = width/2;
+        *y = height/2;
+        return;
+    }
+
     double dx, dy;
     glfwGetCursorPos(view->manager->window, &dx, &dy);
     *x = floor(dx);
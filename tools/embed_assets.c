@@ -0,0 +1,169 @@
+// Generate a C source file defining the `ASSETS` table declared in assets.h.
+//
+// Usage: embed_assets <output> <root> <path>...
+//
+// Each `path` is read relative to the `root` directory, and embedded under that
+// path. Bitmaps (files ending in ".bmp") are decoded, and embedded as pixels
+// ready to hand to GL; any other file is embedded as is.
+//
+// A path of the form "<bitmap>:distance:<spread>" embeds the signed distance
+// field of the alpha channel of the bitmap instead, with one byte per texel
+// (see `DistanceField_Compute` and `GL_LoadDistanceField`).
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bmp.h"
+#include "distance_field.h"
+#include "errors.h"
+
+static void EmbedAssets_FatalError(Error error, void *error_data, void *arg)
+{
+    (void)error;
+    (void)error_data;
+    (void)arg;
+        // `Error_Raise` has already printed the error, and will exit.
+}
+
+static bool EmbedAssets_IsBitmap(const char *path)
+{
+    size_t length = strlen(path);
+    return length >= 4 && strcmp(path + length - 4, ".bmp") == 0;
+}
+
+// If `path` names a distance field, cut it short to leave the path of the
+// bitmap, and get the spread.
+static bool EmbedAssets_SplitDistanceField(char *path, uint8_t *spread)
+{
+    char *suffix = strstr(path, ":distance:");
+    if (suffix == NULL) {
+        return false;
+    }
+
+    char *end;
+    long value = strtol(suffix + strlen(":distance:"), &end, 10);
+    if (*end != '\0' || value <= 0 || value > UINT8_MAX) {
+        error("invalid distance field spread in %s\n", path);
+        exit(1);
+    }
+    *spread = value;
+    *suffix = '\0';
+    return true;
+}
+
+// Read the whole of a file into memory.
+static uint8_t *EmbedAssets_ReadFile(const char *path, uint32_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        Error_Raise(FATAL, ERR_IO, strerror(errno));
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t *data = Malloc(file_size > 0 ? file_size : 1);
+    if (fread(data, 1, file_size, file) != (size_t)file_size) {
+        Error_Raise(FATAL, ERR_IO, "unable to read asset");
+    }
+    fclose(file);
+
+    *size = file_size;
+    return data;
+}
+
+static void EmbedAssets_WriteData(
+    FILE *out, uint32_t index, const uint8_t *data, uint32_t size)
+{
+    fprintf(out, "static const uint8_t asset_%u[] = {", index);
+    for (uint32_t i = 0; i < size; ++i) {
+        fprintf(out, i % 16 ? " %u," : "\n    %u,", data[i]);
+    }
+    if (size == 0) {
+        fprintf(out, " 0");
+            // C doesn't allow empty arrays.
+    }
+    fprintf(out, "\n};\n\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <output> <root> <path>...\n", argv[0]);
+        return 1;
+    }
+    Error_SetFatalErrorCallback(EmbedAssets_FatalError, NULL);
+    Error_SetMinimumLogLevel(LOG_WARN);
+
+    const char *output_path = argv[1];
+    const char *root = argv[2];
+    char **paths = &argv[3];
+    uint32_t num_assets = argc - 3;
+
+    FILE *out = fopen(output_path, "w");
+    if (out == NULL) {
+        Error_Raise(FATAL, ERR_IO, strerror(errno));
+    }
+    fprintf(out,
+        "// Generated by embed_assets. Do not edit.\n"
+        "\n"
+        "#include <stdint.h>\n"
+        "\n"
+        "#include \"assets.h\"\n"
+        "\n");
+
+    uint32_t *sizes = Malloc((num_assets + 1)*sizeof(uint32_t));
+    uint32_t *widths = Malloc((num_assets + 1)*sizeof(uint32_t));
+    uint32_t *heights = Malloc((num_assets + 1)*sizeof(uint32_t));
+    for (uint32_t i = 0; i < num_assets; ++i) {
+        char *path = Malloc(strlen(root) + strlen(paths[i]) + 2);
+        sprintf(path, "%s/%s", root, paths[i]);
+
+        uint8_t *data;
+        uint8_t spread;
+        if (EmbedAssets_SplitDistanceField(path, &spread)) {
+            uint8_t *pixels = BMP_Load(path, &widths[i], &heights[i]);
+            sizes[i] = widths[i]*heights[i];
+            data = Malloc(sizes[i]);
+            DistanceField_Compute(
+                pixels + 3, widths[i], heights[i], 4, spread, data);
+                // Measure from the edges of the alpha channel.
+            free(pixels);
+        } else if (EmbedAssets_IsBitmap(paths[i])) {
+            data = BMP_Load(path, &widths[i], &heights[i]);
+            sizes[i] = 4*widths[i]*heights[i];
+        } else {
+            data = EmbedAssets_ReadFile(path, &sizes[i]);
+            widths[i] = 0;
+            heights[i] = 0;
+        }
+        EmbedAssets_WriteData(out, i, data, sizes[i]);
+
+        free(data);
+        free(path);
+    }
+
+    fprintf(out, "const Asset ASSETS[] = {\n");
+    for (uint32_t i = 0; i < num_assets; ++i) {
+        fprintf(out, "    { \"%s\", asset_%u, %u, %u, %u },\n",
+            paths[i], i, sizes[i], widths[i], heights[i]);
+    }
+    if (num_assets == 0) {
+        fprintf(out, "    { \"\", 0, 0, 0, 0 },\n");
+    }
+    fprintf(out, "};\n\nconst uint32_t NUM_ASSETS = %u;\n", num_assets);
+
+    free(sizes);
+    free(widths);
+    free(heights);
+
+    if (fclose(out) != 0) {
+        Error_Raise(FATAL, ERR_IO, strerror(errno));
+    }
+    return 0;
+}